@@ -9,11 +9,23 @@
 #ifndef CORE_AST_H
 #define CORE_AST_H
 
+#include <csignal>    // std::sig_atomic_t
+#include <functional> // std::function
+#include <iostream>   // std::istream, std::ostream
 #include <sstream>
+#include <string>     // std::string
+#include <vector>     // std::vector
 
 // Forward declarations:
 class ASTContext;
+struct Checkpoint;
+class Compiler;
+struct Function;
+class Loop;
 class Node;
+struct OptStats;
+class Budget;
+class Tiers;
 
 /// An abstract syntax tree for the CORE language.
 class AST {
@@ -25,9 +37,17 @@ class AST {
   Node *TranslationUnit = nullptr;
 
   /// Contextual informatiom about the the tree to be used for semantical
-  /// analysis and the execution phase. Only the Parser needs to acces this.
+  /// analysis. Only the Parser needs to acces this; every execution gets a
+  /// fresh context of its own.
   ASTContext &Context;
 
+  /// A fingerprint of the tokens of the program and of the passes that
+  /// reshaped its tree since, see `getFingerprint`.
+  unsigned long long Fingerprint = 14695981039346656037ULL;
+
+  /// Mixes `Data` into `Fingerprint`.
+  void Mix(const std::string &Data);
+
 public:
   /// A constructor for an empty abstract syntax tree.
   AST();
@@ -41,9 +61,110 @@ public:
   /// Prints the AST to the passed in string stream.
   void Print(std::ostringstream &X);
 
+  /// Folds constant subexpressions and simplifies arithmetic identities. Should
+  /// be called after parsing and before executing.
+  void Fold();
+
+  /// Partially evaluates the program against the values of its first reads,
+  /// known ahead of the run. Those reads assign the values instead, and
+  /// folding and pruning run on the resulting constants so that the residual
+  /// program only reads the rest. Should be called right after parsing.
+  ///
+  /// A read only takes a value if it is the next to run whatever the input:
+  /// reads in a loop, or in a branch that pruning can not decide, stop the
+  /// specialization.
+  /// \param S where the statements removed by pruning are counted.
+  /// \return the number of values used. The others still have to be read.
+  unsigned Specialize(const std::vector<int> &Inputs, OptStats &S);
+
+  /// Propagates constants to prune branches that are never taken, then removes
+  /// assignments whose value is never read. Should be called after parsing and
+  /// before executing.
+  /// \param S where the removed statements are counted.
+  void Prune(OptStats &S);
+
+  /// Runs the value-range analysis, marking arithmetic that can not overflow
+  /// so that its check is skipped. Should be called last before executing or
+  /// compiling, as other optimizations do not preserve the marks.
+  /// \param S where the checks are counted.
+  void AnalyzeRanges(OptStats &S);
+
+  /// Recognizes counting loops whose iterations can be skipped on entry (see
+  /// `Induction`). Both the tree walker and the virtual machine use them.
+  /// \param S where the loops are counted.
+  void FindInductions(OptStats &S);
+
+  /// A fingerprint of the program, the passes run on its tree, the values
+  /// given to `Specialize` and `ShortCircuit` (see `Execute(bool, bool)`).
+  /// Every checkpoint carries it, so that it is only resumed on the same tree.
+  unsigned long long getFingerprint(bool ShortCircuit = true) const;
+
+  /// Lowers the AST to bytecode using the given compiler.
+  void Compile(Compiler &C);
+
+  /// Lowers the AST to SSA form in `F`, which should be empty.
+  /// \param ShortCircuit see `Execute(bool, bool)`.
+  void Lower(Function &F, bool ShortCircuit = true);
+
+  /// Lowers only the loop `L` of this AST, followed by a `halt`. Variables get
+  /// the same registers as when compiling the whole program, so that a run of
+  /// the tree can continue in the bytecode at the head of the loop.
+  void CompileLoop(const Loop *L, Compiler &C) const;
+
   /// Executes the AST using std::cin for user input and std::cout for any
   /// output.
-  void Execute();
+  /// \param DeferChecks evaluate each expression as a whole and only check
+  /// for overflow once at the end. Reports the same errors.
+  /// \param ShortCircuit skip the right hand side of `and` / `or` when the
+  /// left hand side decides the outcome. Otherwise both sides are evaluated,
+  /// as in earlier versions of CORE.
+  void Execute(bool DeferChecks = false, bool ShortCircuit = true) const;
+
+  /// Executes the AST reading user input from `In` and writing output to
+  /// `Out`. The tree is not modified, so any number of threads may execute the
+  /// same AST at once.
+  /// \param T when set, hot loops move to the tiers it manages.
+  /// \param Limits when set, the run stops with a runtime error once its loops
+  /// exceed the steps or the time of the budget.
+  /// \see Execute(bool, bool)
+  void Execute(std::istream &In, std::ostream &Out, bool DeferChecks = false,
+               bool ShortCircuit = true, Tiers *T = nullptr,
+               Budget *Limits = nullptr) const;
+
+  /// Executes the AST like `Execute(std::istream &, std::ostream &, ...)`,
+  /// taking checkpoints on request. `Request` is looked at before every
+  /// statement; once it is set, the state of the run is handed to `Save` and
+  /// `Request` is cleared. The run goes on if `Save` returns true and stops
+  /// otherwise. Loops are never moved to bytecode.
+  /// \param Request the flag, usually set from a signal handler, or null to
+  /// take checkpoints only when `Limits` preempts the run.
+  /// \param From when set, the run continues from this checkpoint instead of
+  /// starting over, with `In` moved to where it was.
+  /// \param Limits see `Execute(std::istream &, std::ostream &, ...)`. The
+  /// steps spent before a checkpoint are not saved with it. A quantum takes a
+  /// checkpoint each time it is used up.
+  /// \throw std::string if `From` was not taken from this program, with the
+  /// same passes and `ShortCircuit`.
+  void Execute(std::istream &In, std::ostream &Out,
+               volatile std::sig_atomic_t *Request,
+               const std::function<bool(const Checkpoint &)> &Save,
+               const Checkpoint *From = nullptr, bool DeferChecks = false,
+               bool ShortCircuit = true, Budget *Limits = nullptr) const;
+
+  /// Executes the AST as one step of a `Session`: from the start, or from
+  /// `State` if `Resume` is set, until the run finishes or reaches a `read`
+  /// of more values than the `Supplied` ones in `In`, or `Limits` preempts it.
+  /// The run is then saved to `State` the same way a checkpoint is.
+  /// \param Waiting set to the name of the identifier the run waits to read,
+  /// or cleared if it finished or was preempted.
+  /// \return whether the run finished.
+  /// \throw std::string describing a runtime error, or if `State` was not
+  /// taken from this program.
+  bool ExecuteUntilRead(std::istream &In, std::ostream &Out,
+                        unsigned long long Supplied, Checkpoint &State,
+                        bool Resume, std::string &Waiting,
+                        bool DeferChecks = false, bool ShortCircuit = true,
+                        Budget *Limits = nullptr) const;
 };
 
 #endif
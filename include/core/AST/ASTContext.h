@@ -9,11 +9,18 @@
 #ifndef CORE_AST_CONTEXT_H
 #define CORE_AST_CONTEXT_H
 
-#include <map>    // std::map
-#include <string> // std::string
+#include <csignal>  // std::sig_atomic_t
+#include <iostream> // std::istream, std::ostream
+#include <map>      // std::map
+#include <string>   // std::string
+#include <vector>   // std::vector
 
+struct Checkpoint;
 class IdList;
 class Id;
+class Loop;
+class Budget;
+class Tiers;
 
 // TODO: Possibly move creation of identifier symbols to the Tokenizer and keep
 // a `Declared` property on the symbol.
@@ -30,6 +37,41 @@ class ASTContext {
   /// The raw symbol table which is just a mapping of identifiers to integers.
   std::map<std::string, IdSym *> SM;
 
+  /// Whether expressions are evaluated as a whole and checked for overflow
+  /// once at the end instead of after every operation.
+  bool DeferChecks = false;
+
+  /// Whether `and` / `or` skip their right hand side when the left hand side
+  /// decides the outcome.
+  bool ShortCircuit = true;
+
+  /// Where `read` takes values from and `write` sends them to.
+  std::istream *In = &std::cin;
+  std::ostream *Out = &std::cout;
+
+  /// When set, the tiers hot loops move to.
+  Tiers *T = nullptr;
+
+  /// How many times each loop iterated in the tree walker during this run.
+  std::map<const Loop *, unsigned> Iterations;
+
+  /// When set and non-zero, a checkpoint is taken before the next statement.
+  volatile std::sig_atomic_t *Request = nullptr;
+
+  /// The number of values `read` took from the input so far.
+  unsigned long long Reads = 0;
+
+  /// When set, the limits of this run.
+  Budget *Limits = nullptr;
+
+  /// How many values the input holds in total, if it is given a value at a
+  /// time, and the identifier the run stopped to wait for.
+  unsigned long long Supplied = ~0ULL;
+  Id *Waiting = nullptr;
+
+  /// The fingerprint of the tree being run, see `AST::getFingerprint`.
+  unsigned long long Fingerprint = 0;
+
   /// Feteches the symbol for the given `Id`.
   /// \param I an `Id` expected to be in the symbol table.
   /// \throw if the `Id` is not found.
@@ -40,6 +82,82 @@ public:
   /// empty symbol table.
   ASTContext() {}
 
+  /// \brief Constructs the context of a single run of a parsed program. Every
+  /// identifier declared in `Declarations` starts out uninitialized. Runs with
+  /// their own context can execute the same tree at the same time.
+  ///
+  /// \param In where `read` takes values from.
+  /// \param Out where `write` sends values to.
+  ASTContext(const ASTContext &Declarations, std::istream &In,
+             std::ostream &Out);
+
+  ASTContext(const ASTContext &) = delete;
+  ASTContext &operator=(const ASTContext &) = delete;
+  ~ASTContext();
+
+  /// \brief Sets whether overflow checks are deferred to the end of each
+  /// expression. See `Exp::Evaluate`.
+  void setDeferChecks(bool Defer) { DeferChecks = Defer; }
+  bool isDeferringChecks() const { return DeferChecks; }
+
+  /// \brief Sets whether `and` / `or` skip their right hand side once the
+  /// left hand side decides the outcome. See `Cond::Execute`.
+  void setShortCircuit(bool Short) { ShortCircuit = Short; }
+  bool isShortCircuiting() const { return ShortCircuit; }
+
+  /// \brief Sets the tiers hot loops move to. See `Loop::Execute`.
+  void setTiers(Tiers *Tiers) { T = Tiers; }
+  Tiers *getTiers() const { return T; }
+
+  /// \brief The number of iterations `L` ran in the tree walker so far.
+  unsigned &getIterations(const Loop *L) { return Iterations[L]; }
+
+  /// \brief Sets the flag that requests a checkpoint. See `StmtSeq::Execute`.
+  void setCheckpointRequest(volatile std::sig_atomic_t *Flag) {
+    Request = Flag;
+  }
+  bool isCheckpointRequested() const {
+    return Request != nullptr && *Request != 0;
+  }
+
+  /// \brief Sets the limits of the run, spent at every back-edge. See
+  /// `Loop::Execute`.
+  void setBudget(Budget *B) { Limits = B; }
+  Budget *getBudget() const { return Limits; }
+
+  /// \brief Sets how many values the input holds. A `read` of more values
+  /// stops the run to wait for them instead, see `In::Execute`.
+  void setSupplied(unsigned long long Count) { Supplied = Count; }
+
+  /// \brief Stops the run before reading `L` if the input does not hold a
+  /// value for each of its identifiers yet.
+  /// \throw Checkpoint after noting the first identifier without a value.
+  void WaitForIn(IdList *L);
+
+  /// \brief The identifier the run stopped to wait for, if any.
+  Id *getWaiting() const { return Waiting; }
+
+  /// \brief Sets the fingerprint saved with each checkpoint, see `Restore`.
+  void setFingerprint(unsigned long long F) { Fingerprint = F; }
+
+  /// \brief Copies the variables and the position in the input to `CP`.
+  void Save(Checkpoint &CP) const;
+
+  /// \brief Sets the variables and moves the input to where they were when
+  /// `CP` was taken. The input is sought to the same offset if it can be,
+  /// otherwise the values read before the checkpoint are skipped.
+  /// \return false if `CP` was taken on another tree or has a different
+  /// number of variables.
+  bool Restore(const Checkpoint &CP);
+
+  /// The streams `read` and `write` use.
+  std::istream &getIn() const { return *In; }
+  std::ostream &getOut() const { return *Out; }
+
+  /// \brief Returns the symbol of the identifier called `Name`, or null if
+  /// none is declared. Used to move the values between tiers.
+  IdSym *Lookup(const std::string &Name);
+
   /// \brief Declares the Id list in to the symbol tabel
   ///
   /// \param L an `IdList` node that does not have any declared `Id`s.
@@ -92,7 +210,7 @@ public:
   /// \throw std::sting if `an` Id doesn't exist
   void SetFromIn(IdList *L);
 
-  /// \brief Writes each `Id` of the `IdList` to `std::cout`.
+  /// \brief Writes each `Id` of the `IdList` to the output.
   /// \throw std::sting if an `Id` doesn't exist
   /// \throw std::sting if an `Id` hasn't been initialized
   void WriteToOut(IdList *L);
@@ -0,0 +1,152 @@
+//===--- Arithmetic.h -----------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Checked integer arithmetic for CORE. Every stage that computes
+// the value of an expression (interpreting, folding, ...) must go through these
+// so that they agree on exactly when an overflow / underflow is reported.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CORE_AST_ARITHMETIC_H
+#define CORE_AST_ARITHMETIC_H
+
+#include "core/Diag/Diag.h"
+#include "core/Tokenizer/Token.h"
+
+#include <cassert>  // assert
+#include <limits.h> // INT_MAX, INT_MIN
+
+// The outcome of a checked arithmetic operation.
+namespace ArithResult {
+enum ArithResult {
+  ok = 0,
+
+  addition_overflow,
+  addition_underflow,
+  subtraction_overflow,
+  subtraction_underflow,
+  multiplication_overflow,
+  multiplication_underflow
+};
+} // namespace ArithResult
+
+namespace Arith {
+
+/// Computes `L + R` into `Out`. `Out` is left untouched on failure.
+inline ArithResult::ArithResult Add(int L, int R, int &Out) {
+  if (L > 0 && R > (INT_MAX - L)) return ArithResult::addition_overflow;
+  if (L < 0 && R < (INT_MIN - L)) return ArithResult::addition_underflow;
+  Out = L + R;
+  return ArithResult::ok;
+}
+
+/// Computes `L - R` into `Out`. `Out` is left untouched on failure.
+inline ArithResult::ArithResult Subtract(int L, int R, int &Out) {
+  if (R > 0 && L < (INT_MIN + R)) return ArithResult::subtraction_underflow;
+  if (R < 0 && L > (INT_MAX + R)) return ArithResult::subtraction_overflow;
+  Out = L - R;
+  return ArithResult::ok;
+}
+
+/// Computes `L * R` into `Out`. `Out` is left untouched on failure.
+///
+/// \discussion The bounds are checked by dividing the limits by `R`, which is
+/// only exact for a positive `R`. A negative `R` is reported as an overflow for
+/// most values of `L`; this is long standing CORE behaviour that every engine
+/// has to reproduce.
+inline ArithResult::ArithResult Multiply(int L, int R, int &Out) {
+  if (R == 0) {
+    // Short-circuit for multiplication by 0.
+    Out = 0;
+    return ArithResult::ok;
+  }
+  if (R > 0) {
+    // For a positive `R` the bounds below are exact: they fail exactly when
+    // the product is out of range, which is cheaper to test than dividing.
+    long long Product = (long long)L * R;
+    if (Product > INT_MAX) return ArithResult::multiplication_overflow;
+    if (Product < INT_MIN) return ArithResult::multiplication_underflow;
+    Out = (int)Product;
+    return ArithResult::ok;
+  }
+  if (L > INT_MAX / R) return ArithResult::multiplication_overflow;
+  // In 64 bits, as `INT_MIN / -1` does not fit an int and traps.
+  if (L < (long long)INT_MIN / R) return ArithResult::multiplication_underflow;
+  Out = L * R;
+  return ArithResult::ok;
+}
+
+// The deferred variants below compute the same results as the checked ones
+// whenever those succeed, wrapping around instead of failing. They record in
+// `Suspect` that the checked operation might have failed, so that a whole
+// expression can be evaluated without branching on each operation and checked
+// once at the end (see `Exp::Evaluate`).
+
+/// Computes `L + R`, setting `Suspect` on overflow / underflow.
+inline int AddDeferred(int L, int R, bool &Suspect) {
+#if defined(__GNUC__) || defined(__clang__)
+  int Out;
+  Suspect |= __builtin_add_overflow(L, R, &Out);
+  return Out;
+#else
+  long long Out = (long long)L + R;
+  Suspect |= Out < INT_MIN || Out > INT_MAX;
+  return (int)Out;
+#endif
+}
+
+/// Computes `L - R`, setting `Suspect` on overflow / underflow.
+inline int SubtractDeferred(int L, int R, bool &Suspect) {
+#if defined(__GNUC__) || defined(__clang__)
+  int Out;
+  Suspect |= __builtin_sub_overflow(L, R, &Out);
+  return Out;
+#else
+  long long Out = (long long)L - R;
+  Suspect |= Out < INT_MIN || Out > INT_MAX;
+  return (int)Out;
+#endif
+}
+
+/// Computes `L * R`, setting `Suspect` on overflow / underflow. A negative `R`
+/// is always suspect as `Multiply` is not exact for it.
+inline int MultiplyDeferred(int L, int R, bool &Suspect) {
+  Suspect |= R < 0;
+#if defined(__GNUC__) || defined(__clang__)
+  int Out;
+  Suspect |= __builtin_mul_overflow(L, R, &Out);
+  return Out;
+#else
+  long long Out = (long long)L * R;
+  Suspect |= Out < INT_MIN || Out > INT_MAX;
+  return (int)Out;
+#endif
+}
+
+/// Builds the runtime diagnostic for a failed operation located at `T`.
+inline LocDiag Diagnose(Token T, ArithResult::ArithResult R) {
+  const char *Operation = "addition";
+  const char *Effect = "overflow";
+  switch (R) {
+  case ArithResult::ok: assert(false && "Can not diagnose a valid operation.");
+  case ArithResult::addition_overflow: break;
+  case ArithResult::addition_underflow: Effect = "underflow"; break;
+  case ArithResult::subtraction_overflow: Operation = "subtraction"; break;
+  case ArithResult::subtraction_underflow:
+    Operation = "subtraction";
+    Effect = "underflow";
+    break;
+  case ArithResult::multiplication_overflow:
+    Operation = "multiplication";
+    break;
+  case ArithResult::multiplication_underflow:
+    Operation = "multiplication";
+    Effect = "underflow";
+    break;
+  }
+  return LocDiag(T, DiagType::runtime_arithmitic_x_causes_y, Operation, Effect);
+}
+
+} // namespace Arith
+
+#endif
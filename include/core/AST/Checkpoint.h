@@ -0,0 +1,50 @@
+//===--- Checkpoint.h -----------------------------------------------------===//
+//
+// Author: ケジ
+// Description: The state of a run of the tree walker between two statements,
+// so that a long run can be saved to a file and continued later, possibly on
+// another machine.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CORE_AST_CHECKPOINT_H
+#define CORE_AST_CHECKPOINT_H
+
+#include "core/AST/ASTContext.h"
+
+#include <istream> // std::istream
+#include <ostream> // std::ostream
+#include <vector>  // std::vector
+
+/// A checkpoint is thrown from the statement the run stops at and completed
+/// while the stack unwinds, so that taking one costs nothing until it is
+/// requested and then only as much as the nesting of the statement.
+struct Checkpoint {
+  /// The fingerprint of the tree the run was on, see `AST::getFingerprint`.
+  unsigned long long Program = 0;
+
+  /// Every declared variable, in the order of their names.
+  std::vector<IdSym> Slots;
+
+  /// Where the run stopped: the index of the statement in each sequence, from
+  /// the outermost one. An `if` in between adds whether its `else` was taken;
+  /// the sequence after a `while` is its body. The last index is the next
+  /// statement to run.
+  std::vector<unsigned> Path;
+
+  /// The position in the input stream, or -1 if it can not be told.
+  long long InputOffset = -1;
+
+  /// The number of values read from the input.
+  unsigned long long Reads = 0;
+
+  /// Writes the checkpoint in a compact binary form: a header, then the
+  /// fields above as little-endian integers.
+  void Write(std::ostream &X) const;
+
+  /// Reads a checkpoint written by `Write`.
+  /// \return false if `X` does not hold a valid checkpoint.
+  static bool Read(std::istream &X, Checkpoint &CP);
+};
+
+#endif
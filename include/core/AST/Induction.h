@@ -0,0 +1,48 @@
+//===--- Induction.h ------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Closed-form evaluation of counting loops. A loop qualifies when
+// its body only adds / subtracts loop-invariant values to its variables and
+// its condition compares one of them against a loop-invariant value, such as
+// `while (I < N) loop S = S + K; I = I + 1; end;`.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CORE_AST_INDUCTION_H
+#define CORE_AST_INDUCTION_H
+
+#include <vector> // std::vector
+
+/// The shape of a counting loop, independent of where an engine stores the
+/// values. Variables and steps are referred to by index.
+struct Induction {
+  /// The assignment `Var = Var + Step` (or `- Step`) of the loop body.
+  struct Update {
+    unsigned Var;
+    bool Subtract;
+  };
+
+  /// The number of distinct variables the body changes.
+  unsigned NumVars = 0;
+
+  /// The assignments of the body in order. The value of each step is passed in
+  /// at the same index.
+  std::vector<Update> Updates;
+
+  /// The condition is `Var[CondVar] <CompType> Bound`.
+  unsigned CondVar = 0;
+  unsigned CompType = 0;
+
+  /// Fast-forwards the loop over as many iterations as possible without
+  /// changing its behaviour: every skipped iteration would have run in full
+  /// without an overflow / underflow. The loop is then resumed as usual, so it
+  /// either ends or reports its diagnostic on the next iteration.
+  /// \param Values the values of the variables on entry, updated to their
+  /// values after the skipped iterations.
+  /// \param Steps the value of the step of each update.
+  /// \param Bound the value the condition compares against.
+  /// \return the number of iterations skipped.
+  long long Skip(int *Values, const int *Steps, int Bound) const;
+};
+
+#endif
@@ -9,9 +9,13 @@
 #ifndef CORE_AST_NODE_H
 #define CORE_AST_NODE_H
 
+#include "core/AST/Induction.h"
+#include "core/AST/Range.h"
 #include "core/Tokenizer/Token.h"
 
 #include <cassert> // assert
+#include <deque>   // std::deque
+#include <map>     // std::map
 #include <set>     // std::set
 #include <string>  // std::string
 #include <vector>  // std::vector
@@ -19,7 +23,23 @@
 // Forward decleration
 class Parser;
 class ASTContext;
+class Compiler;
+class IRBuilder;
 class IdSym;
+struct OptStats;
+
+/// Maps identifiers to the constant value they are known to hold.
+typedef std::map<std::string, int> ConstEnv;
+
+/// What the enclosing statement sequence should do with a statement after an
+/// optimization visited it.
+namespace Rewrite {
+enum Rewrite {
+  keep = 0,   // leave the statement where it is
+  remove,     // the statement has no effect and can be dropped
+  inline_body // the `if` always takes its `IfSeq`; splice it in its place
+};
+} // namespace Rewrite
 
 /// A generic node of the AST. Subclasses need to override the virtual methods.
 class Node {
@@ -29,9 +49,76 @@ public:
   /// \param Indent the level of indent to print at in the stream.
   virtual void Print(std::ostringstream &X, unsigned Indent) {}
 
-  /// Executes / evaluates the node.
+  /// Executes / evaluates the node. The node itself is never changed: all the
+  /// state of a run lives in `C`, so a tree can be executed by many threads at
+  /// once, each with its own context.
   /// \param C the context against which the node will execute / evaluate for.
-  virtual void Execute(ASTContext &C) {}
+  virtual void Execute(ASTContext &C) const {}
+
+  /// Folds constant subtrees and simplifies arithmetic identities in place.
+  /// Operations that would overflow / underflow are left untouched so that
+  /// their diagnostic is only raised if the code is actually reached.
+  virtual void Fold() {}
+
+  /// Lowers the node to bytecode.
+  /// \param C the compiler that holds the program being built.
+  /// \return the register holding the node's value, or
+  /// `Compiler::NoRegister` for nodes that do not produce one.
+  virtual unsigned Compile(Compiler &C) { return ~0u; }
+
+  /// Lowers the node to SSA form.
+  /// \param B the builder that holds the function being built.
+  /// \return the value of the node, or `IRBuilder::NoValue` for nodes that do
+  /// not produce one.
+  virtual unsigned Lower(IRBuilder &B) { return ~0u; }
+
+  /// Adds the name of every identifier whose value the node reads.
+  virtual void CollectUses(std::set<std::string> &Uses) {}
+
+  /// Adds the name of every identifier whose value the node may change.
+  virtual void CollectDefs(std::set<std::string> &Defs) {}
+
+  /// Substitutes identifiers with the constants they are known to hold and
+  /// prunes branches that can never be taken.
+  /// \param Env the constants known before the node, updated to after it.
+  /// \param S where the removed statements are counted.
+  virtual Rewrite::Rewrite Propagate(ConstEnv &Env, OptStats &S) {
+    return Rewrite::keep;
+  }
+
+  /// Removes assignments whose value is never read.
+  /// \param Live the identifiers read after the node, updated to before it.
+  /// \param S where the removed statements are counted, or null to only run
+  /// the analysis without changing the tree.
+  virtual Rewrite::Rewrite Liveness(std::set<std::string> &Live, OptStats *S) {
+    return Rewrite::keep;
+  }
+
+  /// Computes the range of values the node may produce and marks arithmetic
+  /// that is proven not to overflow as unchecked.
+  /// \param Env the ranges known before the node, updated to after it.
+  /// \param S where the checks are counted, or null to only run the analysis
+  /// without marking anything.
+  /// \return the range of the node's value, the full range for statements.
+  virtual Range Bound(RangeEnv &Env, OptStats *S) { return Range::full(); }
+
+  /// Recognizes loops that can be evaluated in closed form, see `Induction`.
+  /// \param S where the recognized loops are counted.
+  virtual void FindInductions(OptStats &S) {}
+
+  /// Gives the reads of the node the values at the front of `Inputs`, in the
+  /// order they run, removing them from `Inputs`.
+  /// \return false at the first read that can not be given a value, because
+  /// `Inputs` ran out or whether it runs first is only known at runtime (in a
+  /// loop or a branch). The reads after it are left alone.
+  virtual bool Specialize(std::deque<int> &Inputs) { return true; }
+
+  /// Chooses the evaluator specialized for the current shape of each
+  /// expression in the node: its operator, whether it is checked and whether
+  /// its operands are literals, identifiers or subexpressions. Runs when the
+  /// node is parsed and again after every optimization that changes the tree,
+  /// so that evaluating does not branch on the shape.
+  virtual void Select() {}
 };
 
 class StmtSeq;
@@ -76,7 +163,19 @@ class StmtSeq;
      * stream.                                                                 \
      */                                                                        \
     void Print(std::ostringstream &X, unsigned Indent) override;               \
-    void Execute(ASTContext &C) override;                                      \
+    void Execute(ASTContext &C) const override;                                \
+    void Fold() override;                                                      \
+    unsigned Compile(Compiler &C) override;                                    \
+    unsigned Lower(IRBuilder &B) override;                                     \
+    void CollectUses(std::set<std::string> &Uses) override;                    \
+    void CollectDefs(std::set<std::string> &Defs) override;                    \
+    Rewrite::Rewrite Propagate(ConstEnv &Env, OptStats &S) override;           \
+    Rewrite::Rewrite Liveness(std::set<std::string> &Live, OptStats *S)        \
+        override;                                                              \
+    Range Bound(RangeEnv &Env, OptStats *S) override;                          \
+    void FindInductions(OptStats &S) override;                                 \
+    bool Specialize(std::deque<int> &Inputs) override;                         \
+    void Select() override;                                                    \
     Token getToken() const { return Tok; }                                     \
     virtual ~CLASS(){DESTRUCTION};                                             \
   };
@@ -123,6 +222,18 @@ DEFINE_NODE(DeclSeq,
 /// The Node class representing `<stmt>` in CORE.
 DEFINE_NODE(Stmt,
   Node *Node = nullptr;
+public:
+  class Node *getNode() const { return Node; }
+
+  /// Detaches the body an `if` statement always takes.
+  /// \see Rewrite::inline_body
+  class StmtSeq *releaseBody();
+
+  /// Continues a run stopped by a checkpoint, see `Checkpoint::Path`.
+  /// \param Pos the element of `Path` for this node.
+  /// \throw std::string if `Path` does not lead to a statement.
+  void Resume(ASTContext &C, const std::vector<unsigned> &Path,
+              unsigned Pos) const;
 , delete Node;)
 
 /// The Node class representing `<stmt-seq>` in CORE.
@@ -162,6 +273,32 @@ public:
     assert(InitializedIds != nullptr && "Should not get initialized ids here.");
     return InitializedIds;
   };
+
+  class Stmt *getStmt() const { return Stmt; }
+  StmtSeq *getSeq() const { return Seq; }
+
+  /// Whether every statement of the sequence has been optimized away.
+  bool isEmpty() const { return Stmt == nullptr; }
+
+  /// Removes the statement held by this node. `Prev` is the node before it in
+  /// the chain, or null if this node is the head.
+  /// \return the node now holding the statement that followed, or null.
+  StmtSeq *Erase(StmtSeq *Prev);
+
+  /// Replaces the statement held by this node with the statements of the
+  /// non-empty `Body`, which is consumed.
+  /// \return the node holding the last spliced statement.
+  StmtSeq *Splice(StmtSeq *Body);
+
+  /// Runs the statements from `L`, the statement at `Index` of the sequence,
+  /// to the end. Before each one a requested checkpoint is thrown.
+  static void ExecuteFrom(ASTContext &C, const StmtSeq *L, unsigned Index);
+
+  /// Continues a run stopped by a checkpoint, see `Checkpoint::Path`.
+  /// \param Pos the element of `Path` for this node.
+  /// \throw std::string if `Path` does not lead to a statement.
+  void Resume(ASTContext &C, const std::vector<unsigned> &Path,
+              unsigned Pos) const;
 , delete Stmt; if (Seq != nullptr) delete Seq;)
 
 /// The Node class representing `<prog>` in CORE.
@@ -173,6 +310,14 @@ DEFINE_NODE(Prog,
   /// The string of statement sequences parsed by the program. This should not
   /// be null after initialization.
   StmtSeq *StmtSeq = nullptr;
+public:
+  class DeclSeq *getDeclSeq() const { return DeclSeq; }
+
+  /// Continues a run stopped by a checkpoint, see `Checkpoint::Path`.
+  /// \param Pos the element of `Path` for this node.
+  /// \throw std::string if `Path` does not lead to a statement.
+  void Resume(ASTContext &C, const std::vector<unsigned> &Path,
+              unsigned Pos) const;
 , delete DeclSeq; delete StmtSeq;)
 
 class Exp;
@@ -189,11 +334,38 @@ DEFINE_NODE(Fac,
   /// complain that it is not safe to destroy it.
   Node *Exp = nullptr;
 
-  /// The value of a factor to be properly set after it is interpreted.
-  int Value = 0;
+  /// The evaluator for the current shape of the factor, see `Node::Select`.
+  int (*Calc)(const Fac &, ASTContext &) = nullptr;
 public:
   // Getters for private members we want public.
-  int getValue() const { return Value; }
+  class Id *getId() const { return Id; }
+  Node *getExp() const { return Exp; }
+
+  /// Whether this factor is a literal (possibly produced by folding).
+  bool isConstant() const { return Id == nullptr && Exp == nullptr; }
+  int getConstant() const { return Int; }
+
+  /// Turns this factor into the literal `V`, releasing any subtree.
+  void setConstant(int V);
+
+  /// Whether evaluating this factor could raise a diagnostic.
+  bool mayThrow() const { return Exp != nullptr; }
+
+  /// Whether the value of this factor is a literal or an identifier with a
+  /// value in `Env`. If so it is stored in `V`.
+  bool isKnown(const ConstEnv &Env, int &V) const;
+
+  /// Evaluates the factor, checking every operation for overflow.
+  /// \throw LocDiag at the first operation that fails.
+  int Calculate(ASTContext &C) const { return Calc(*this, C); }
+
+  /// Evaluates the factor, wrapping around on overflow and setting `Suspect`
+  /// instead of throwing.
+  int Evaluate(ASTContext &C, bool &Suspect) const;
+
+  /// Evaluates the factor checking for overflow only once, at the end.
+  /// \throw LocDiag at the same token as `Calculate` would.
+  int Evaluate(ASTContext &C) const;
 , if (Id != nullptr) delete Id; if (Exp != nullptr) delete Exp;)
 
 /// The Node class representing `<term>` in CORE.
@@ -201,11 +373,34 @@ DEFINE_NODE(Term,
   Fac *LHSFac = nullptr;
   Term *RHSTerm = nullptr;
 
-  /// The value of a term to be properly set after it is interpreted.
-  int Value = 0;
+  /// Whether the multiplication has to be checked for overflow. Cleared by the
+  /// value-range analysis when it is proven safe.
+  bool Checked = true;
+
+  /// The evaluator for the current shape of the term, see `Node::Select`.
+  int (*Calc)(const Term &, ASTContext &) = nullptr;
 public:
   // Getters for private members we want public.
-  int getValue() const { return Value; }
+  Fac *getLHSFac() const { return LHSFac; }
+  Term *getRHSTerm() const { return RHSTerm; }
+  bool isChecked() const { return Checked; }
+
+  /// Whether this term is a single literal factor.
+  bool isConstant() const {
+    return RHSTerm == nullptr && LHSFac->isConstant();
+  }
+  int getConstant() const { return LHSFac->getConstant(); }
+
+  /// Turns this term into the literal `V`, releasing any subtree.
+  void setConstant(int V);
+
+  /// Evaluates the term, checking every operation for overflow.
+  /// \throw LocDiag at the first operation that fails.
+  int Calculate(ASTContext &C) const { return Calc(*this, C); }
+
+  /// Evaluates the term, wrapping around on overflow and setting `Suspect`
+  /// instead of throwing.
+  int Evaluate(ASTContext &C, bool &Suspect) const;
 , delete LHSFac; delete RHSTerm;)
 
 /// The Node class representing `<exp>` in CORE.
@@ -215,11 +410,40 @@ DEFINE_NODE(Exp,
   Term *LHSTerm = nullptr;
   Exp *RHSExp = nullptr;
 
-  /// The value of an expression to be properly set after it is interpreted.
-  int Value = 0;
+  /// Whether the addition / subtraction has to be checked for overflow. Cleared
+  /// by the value-range analysis when it is proven safe.
+  bool Checked = true;
+
+  /// The evaluator for the current shape of the expression, see
+  /// `Node::Select`.
+  int (*Calc)(const Exp &, ASTContext &) = nullptr;
 public:
-  // Getters for private members we want public.
-  int getValue() const { return Value; }
+  /// Whether this expression is a single literal factor.
+  bool isConstant() const { return ExpType == 0 && LHSTerm->isConstant(); }
+  int getConstant() const { return LHSTerm->getConstant(); }
+
+  Term *getLHSTerm() const { return LHSTerm; }
+  Exp *getRHSExp() const { return RHSExp; }
+  unsigned getExpType() const { return ExpType; }
+  bool isChecked() const { return Checked; }
+
+  /// Returns the only factor of this expression, or null if it has operators.
+  Fac *getLoneFac() const;
+
+  /// Whether evaluating this expression could raise a diagnostic.
+  bool mayThrow() const;
+
+  /// Evaluates the expression, checking every operation for overflow.
+  /// \throw LocDiag at the first operation that fails.
+  int Calculate(ASTContext &C) const { return Calc(*this, C); }
+
+  /// Evaluates the expression, wrapping around on overflow and setting
+  /// `Suspect` instead of throwing.
+  int Evaluate(ASTContext &C, bool &Suspect) const;
+
+  /// Evaluates the expression checking for overflow only once, at the end.
+  /// \throw LocDiag at the same token as `Calculate` would.
+  int Evaluate(ASTContext &C) const;
 , delete LHSTerm; delete RHSExp;)
 
 /// The Node class representing `<comp>` in CORE.
@@ -229,11 +453,35 @@ DEFINE_NODE(Comp,
   Fac *LHSFac = nullptr;
   Fac *RHSFac = nullptr;
 
-  /// The value of a condition to be properly set after it is interpreted.
-  bool Value = false;
+  /// The evaluator for the current shape of the comparison, see
+  /// `Node::Select`.
+  bool (*Test)(const Comp &, ASTContext &) = nullptr;
 public:
   // Getters for private members we want public.
-  bool getValue() const { return Value; }
+  unsigned getCompType() const { return CompType; }
+  Fac *getLHSFac() const { return LHSFac; }
+  Fac *getRHSFac() const { return RHSFac; }
+
+  /// Whether the outcome is known given the constants in `Env`. If so it is
+  /// stored in `V`.
+  bool Decide(const ConstEnv &Env, bool &V) const;
+  bool mayThrow() const { return LHSFac->mayThrow() || RHSFac->mayThrow(); }
+
+  /// Evaluates the comparison, checking its factors as `C` requires.
+  bool Evaluate(ASTContext &C) const;
+
+  /// Narrows the ranges in `Env` to the values for which the comparison has
+  /// the given `Outcome`.
+  void Refine(RangeEnv &Env, bool Outcome);
+
+  /// Emits code that jumps when the comparison is `When` and falls through
+  /// otherwise.
+  /// \param Jumps where the indices of the jumps to be patched are added.
+  void CompileBranch(Compiler &C, bool When, std::vector<unsigned> &Jumps);
+
+  /// Ends the current block going to block `True` if the comparison holds and
+  /// to block `False` otherwise.
+  void LowerBranch(IRBuilder &B, unsigned True, unsigned False);
 , delete LHSFac; delete RHSFac;)
 
 /// The Node class representing `<cond>` in CORE.
@@ -243,12 +491,36 @@ DEFINE_NODE(Cond,
   Cond *RHSCond = nullptr;
 
   unsigned CondType = 0;
-
-  /// The value of a condition to be properly set after it is interpreted.
-  bool Value = false;
 public:
   // Getters for private members we want public.
-  bool getValue() const { return Value; }
+  class Comp *getComp() const { return Comp; }
+
+  /// Whether the outcome is known given the constants in `Env`. If so it is
+  /// stored in `V`.
+  bool Decide(const ConstEnv &Env, bool &V) const;
+
+  /// Whether evaluating this condition could raise a diagnostic.
+  bool mayThrow() const;
+
+  /// Evaluates the condition, short-circuiting `and` / `or` unless `C` says
+  /// otherwise.
+  bool Evaluate(ASTContext &C) const;
+
+  /// Narrows the ranges in `Env` to the values for which the condition has
+  /// the given `Outcome`.
+  void Refine(RangeEnv &Env, bool Outcome);
+
+  /// Emits code that jumps when the condition is `When` and falls through
+  /// otherwise. With short-circuiting (see `Compiler::shortCircuits`) `and`
+  /// and `or` become jumps that skip the side that can not change the outcome.
+  /// \param Jumps where the indices of the jumps to be patched are added.
+  void CompileBranch(Compiler &C, bool When, std::vector<unsigned> &Jumps);
+
+  /// Ends the current block going to block `True` if the condition holds and
+  /// to block `False` otherwise. With short-circuiting (see
+  /// `IRBuilder::shortCircuits`) `and` and `or` become branches that skip the
+  /// side that can not change the outcome.
+  void LowerBranch(IRBuilder &B, unsigned True, unsigned False);
 , delete LHSCond; delete RHSCond; delete Comp;)
 
 /// The Node class representing `<if>` in CORE.
@@ -256,12 +528,28 @@ DEFINE_NODE(If,
   Cond *Cond = nullptr;
   StmtSeq *IfSeq = nullptr;
   StmtSeq *ElseSeq = nullptr;
+public:
+  /// Detaches the (decided) body, leaving the `if` empty.
+  StmtSeq *releaseBody();
+
+  /// Continues a run stopped by a checkpoint, see `Checkpoint::Path`.
+  /// \param Pos the element of `Path` for this node.
+  /// \throw std::string if `Path` does not lead to a statement.
+  void Resume(ASTContext &C, const std::vector<unsigned> &Path,
+              unsigned Pos) const;
 , delete Cond; delete IfSeq; delete ElseSeq;)
 
 /// The Node class representing `<in>` in CORE.
 DEFINE_NODE(In,
   /// The <id-list> to read in from the user.
   IdList *Seq = nullptr;
+
+  /// The values of the first identifiers of `Seq`, known before the run (see
+  /// `AST::Specialize`). They are assigned instead of read.
+  std::vector<int> Known;
+
+  /// Returns the identifiers read from the user, those after the known ones.
+  IdList *getUnknown() const;
 , delete Seq;)
 
 /// The Node class representing `<out>` in CORE.
@@ -277,6 +565,13 @@ DEFINE_NODE(Assign,
 
   /// The expression that will be assigned to the identifier.
   Exp *Exp = nullptr;
+public:
+  class Id *getId() const { return Id; }
+
+  /// Whether this is `Id = Id + Step`, `Id = Step + Id` or `Id = Id - Step`
+  /// where `Step` is a literal or an identifier not in `Defs`.
+  bool isUpdate(const std::set<std::string> &Defs, Fac *&Step,
+                bool &Subtract) const;
 , delete Id; delete Exp;)
 
 /// The Node class representing `<loop>` in CORE.
@@ -287,7 +582,34 @@ DEFINE_NODE(Loop,
 
   /// The sequence of statements to be executed as the body of the loop.
   StmtSeq *Seq = nullptr;
-, delete Cond; delete Seq;)
+
+  /// Set by `FindInductions` when the loop can be evaluated in closed form.
+  /// `IVVars`, `IVSteps` and `IVBound` hold the nodes whose values `IV`
+  /// refers to by index.
+  Induction *IV = nullptr;
+  std::vector<class Id *> IVVars;
+  std::vector<Fac *> IVSteps;
+  Fac *IVBound = nullptr;
+
+  /// Set by `AnalyzeRanges` to the number of iterations the loop always
+  /// runs, when its condition is decided on every one of them. -1 otherwise.
+  int Trips = -1;
+
+  /// Skips as many iterations as `IV` allows before running the loop.
+  void SkipIterations(ASTContext &C) const;
+
+  /// Runs the loop on the ranges `Env` has on entry while they decide the
+  /// condition, up to `MaxTrips` iterations.
+  /// \return the number of iterations, or -1 if it is not known.
+  int CountTrips(const RangeEnv &Env);
+
+public:
+  /// Continues a run stopped by a checkpoint, see `Checkpoint::Path`.
+  /// \param Pos the element of `Path` for this node.
+  /// \throw std::string if `Path` does not lead to a statement.
+  void Resume(ASTContext &C, const std::vector<unsigned> &Path,
+              unsigned Pos) const;
+, delete Cond; delete Seq; delete IV;)
 
 // clang-format on
 #undef DEFINE_NODE
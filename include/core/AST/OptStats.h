@@ -0,0 +1,40 @@
+//===--- OptStats.h -------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Counters filled in by the optimizations so that their effect
+// can be reported.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CORE_AST_OPTSTATS_H
+#define CORE_AST_OPTSTATS_H
+
+#include <ostream> // std::ostream
+
+struct OptStats {
+  /// Assignments removed because their value is never read.
+  unsigned DeadStores = 0;
+
+  /// `if` statements whose condition was decided so that the body never taken
+  /// (or the whole statement) could be removed.
+  unsigned DeadBranches = 0;
+
+  /// Loops removed because their condition is false on entry.
+  unsigned DeadLoops = 0;
+
+  /// Overflow checks of `+`, `-` and `*` in the program, and how many of them
+  /// the value-range analysis proved unnecessary.
+  unsigned Checks = 0;
+  unsigned ChecksEliminated = 0;
+
+  /// Counting loops whose iterations can be skipped, see `Induction`.
+  unsigned ClosedFormLoops = 0;
+
+  /// The total number of statements removed.
+  unsigned getRemoved() const { return DeadStores + DeadBranches + DeadLoops; }
+
+  /// Prints one counter per line.
+  void Print(std::ostream &X) const;
+};
+
+#endif
@@ -0,0 +1,91 @@
+//===--- Range.h ----------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Intervals of the values an expression or identifier may hold.
+// Used by the value-range analysis to prove that arithmetic can not overflow.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CORE_AST_RANGE_H
+#define CORE_AST_RANGE_H
+
+#include <algorithm> // std::min, std::max
+#include <limits.h>  // INT_MAX, INT_MIN
+#include <map>       // std::map
+#include <string>    // std::string
+
+/// The closed interval [Lo, Hi]. The bounds are wide enough to hold the result
+/// of any operation on two `int`s so that overflow can be detected. A range
+/// with `Lo > Hi` is empty: the code it belongs to can not be reached.
+struct Range {
+  long long Lo = INT_MIN;
+  long long Hi = INT_MAX;
+
+  Range() {}
+  Range(long long Lo, long long Hi) : Lo(Lo), Hi(Hi) {}
+
+  /// Every value an `int` can hold.
+  static Range full() { return Range(); }
+
+  /// No value at all.
+  static Range empty() { return Range(1, 0); }
+
+  bool isEmpty() const { return Lo > Hi; }
+
+  /// Whether every value of the range can be held by an `int`.
+  bool fitsInt() const { return isEmpty() || (Lo >= INT_MIN && Hi <= INT_MAX); }
+
+  /// The values an `int` result of an operation producing this range may hold.
+  Range clamp() const {
+    if (isEmpty()) return *this;
+    return Range(std::max<long long>(Lo, INT_MIN),
+                 std::min<long long>(Hi, INT_MAX));
+  }
+
+  bool operator==(const Range &R) const {
+    return (isEmpty() && R.isEmpty()) || (Lo == R.Lo && Hi == R.Hi);
+  }
+  bool operator!=(const Range &R) const { return !(*this == R); }
+
+  /// The smallest range containing both ranges.
+  Range join(const Range &R) const {
+    if (isEmpty()) return R;
+    if (R.isEmpty()) return *this;
+    return Range(std::min(Lo, R.Lo), std::max(Hi, R.Hi));
+  }
+
+  /// The values in both ranges.
+  Range meet(const Range &R) const {
+    return Range(std::max(Lo, R.Lo), std::min(Hi, R.Hi));
+  }
+
+  /// Jumps any bound that grew since `Old` straight to the `int` limit so that
+  /// loops reach a fixed point quickly.
+  Range widen(const Range &Old) const {
+    if (Old.isEmpty() || isEmpty()) return *this;
+    return Range(Lo < Old.Lo ? INT_MIN : Lo, Hi > Old.Hi ? INT_MAX : Hi);
+  }
+
+  Range operator+(const Range &R) const {
+    if (isEmpty() || R.isEmpty()) return empty();
+    return Range(Lo + R.Lo, Hi + R.Hi);
+  }
+
+  Range operator-(const Range &R) const {
+    if (isEmpty() || R.isEmpty()) return empty();
+    return Range(Lo - R.Hi, Hi - R.Lo);
+  }
+
+  Range operator*(const Range &R) const {
+    if (isEmpty() || R.isEmpty()) return empty();
+    long long A = Lo * R.Lo, B = Lo * R.Hi, C = Hi * R.Lo, D = Hi * R.Hi;
+    return Range(std::min(std::min(A, B), std::min(C, D)),
+                 std::max(std::max(A, B), std::max(C, D)));
+  }
+};
+
+/// Maps identifiers to the range of values they may hold. An identifier that
+/// is missing may hold any value.
+typedef std::map<std::string, Range> RangeEnv;
+
+#endif
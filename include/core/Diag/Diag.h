@@ -39,7 +39,9 @@ enum DiagType {
 
   parser_expected_eof,
 
-  runtime_arithmitic_x_causes_y
+  runtime_arithmitic_x_causes_y,
+  runtime_step_budget_x_exceeded,
+  runtime_time_limit_x_exceeded
 };
 } // namespace DiagType
 
@@ -96,6 +98,11 @@ public:
         {DiagType::runtime_arithmitic_x_causes_y,
          "Performing %s here will cause %s and "
          "unexpected behavior."},
+        {DiagType::runtime_step_budget_x_exceeded,
+         "The loops of the program went around more than %s times, the "
+         "step budget of the run."},
+        {DiagType::runtime_time_limit_x_exceeded,
+         "The program ran for longer than %s ms, the time limit of the run."},
         {DiagType::parser_unexpected_factor_type_x,
          "Unexpected factor type: %s. Expected one of [integer, constant, "
          "identifier, expression]."},
@@ -0,0 +1,59 @@
+//===--- Batch.h ----------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Runs one program over many independent input records on a
+// work-stealing pool of threads, writing the outputs in input order.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CORE_EXEC_BATCH_H
+#define CORE_EXEC_BATCH_H
+
+#include <functional> // std::function
+#include <iostream>   // std::istream, std::ostream
+#include <string>     // std::string
+#include <vector>     // std::vector
+
+class Batch {
+public:
+  /// Runs the program once, reading from `In` and writing to `Out`. Called
+  /// from several threads at once, so it must not share mutable state between
+  /// calls (see `AST::Execute(std::istream &, std::ostream &, ...)` and `VM`).
+  /// \throw std::string describing a runtime error.
+  typedef std::function<void(std::istream &In, std::ostream &Out)> Runner;
+
+  /// Runs the program once for each of up to `Lanes` inputs at once (see
+  /// `LaneVM`), under the same rules as a `Runner`.
+  /// \return the runtime error of each input, empty if it finished.
+  typedef std::function<std::vector<std::string>(
+      const std::vector<std::istream *> &Ins,
+      const std::vector<std::ostream *> &Outs)>
+      LaneRunner;
+
+private:
+  LaneRunner Run;
+
+  /// The number of records given to each call of `Run`.
+  unsigned Lanes;
+
+  /// The number of worker threads.
+  unsigned Threads;
+
+public:
+  /// \param Threads the number of workers, at least one.
+  Batch(Runner Run, unsigned Threads);
+
+  /// Hands the records to `Run` in groups of `Lanes` consecutive ones, the
+  /// group being the unit that is queued and stolen.
+  Batch(LaneRunner Run, unsigned Lanes, unsigned Threads);
+
+  /// Runs the program once per record, each record supplying the values of
+  /// its `read`s. The output of each run, followed by its runtime error if
+  /// any, is written to `Out` as soon as every record before it is done.
+  void Execute(const std::vector<std::string> &Records, std::ostream &Out);
+
+  /// Splits `In` into records, one per line.
+  static std::vector<std::string> ReadRecords(std::istream &In);
+};
+
+#endif
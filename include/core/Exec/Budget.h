@@ -0,0 +1,84 @@
+//===--- Budget.h ---------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Limits how many loop iterations and how much time a run of a
+// program may take, so that untrusted programs can be run safely.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CORE_EXEC_BUDGET_H
+#define CORE_EXEC_BUDGET_H
+
+#include <chrono> // std::chrono::steady_clock
+
+/// The limits of a single run. Only a loop can make a CORE program run for
+/// long, so the budget is spent one step per back-edge: the tree walker and
+/// the virtual machine call `Step` each time a loop goes around, and straight
+/// line code is never counted. Iterations a loop skips in closed form (see
+/// `Induction`) are spent all at once. A step only decrements a counter; the
+/// clock is read once every `CheckInterval` steps.
+///
+/// A budget can also preempt a run of the tree walker every `Quantum` steps:
+/// the step throws a `Checkpoint` at the back-edge, from which the run can be
+/// resumed later (see `Scheduler`). Runs in bytecode can not be preempted.
+///
+/// A run that is blocked reading its input is not stopped by the time limit.
+/// Each run needs its own budget.
+class Budget {
+  /// The number of steps allowed, or 0 for no limit.
+  unsigned long long MaxSteps;
+
+  /// The time allowed in milliseconds, or 0 for no limit, and when it is up.
+  unsigned MaxMillis;
+  std::chrono::steady_clock::time_point Deadline;
+
+  /// The steps between two preemptions, or 0 for none, and the step the
+  /// current slice ends at.
+  unsigned Quantum;
+  unsigned long long SliceEnd;
+
+  /// Steps taken before the current countdown started, and its length.
+  unsigned long long Spent = 0;
+  unsigned long long Chunk = 0;
+
+  /// The steps left until the limits are looked at again.
+  unsigned long long Countdown = 0;
+
+  /// Starts the next countdown like `Refill`, leaving the preemption to the
+  /// caller.
+  /// \return true if the current slice ended.
+  bool Advance();
+
+  /// Starts the next countdown.
+  /// \throw Diag if a limit was reached, Checkpoint at the end of a slice.
+  void Refill();
+
+public:
+  /// How many steps go by between two readings of the clock.
+  static const unsigned CheckInterval = 4096;
+
+  /// Starts the clock.
+  /// \param MaxSteps how many times loops may go around, 0 for no limit.
+  /// \param MaxMillis how long the run may take, 0 for no limit.
+  /// \param Quantum how many steps the run takes between preemptions, 0 for
+  /// never.
+  Budget(unsigned long long MaxSteps, unsigned MaxMillis, unsigned Quantum = 0);
+
+  /// Spends one step.
+  /// \throw Diag once the run exceeds its steps or its time, Checkpoint once
+  /// it used up its quantum.
+  void Step() {
+    if (--Countdown == 0) Refill();
+  }
+
+  /// Spends `N` steps at once. A checkpoint is thrown only once all of them
+  /// are counted, so the resumed run does not count them again.
+  /// \throw Diag once the run exceeds its steps or its time, Checkpoint once
+  /// it used up its quantum.
+  void Step(unsigned long long N);
+
+  /// The number of steps spent so far.
+  unsigned long long getSteps() const { return Spent + Chunk - Countdown; }
+};
+
+#endif
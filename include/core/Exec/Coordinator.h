@@ -0,0 +1,53 @@
+//===--- Coordinator.h ----------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Runs one program over many input records in worker processes
+// forked from the one that parsed it, writing the outputs in input order.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CORE_EXEC_COORDINATOR_H
+#define CORE_EXEC_COORDINATOR_H
+
+#include "core/Exec/Batch.h"
+
+#include <iostream> // std::istream, std::ostream
+
+/// Runs a batch like `Batch`, but on processes instead of threads, so that a
+/// run that crashes or corrupts memory takes only its own worker down. The
+/// workers are forked once the program is parsed and compiled and inherit it
+/// copy-on-write. Records are read one at a time and streamed to whichever
+/// worker is idle over a pipe; the output comes back over another.
+///
+/// A worker that dies is forked again. Its record is started once more on the
+/// new worker, and reported as an error if that crashes too.
+///
+/// POSIX only. The process should have no other threads while a batch runs,
+/// since a forked worker only has the one that forked it.
+class Coordinator {
+  Batch::Runner Run;
+
+  /// The number of worker processes.
+  unsigned Processes;
+
+  /// The number of workers forked again during the last batch.
+  unsigned Restarts = 0;
+
+public:
+  /// How many times a record is started before its crash is reported.
+  static const unsigned MaxAttempts = 2;
+
+  /// \param Run called in a worker process for each record, see
+  /// `Batch::Runner`.
+  /// \param Processes the number of workers, at least one.
+  Coordinator(Batch::Runner Run, unsigned Processes);
+
+  /// Runs the program once per line of `In`, each line supplying the values
+  /// of its `read`s. The output of each run, followed by its runtime error if
+  /// any, is written to `Out` as soon as every line before it is done.
+  void Execute(std::istream &In, std::ostream &Out);
+
+  unsigned getRestarts() const { return Restarts; }
+};
+
+#endif
@@ -0,0 +1,144 @@
+//===--- Scheduler.h ------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Runs many instances of programs at once on a fixed pool of
+// threads, taking turns by a quantum of loop iterations.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CORE_EXEC_SCHEDULER_H
+#define CORE_EXEC_SCHEDULER_H
+
+#include <condition_variable> // std::condition_variable
+#include <deque>              // std::deque
+#include <functional>         // std::function
+#include <mutex>              // std::mutex
+#include <string>             // std::string
+#include <thread>             // std::thread
+#include <vector>             // std::vector
+
+class AST;
+
+/// Multiplexes instances of programs, each a `Session`, over a fixed set of
+/// worker threads. An instance runs for a slice of `Quantum` steps (see
+/// `Budget`) and then goes to the back of the queue of its worker, so that a
+/// long loop can not hold a thread. An instance that reaches a `read` without
+/// a value is parked and takes no thread until `Supply` gives it one.
+///
+/// Each worker owns a queue of runnable instances. It takes from the front of
+/// its own queue and, once that is empty, steals from the back of the others,
+/// as in `Batch`. Instances are kept apart from one another: each has its own
+/// variables, input, output and budget, and only the trees are shared.
+class Scheduler {
+public:
+  /// What an instance is doing.
+  enum Status { runnable, waiting, finished };
+
+  /// The resources an instance used so far.
+  struct Usage {
+    /// The steps taken, see `Budget`.
+    unsigned long long Steps = 0;
+
+    /// The number of slices it ran in and the nanoseconds spent in them.
+    unsigned Slices = 0;
+    unsigned long long Nanos = 0;
+
+    /// The number of values it was given.
+    unsigned long long Supplied = 0;
+  };
+
+  /// Called on a worker thread whenever an instance is parked or finishes.
+  typedef std::function<void(unsigned Id)> Listener;
+
+private:
+  struct Instance;
+
+  /// The runnable instances of one worker.
+  struct WorkQueue {
+    std::mutex Lock;
+    std::deque<Instance *> Ready;
+  };
+
+  /// The steps of a slice.
+  unsigned Quantum;
+
+  /// Every instance ever spawned, by id.
+  std::deque<Instance *> Instances;
+
+  std::vector<WorkQueue> Queues;
+  std::vector<std::thread> Workers;
+  Listener OnPark;
+
+  /// Guards the fields below and `Instances`.
+  std::mutex Lock;
+
+  /// Signalled when an instance is queued, and when none is active any more.
+  std::condition_variable Wake;
+  std::condition_variable Idle;
+
+  /// The number of queued instances, of instances queued or running, and
+  /// whether the workers should exit.
+  unsigned Queued = 0;
+  unsigned Active = 0;
+  bool Stopping = false;
+
+  /// Queues `I` at the back of the queue of its last worker.
+  void Enqueue(Instance *I);
+
+  /// Takes the next instance for worker `Self`, stealing if needed.
+  /// \return null if every queue is empty.
+  Instance *Take(unsigned Self);
+
+  /// Runs one slice of `I` on worker `Self`.
+  void RunSlice(Instance *I, unsigned Self);
+
+  /// The loop of worker `Self`.
+  void Serve(unsigned Self);
+
+  Instance *get(unsigned Id);
+
+public:
+  /// Starts the workers.
+  /// \param Threads the number of workers, at least one.
+  /// \param Quantum the steps an instance runs before giving up its worker.
+  Scheduler(unsigned Threads, unsigned Quantum = 10000);
+
+  /// Stops the workers once their current slices end and frees every
+  /// instance. Instances that did not finish are dropped.
+  ~Scheduler();
+
+  Scheduler(const Scheduler &) = delete;
+  Scheduler &operator=(const Scheduler &) = delete;
+
+  /// Calls `L` whenever an instance is parked or finishes. Should be set
+  /// before the first instance is spawned.
+  void setListener(Listener L) { OnPark = L; }
+
+  /// Starts a new instance of `A`, which must outlive the scheduler.
+  /// \param MaxSteps the step budget of the instance, 0 for no limit.
+  /// \param DeferChecks, ShortCircuit see `AST::Execute(bool, bool)`.
+  /// \return the id of the instance.
+  unsigned Spawn(const AST &A, unsigned long long MaxSteps = 0,
+                 bool DeferChecks = false, bool ShortCircuit = true);
+
+  /// Gives instance `Id` the next value to read, waking it if it is parked.
+  void Supply(unsigned Id, int Value);
+
+  /// Waits until no instance can run: each one has finished or is parked.
+  void Wait();
+
+  Status getStatus(unsigned Id);
+
+  /// The identifier a parked instance waits to read.
+  std::string getWaiting(unsigned Id);
+
+  /// Takes the output instance `Id` wrote since the last call.
+  std::string TakeOutput(unsigned Id);
+
+  /// The runtime error an instance finished with, empty if none.
+  std::string getError(unsigned Id);
+
+  Usage getUsage(unsigned Id);
+};
+
+#endif
@@ -0,0 +1,85 @@
+//===--- Session.h --------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Runs a program that is given its input a value at a time, so
+// that interactive runs can be served without a thread blocked on each one.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CORE_EXEC_SESSION_H
+#define CORE_EXEC_SESSION_H
+
+#include "core/AST/Checkpoint.h"
+
+#include <ostream> // std::ostream
+#include <sstream> // std::stringstream
+#include <string>  // std::string
+
+class AST;
+class Budget;
+
+/// A run of a program that never blocks on its input. `Run` goes until the
+/// program finishes or reaches a `read` it has no value for yet; the run is
+/// then saved as a `Checkpoint` and the name of the identifier it waits for is
+/// returned. Once the value is given with `Supply`, `Run` continues from the
+/// `read`. A waiting session holds nothing but its variables, its place in
+/// the tree and the values given but not read yet, so one thread can host any
+/// number of them.
+///
+/// With a budget that has a quantum, `Run` also returns when the run is
+/// preempted, neither finished nor waiting; calling it again continues.
+///
+/// The output is the same as that of a run given the whole input at once: the
+/// prompt of a `read` is written when its value is read.
+class Session {
+  /// The program being run, shared with any other session.
+  const AST &A;
+
+  /// Options of the tree walker, see `AST::Execute(bool, bool)`.
+  bool DeferChecks;
+  bool ShortCircuit;
+
+  /// The values given but not read yet, and the number given so far.
+  std::stringstream Input;
+  unsigned long long Supplied = 0;
+
+  /// Where the run stopped, once it started.
+  Checkpoint State;
+  bool Started = false;
+  bool Finished = false;
+
+  /// The identifier the run waits to read.
+  std::string Waiting;
+
+  /// When set, the limits of the run over all calls of `Run`.
+  Budget *Limits = nullptr;
+
+public:
+  Session(const AST &A, bool DeferChecks = false, bool ShortCircuit = true)
+      : A(A), DeferChecks(DeferChecks), ShortCircuit(ShortCircuit) {}
+
+  /// Gives the run the next value to read.
+  void Supply(int Value);
+
+  /// Sets the limits of the run, see `Budget`.
+  void setBudget(Budget *B) { Limits = B; }
+
+  /// Runs until the program finishes, waits for a value it was not given or
+  /// is preempted.
+  /// \param Out where the output written meanwhile goes.
+  /// \return the name of the identifier the run waits to read, or an empty
+  /// string once it finished or was preempted.
+  /// \throw std::string describing a runtime error, which ends the session.
+  const std::string &Run(std::ostream &Out);
+
+  /// Whether the program ran to its end, or stopped at a runtime error.
+  bool isFinished() const { return Finished; }
+
+  /// The number of values given to the run so far.
+  unsigned long long getSupplied() const { return Supplied; }
+
+  /// The identifier the run waits to read, see `Run`.
+  const std::string &getWaiting() const { return Waiting; }
+};
+
+#endif
@@ -0,0 +1,154 @@
+//===--- Tiers.h ----------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Runs a program in the tree walker, which starts right away, and
+// moves the loops that turn out to be hot to compiled bytecode.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CORE_EXEC_TIERS_H
+#define CORE_EXEC_TIERS_H
+
+#include <atomic>             // std::atomic
+#include <chrono>             // std::chrono::steady_clock
+#include <condition_variable> // std::condition_variable
+#include <deque>              // std::deque
+#include <iostream>           // std::istream, std::ostream
+#include <map>                // std::map
+#include <mutex>              // std::mutex
+#include <thread>             // std::thread
+#include <vector>             // std::vector
+
+class AST;
+class ASTContext;
+class Budget;
+class Loop;
+struct Program;
+
+/// Time spent and work done by the tiers, summed over every run.
+struct TierStats {
+  /// Nanoseconds spent running programs in total, in the bytecode of hot
+  /// loops and waiting for a loop to be compiled. The rest of the time is
+  /// spent walking the tree.
+  std::atomic<unsigned long long> TotalTime{0};
+  std::atomic<unsigned long long> BytecodeTime{0};
+  std::atomic<unsigned long long> StallTime{0};
+
+  /// Nanoseconds spent compiling, on whichever thread, and between requesting
+  /// the compilation of a loop and its bytecode being ready.
+  std::atomic<unsigned long long> CompileTime{0};
+  std::atomic<unsigned long long> CompileLatency{0};
+
+  /// The number of loops compiled and how many times a run moved into them.
+  std::atomic<unsigned> LoopsCompiled{0};
+  std::atomic<unsigned> Transfers{0};
+
+  /// The number of compiled loops whose hot path was traced.
+  std::atomic<unsigned> LoopsTraced{0};
+
+  /// Prints the counters.
+  void Print(std::ostream &X) const;
+};
+
+/// Executes one AST with tiering: every run starts in the tree walker, which
+/// counts the iterations of each loop. A loop that iterates `Threshold` times
+/// in a run is compiled on its own to bytecode and the run continues in the
+/// virtual machine at a back-edge, carrying the values of the variables over;
+/// it returns to the tree once the loop exits. Later entries into the loop, in
+/// this run or any other, go to the bytecode directly.
+///
+/// Loops are compiled by a background thread unless disabled: the run keeps
+/// walking the tree and switches at the first back-edge after the bytecode is
+/// ready.
+///
+/// With tracing, the first run of a compiled loop also records the path one of
+/// its iterations takes. The loop's bytecode is then replaced by one with a
+/// linear trace of that path (see `Trace::Build`) and the run continues in it.
+///
+/// The compiled loops are shared, so several threads may run the same `Tiers`.
+class Tiers {
+  /// The program whose loops are compiled.
+  const AST &A;
+
+  /// The number of iterations in one run after which a loop is compiled.
+  unsigned Threshold;
+
+  /// Whether the compiled loops short-circuit `and` / `or`, which must match
+  /// the tree walker.
+  bool ShortCircuit;
+
+  /// Whether compiled loops are traced.
+  bool Tracing = false;
+
+  /// A loop whose compilation was requested.
+  struct Request {
+    /// The bytecode, once compiled.
+    const Program *Code = nullptr;
+    std::chrono::steady_clock::time_point Time;
+
+    /// Whether a run is tracing or has traced the loop.
+    bool Traced = false;
+  };
+
+  /// Guards everything below.
+  std::mutex Lock;
+  std::map<const Loop *, Request> Requests;
+
+  /// Bytecode replaced by its trace, which other runs may still be using.
+  std::vector<const Program *> Retired;
+
+  /// The loops waiting for the background thread, which sleeps on `Wake`
+  /// until there are any or `Stopping` is set.
+  std::deque<const Loop *> Queue;
+  std::condition_variable Wake;
+  bool Stopping = false;
+  std::thread Worker;
+
+  TierStats Stats;
+
+  /// Compiles loop `L` and publishes its bytecode.
+  /// Must be called without holding `Lock`.
+  void Compile(const Loop *L);
+
+  /// Compiles the queued loops until stopped.
+  void Work();
+
+  /// Runs the compiled loop `L`, whose bytecode is `P`, on the variables of
+  /// `C`.
+  void Transfer(const Loop *L, const Program &P, ASTContext &C);
+
+public:
+  /// \param Threshold the iterations of a loop in one run before it is
+  /// compiled.
+  /// \param Background compile on a thread of its own instead of stopping the
+  /// run that found the loop hot.
+  Tiers(const AST &A, unsigned Threshold, bool ShortCircuit = true,
+        bool Background = true);
+  ~Tiers();
+
+  /// Sets whether the hot path of compiled loops is traced.
+  void setTracing(bool Trace) { Tracing = Trace; }
+
+  unsigned getThreshold() const { return Threshold; }
+  const TierStats &getStats() const { return Stats; }
+
+  /// Executes the AST once with tiering. The budget, when given, is spent in
+  /// the tree and in the bytecode alike.
+  /// \see AST::Execute(std::istream &, std::ostream &, bool, bool, Tiers *,
+  /// Budget *)
+  /// \throw std::string describing a runtime error.
+  void Execute(std::istream &In, std::ostream &Out, bool DeferChecks = false,
+               Budget *Limits = nullptr);
+
+  /// Runs all of loop `L` in bytecode if it is compiled already.
+  /// \return whether it was, in which case the loop has finished.
+  bool Enter(const Loop *L, ASTContext &C);
+
+  /// Requests the compilation of loop `L`, which is hot, and continues the run
+  /// in its bytecode if it is ready. Must only be called at a back-edge of
+  /// `L`, where the state of the run is the one the loop is entered with.
+  /// \return whether the loop ran in bytecode and has finished.
+  bool Promote(const Loop *L, ASTContext &C);
+};
+
+#endif
@@ -0,0 +1,112 @@
+//===--- Builder.h --------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Lowers a parsed CORE abstract syntax tree into a `Function` in
+// SSA form. The nodes drive the lowering (see `Node+Lower.cpp`); this class
+// tracks the value of every variable and places the phi nodes.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CORE_IR_BUILDER_H
+#define CORE_IR_BUILDER_H
+
+#include "core/IR/IR.h"
+
+#include <map>     // std::map
+#include <string>  // std::string
+#include <utility> // std::pair
+#include <vector>  // std::vector
+
+/// Builds SSA form directly while lowering, without computing dominance: the
+/// value of a variable is looked up through the predecessors of a block, and a
+/// phi is placed where several of them meet. A block is sealed once all of its
+/// predecessors are known; until then the phis it needs are left incomplete.
+/// See Braun et al., "Simple and Efficient Construction of Static Single
+/// Assignment Form".
+class IRBuilder {
+  /// The function under construction.
+  Function &F;
+
+  /// The block instructions are appended to.
+  unsigned Current = 0;
+
+  /// The index of each declared variable.
+  std::map<std::string, unsigned> Vars;
+
+  /// The value of each variable at the end of each block, if assigned or
+  /// looked up there.
+  std::vector<std::map<unsigned, unsigned>> Defs;
+
+  /// Whether each block is sealed, and the phis (with their variable) waiting
+  /// for it to be.
+  std::vector<bool> Sealed;
+  std::vector<std::vector<std::pair<unsigned, unsigned>>> Incomplete;
+
+  /// Whether `and` / `or` skip the side that can not change their outcome.
+  bool ShortCircuit;
+
+  /// Returns the value of variable `Var` at the end of block `B`.
+  unsigned Read(unsigned Var, unsigned B);
+
+  /// Adds a phi for variable `Var` to the start of block `B`.
+  unsigned AddPhi(unsigned Var, unsigned B);
+
+  /// Fills in an operand of `Phi` for each predecessor of its block.
+  void AddPhiOperands(unsigned Var, unsigned Phi);
+
+  /// Ends the current block with `I`, going to `Succs`.
+  void Terminate(Inst I, const std::vector<unsigned> &Succs);
+
+public:
+  /// Used by nodes that do not produce a value.
+  static const unsigned NoValue = ~0u;
+
+  /// Starts building `F` in its entry block, which is created.
+  explicit IRBuilder(Function &F, bool ShortCircuit = true);
+
+  /// Whether conditions are lowered to branches that skip the right hand side
+  /// of `and` / `or` when the left hand side decides the outcome, like
+  /// `AST::Execute` does by default.
+  bool shortCircuits() const { return ShortCircuit; }
+
+  /// Declares a variable.
+  void Declare(const std::string &Name);
+
+  /// Assigns `V` to the variable `Name` / returns its current value.
+  void Write(const std::string &Name, unsigned V);
+  unsigned Read(const std::string &Name);
+
+  /// Creates a block without predecessors.
+  unsigned CreateBlock();
+
+  /// Continues in block `B`.
+  void SetBlock(unsigned B) { Current = B; }
+
+  /// Declares that every predecessor of block `B` has been created.
+  void Seal(unsigned B);
+
+  /// Returns the constant `C`.
+  unsigned Constant(int C);
+
+  /// Appends an instruction to the current block and returns its value.
+  unsigned Emit(IROp::IROp Op, const std::vector<unsigned> &Ops);
+
+  /// Appends arithmetic that reports diagnostics at `T` if `Checked`.
+  unsigned Emit(Token T, IROp::IROp Op, const std::vector<unsigned> &Ops,
+                bool Checked);
+
+  /// Appends an instruction on the variable `Name`.
+  unsigned Emit(IROp::IROp Op, const std::string &Name,
+                const std::vector<unsigned> &Ops);
+
+  /// Ends the current block with a jump to `B`.
+  void Jump(unsigned B);
+
+  /// Ends the current block going to `True` if `Cond` holds, else `False`.
+  void Branch(unsigned Cond, unsigned True, unsigned False);
+
+  /// Ends the current block and the program.
+  void Return();
+};
+
+#endif
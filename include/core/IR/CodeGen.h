@@ -0,0 +1,28 @@
+//===--- CodeGen.h --------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Generates a bytecode `Program` for the `VM` and `LaneVM` from a
+// `Function` in SSA form.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CORE_IR_CODEGEN_H
+#define CORE_IR_CODEGEN_H
+
+#include "core/VM/Bytecode.h"
+
+struct Function;
+
+namespace CodeGen {
+
+/// Generates a program that behaves like `F`. Every value gets a register of
+/// its own after the variables; phis become copies at the end of each
+/// predecessor, on edges of their own where a predecessor branches. When
+/// `Fuse` is set, superinstructions such as `add_imm` and `jump_unless_lt`
+/// are selected.
+/// \return a program owned by the caller.
+Program *Generate(const Function &F, bool Fuse = true);
+
+} // end namespace CodeGen
+
+#endif
@@ -0,0 +1,160 @@
+//===--- IR.h -------------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: A mid-level intermediate representation of CORE programs in
+// static single assignment form, made of basic blocks with phi nodes at the
+// joins of `if`s and loops. Optimizations are passes over it (see
+// `PassManager`) instead of over the nodes of the AST.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CORE_IR_IR_H
+#define CORE_IR_IR_H
+
+#include "core/Tokenizer/Token.h"
+
+#include <sstream> // std::ostringstream
+#include <string>  // std::string
+#include <vector>  // std::vector
+
+namespace IROp {
+
+// Operands are the values listed in `Inst::Ops`.
+enum IROp {
+  // The constant `Imm`.
+  constant = 0,
+
+  // The value of Ops[0] assigned to variable `Var`. Removed by copy
+  // propagation.
+  copy,
+
+  // Ops[0] <op> Ops[1]. When `Checked`, overflow / underflow is reported at
+  // the token `Loc`.
+  add,
+  sub,
+  mul,
+
+  // Ops[0] <comp-op> Ops[1], as 1 or 0.
+  cmp_not_equal,
+  cmp_equal,
+  cmp_greater_than_equal,
+  cmp_less_than_equal,
+  cmp_greater_than,
+  cmp_less_than,
+
+  // Ops[0] && Ops[1], Ops[0] || Ops[1], !Ops[0]
+  logic_and,
+  logic_or,
+  logic_not,
+
+  // The value of variable `Var` at the start of the block: one operand per
+  // predecessor, in the order of `Block::Preds`.
+  phi,
+
+  // Reads variable `Var` from the input / writes Ops[0] as variable `Var`.
+  read,
+  write,
+
+  // Terminators, the last instruction of every block. Jumps to Succs[0];
+  // goes to Succs[0] if Ops[0] is non-zero and to Succs[1] otherwise; ends
+  // the program.
+  jump,
+  branch,
+  ret
+};
+
+} // end namespace IROp
+
+/// An instruction, which is also the value it produces. Values are referred to
+/// by their index in `Function::Insts`.
+struct Inst {
+  IROp::IROp Op;
+  std::vector<unsigned> Ops;
+
+  /// The value of a `constant`.
+  int Imm = 0;
+
+  /// The variable of a `copy`, `phi`, `read` or `write`, an index into
+  /// `Function::Names`. Phis added by passes have none (~0u).
+  unsigned Var = 0;
+
+  /// The token arithmetic reports its diagnostics at, an index into
+  /// `Function::Tokens`, and whether it has to be checked at all.
+  unsigned Loc = 0;
+  bool Checked = false;
+
+  /// The block holding the instruction.
+  unsigned Block = 0;
+
+  /// Set once a pass removed the instruction.
+  bool Erased = false;
+};
+
+/// A basic block: phis first and a terminator last.
+struct Block {
+  std::vector<unsigned> Insts;
+  std::vector<unsigned> Preds;
+  std::vector<unsigned> Succs;
+
+  /// Set once a pass removed the block.
+  bool Erased = false;
+};
+
+/// A whole CORE program. Execution starts in block 0.
+struct Function {
+  std::vector<Inst> Insts;
+  std::vector<Block> Blocks;
+
+  /// The declared variables.
+  std::vector<std::string> Names;
+
+  /// The source tokens used to report diagnostics.
+  std::vector<Token> Tokens;
+
+  /// Whether instruction `V` reads, writes, may report a diagnostic or ends
+  /// its block, so that it can not be removed even if its value is unused.
+  bool hasEffects(unsigned V) const;
+
+  /// Whether instruction `V` is a `constant`, stored in `C` if so.
+  bool isConstant(unsigned V, int &C) const;
+
+  /// Returns a constant with value `C`, adding one to the entry block if
+  /// needed.
+  unsigned getConstant(int C);
+
+  /// Appends a block and returns its index.
+  unsigned addBlock();
+
+  /// Appends an instruction to the end of block `B` and returns its index.
+  unsigned append(unsigned B, Inst I);
+
+  /// Inserts an instruction at position `Pos` of block `B` and returns its
+  /// index.
+  unsigned insert(unsigned B, unsigned Pos, Inst I);
+
+  /// Makes every use of `From` use `To` instead.
+  void replaceAllUses(unsigned From, unsigned To);
+
+  /// Removes instruction `V` from its block.
+  void erase(unsigned V);
+
+  /// Removes the edge from block `From` to block `To`, along with the phi
+  /// operands for it.
+  void removeEdge(unsigned From, unsigned To);
+
+  /// Returns the number of uses of every instruction.
+  std::vector<unsigned> countUses() const;
+
+  /// Returns the reachable blocks in reverse postorder, starting with block 0.
+  std::vector<unsigned> getReversePostorder() const;
+
+  /// Returns the immediate dominator of every block: the last block that
+  /// every path from block 0 to it goes through. Block 0 is its own; blocks
+  /// that can not be reached get ~0u.
+  std::vector<unsigned> getDominators() const;
+
+  /// Prints a human readable listing of the function.
+  void Print(std::ostringstream &X) const;
+};
+
+#endif
@@ -0,0 +1,72 @@
+//===--- PassManager.h ----------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Runs an ordered list of optimization passes over a `Function`,
+// timing each one. Passes can be reordered and disabled by name, so that the
+// effect of each one can be measured on its own.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CORE_IR_PASSMANAGER_H
+#define CORE_IR_PASSMANAGER_H
+
+#include <functional> // std::function
+#include <ostream>    // std::ostream
+#include <string>     // std::string
+#include <vector>     // std::vector
+
+struct Function;
+
+class PassManager {
+public:
+  /// A pass returns whether it changed the function.
+  typedef std::function<bool(Function &)> Pass;
+
+  /// A registered pass with its statistics from the last `Run`.
+  struct Entry {
+    std::string Name;
+    Pass Run;
+    bool Enabled = true;
+
+    /// The total time spent in the pass, in nanoseconds.
+    long long Time = 0;
+
+    /// The number of times the pass changed the function.
+    unsigned Changes = 0;
+  };
+
+private:
+  /// The passes, in the order they run.
+  std::vector<Entry> Passes;
+
+  /// The number of times the whole list ran.
+  unsigned Rounds = 0;
+
+public:
+  /// Registers "copy-prop", "fold", "cse", "strength-reduce" and "dce", in
+  /// that order.
+  PassManager();
+
+  /// Appends a pass.
+  void add(const std::string &Name, Pass P);
+
+  /// Runs the passes named in `Order`, in that order; the others are disabled.
+  /// \return false if a name is unknown, in which case nothing changes.
+  bool setOrder(const std::vector<std::string> &Order);
+
+  /// Stops the pass `Name` from running.
+  /// \return false if the name is unknown.
+  bool disable(const std::string &Name);
+
+  /// Runs the enabled passes in order, repeating the list until none of them
+  /// changes the function.
+  void Run(Function &F);
+
+  /// Returns the registered passes with their statistics.
+  const std::vector<Entry> &getPasses() const { return Passes; }
+
+  /// Prints the time spent in each pass.
+  void PrintTimings(std::ostream &X) const;
+};
+
+#endif
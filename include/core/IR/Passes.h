@@ -0,0 +1,50 @@
+//===--- Passes.h ---------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Optimization passes over functions in SSA form. Every pass
+// keeps the output and the reported diagnostics of the program the same.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CORE_IR_PASSES_H
+#define CORE_IR_PASSES_H
+
+struct Function;
+
+namespace Passes {
+
+/// Folds arithmetic, comparisons and logic on constants, simplifies `X + 0`,
+/// `X - 0`, `X * 1` and `X * 0`, and turns branches on a constant into jumps.
+/// Arithmetic that would overflow is left for runtime.
+/// \return whether the function changed.
+bool Fold(Function &F);
+
+/// Replaces copies by the value copied, and phis whose operands are all the
+/// same value (or the phi itself) by that value.
+/// \return whether the function changed.
+bool PropagateCopies(Function &F);
+
+/// Numbers the values of arithmetic, comparisons and logic, and replaces an
+/// instruction by an identical one in a block that always runs before it (a
+/// dominator), with the operands of `+`, `==`, `!=`, `and` and `or` in either
+/// order. Operands are values, so a variable assigned or read in between makes
+/// them differ. The later instruction could only fail where the earlier one
+/// already did, so diagnostics stay at the first occurrence.
+/// \return whether the function changed.
+bool EliminateCommon(Function &F);
+
+/// Replaces unchecked products of a loop counter and a value that does not
+/// change in the loop by a value of their own, started before the loop and
+/// stepped by an addition at the end of every iteration. Checked products are
+/// left alone, as the addition would report at a different place.
+/// \return whether the function changed.
+bool ReduceStrength(Function &F);
+
+/// Removes blocks that can not be reached and instructions whose value is
+/// never used, unless they read, write or may report a diagnostic.
+/// \return whether the function changed.
+bool EliminateDead(Function &F);
+
+} // end namespace Passes
+
+#endif
@@ -0,0 +1,149 @@
+//===--- Bytecode.h -------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: The lowered, register based form of a CORE program that is
+// executed by the `VM`.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CORE_VM_BYTECODE_H
+#define CORE_VM_BYTECODE_H
+
+#include "core/AST/Induction.h"
+#include "core/Tokenizer/Token.h"
+
+#include <sstream> // std::ostringstream
+#include <string>  // std::string
+#include <utility> // std::pair
+#include <vector>  // std::vector
+
+namespace OpCode {
+
+// Operands are listed as A, B, C in the order they appear in an `Instr`.
+enum OpCode {
+  // Stops execution.
+  halt = 0,
+
+  // A = B
+  move,
+
+  // A = B <op> C. These report overflow / underflow at the instruction's
+  // token.
+  add,
+  sub,
+  mul,
+
+  // A = B <op> C without checking, for operations the value-range analysis
+  // proved can not overflow / underflow. These wrap around, so that values
+  // computed ahead of their use (see `Passes::ReduceStrength`) are harmless.
+  add_unchecked,
+  sub_unchecked,
+  mul_unchecked,
+
+  // A = B <op> #C with the constant stored in the instruction, for the common
+  // `X = X + 1;`. These report like `add` / `sub`.
+  add_imm,
+  sub_imm,
+
+  // A = B <comp-op> C
+  cmp_not_equal,
+  cmp_equal,
+  cmp_greater_than_equal,
+  cmp_less_than_equal,
+  cmp_greater_than,
+  cmp_less_than,
+
+  // A = B && C, A = B || C, A = !B
+  logic_and,
+  logic_or,
+  logic_not,
+
+  // Jumps to instruction A.
+  jump,
+  // Jumps to instruction B if A is zero / non-zero.
+  jump_if_false,
+  jump_if_true,
+
+  // Jumps to instruction C unless A <comp-op> B, for conditions of `if` and
+  // `while` that are a single comparison.
+  jump_unless_ne,
+  jump_unless_eq,
+  jump_unless_ge,
+  jump_unless_le,
+  jump_unless_gt,
+  jump_unless_lt,
+
+  // Zeroes every register in register list A.
+  clear,
+
+  // Skips the iterations of a counting loop described by `Inductions[B]`.
+  // Register list A holds its variables, then its steps, then its bound.
+  skip_loop,
+
+  // Reads variable A from the input / writes variable A to the output.
+  read,
+  write
+};
+
+} // end namespace OpCode
+
+// How an operand of an instruction is interpreted.
+namespace OperandKind {
+enum OperandKind {
+  none = 0,
+  reg,    // A register.
+  target, // An instruction index.
+  list,   // An index into `Program::RegLists`.
+  index,  // An index into another table of the `Program`.
+  imm     // A constant value.
+};
+} // end namespace OperandKind
+
+/// Static information about an opcode.
+struct OpInfo {
+  const char *Name;
+  OperandKind::OperandKind Operands[3];
+};
+
+/// Returns the static information for the given opcode.
+const OpInfo &getOpInfo(OpCode::OpCode Op);
+
+/// A single bytecode instruction.
+struct Instr {
+  OpCode::OpCode Op;
+  unsigned A, B, C;
+
+  /// An index into `Program::Tokens` for instructions that can report a
+  /// diagnostic.
+  unsigned Loc;
+};
+
+/// A compiled CORE program. Registers [0, Names.size()) hold the declared
+/// variables, the rest hold constants and temporaries.
+struct Program {
+  /// The instructions to execute, starting from the first one.
+  std::vector<Instr> Code;
+
+  /// The identifier of each variable register, used for reading and writing.
+  std::vector<std::string> Names;
+
+  /// Registers that are initialized to a constant value before execution.
+  std::vector<std::pair<unsigned, int>> Constants;
+
+  /// Lists of registers referenced by `clear` and `skip_loop`.
+  std::vector<std::vector<unsigned>> RegLists;
+
+  /// The counting loops referenced by `skip_loop`.
+  std::vector<Induction> Inductions;
+
+  /// The source tokens used to report diagnostics.
+  std::vector<Token> Tokens;
+
+  /// The total number of registers used.
+  unsigned NumRegs = 0;
+
+  /// Prints a human readable listing of the program.
+  void Print(std::ostringstream &X) const;
+};
+
+#endif
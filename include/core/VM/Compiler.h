@@ -0,0 +1,159 @@
+//===--- Compiler.h -------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Lowers a parsed CORE abstract syntax tree into a bytecode
+// `Program`. The nodes drive the lowering (see `Node+Compile.cpp`); this class
+// owns the program being built, register allocation and loop information.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CORE_VM_COMPILER_H
+#define CORE_VM_COMPILER_H
+
+#include "core/VM/Bytecode.h"
+
+#include <map>    // std::map
+#include <set>    // std::set
+#include <string> // std::string
+#include <vector> // std::vector
+
+class Id;
+class IdList;
+class Node;
+
+class Compiler {
+  /// Temporaries are numbered from here while compiling and moved after the
+  /// permanent registers once the program is finished.
+  static const unsigned TempBase = 1u << 30;
+
+  /// A loop that is currently being compiled.
+  struct LoopScope {
+    /// Every identifier assigned to or read into by the loop.
+    std::set<std::string> Defs;
+
+    /// The register list cleared each time the loop is entered.
+    unsigned ResetList;
+  };
+
+  /// The program under construction.
+  Program *P;
+
+  /// The register of each declared identifier.
+  std::map<std::string, unsigned> Slots;
+
+  /// The register holding each constant value.
+  std::map<int, unsigned> ConstantRegs;
+
+  /// The number of registers that live for the whole program.
+  unsigned NumPermanent = 0;
+
+  /// The next free temporary and the most temporaries used at once.
+  unsigned NextTemp = 0;
+  unsigned MaxTemps = 0;
+
+  /// The loops enclosing the code being compiled, outermost first.
+  std::vector<LoopScope> Loops;
+
+  /// Whether an invariant expression is currently being hoisted.
+  bool Hoisting = false;
+
+  /// Whether loop-invariant expressions should be hoisted at all.
+  bool HoistInvariants;
+
+  /// Whether common instruction sequences are replaced by superinstructions.
+  bool Fuse;
+
+  /// Whether `and` / `or` skip the side that can not change their outcome.
+  bool ShortCircuit;
+
+  /// The number of copies of a small loop body per trip around the loop.
+  unsigned Unroll;
+
+public:
+  /// Loop bodies of at most this many instructions are unrolled.
+  static const unsigned MaxUnrollBody = 16;
+
+  /// Loops are fully unrolled up to this many instructions.
+  static const unsigned MaxFullUnroll = 256;
+
+  /// Used by nodes that do not produce a value.
+  static const unsigned NoRegister = ~0u;
+
+  explicit Compiler(bool HoistInvariants = true, bool Fuse = true,
+                    bool ShortCircuit = true, unsigned Unroll = 1);
+  ~Compiler();
+
+  /// Allocates a register for each identifier in the list.
+  void Declare(IdList *L);
+
+  /// Returns the register of a declared identifier.
+  unsigned Slot(Id *I);
+
+  /// Returns a register initialized to `Value`.
+  unsigned Constant(int Value);
+
+  /// Returns a register that is free until `ReleaseTemps` is called.
+  unsigned Temp();
+
+  /// Marks and releases the temporaries allocated since the mark. Temporaries
+  /// never live across statements.
+  unsigned MarkTemps() const { return NextTemp; }
+  void ReleaseTemps(unsigned Mark) { NextTemp = Mark; }
+
+  /// Appends an instruction and returns its index.
+  unsigned Emit(OpCode::OpCode Op, unsigned A = 0, unsigned B = 0,
+                unsigned C = 0);
+
+  /// Appends an instruction that reports diagnostics at `T`.
+  unsigned Emit(Token T, OpCode::OpCode Op, unsigned A, unsigned B,
+                unsigned C);
+
+  /// Copies register `Src` into `Dest`. When `Src` is a temporary just
+  /// computed, the instruction computing it writes to `Dest` instead.
+  void Move(unsigned Dest, unsigned Src);
+
+  /// Whether superinstructions such as `add_imm` and `jump_unless_lt` should be
+  /// selected.
+  bool fuses() const { return Fuse; }
+
+  /// Whether conditions are lowered to jumps that skip the right hand side of
+  /// `and` / `or` when the left hand side decides the outcome, like
+  /// `AST::Execute` does by default.
+  bool shortCircuits() const { return ShortCircuit; }
+
+  /// The number of copies of a small loop body to compile per trip around the
+  /// loop, each after its own test of the condition. Loops that always run a
+  /// known number of times are fully unrolled instead. 1 turns unrolling off.
+  unsigned getUnroll() const { return Unroll; }
+
+  /// The index of the next instruction.
+  unsigned Here() const { return P->Code.size(); }
+
+  /// Points the jump at `At` to the instruction at `Target`. The target may be
+  /// any operand of the jump.
+  void Patch(unsigned At, unsigned Target);
+  void Patch(const std::vector<unsigned> &Jumps, unsigned Target);
+
+  /// Enters the body of a loop that writes `Defs`.
+  void EnterLoop(const std::set<std::string> &Defs);
+  void ExitLoop();
+
+  /// Emits a `skip_loop` for the counting loop `IV` whose variables, steps and
+  /// bound live in `Regs`, in that order.
+  void SkipLoop(const Induction &IV, const std::vector<unsigned> &Regs);
+
+  /// Whether the value of `N` does not change while the innermost loop runs and
+  /// may be computed once instead.
+  bool canHoist(Node *N);
+
+  /// Compiles `N` so that it is only computed the first time it is reached
+  /// after entering the outermost loop it is invariant in. Any diagnostic is
+  /// therefore raised exactly when it would have been without hoisting.
+  /// \return the register holding the value of `N`.
+  unsigned Hoist(Node *N);
+
+  /// Finishes and returns the program. The compiler can not be used again.
+  Program *Finish();
+};
+
+#endif
@@ -0,0 +1,89 @@
+//===--- LaneVM.h ---------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: A virtual machine that executes compiled CORE bytecode for
+// several inputs at once, in lockstep.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CORE_VM_LANEVM_H
+#define CORE_VM_LANEVM_H
+
+#include "core/VM/Bytecode.h"
+
+#include <iostream> // std::istream, std::ostream
+#include <string>   // std::string
+#include <vector>   // std::vector
+
+/// Runs one program for up to `Lanes` inputs, each input being a lane. Every
+/// register holds one value per lane, stored next to each other, so that an
+/// instruction is a short loop over the lanes the compiler can vectorize.
+///
+/// The lanes that are at the same instruction run it together. Lanes that
+/// take different sides of a branch are split by a mask: the group at the
+/// lowest instruction runs first, so the others wait at the end of an `if` or
+/// loop until it catches up and the lanes run together again.
+template <unsigned Lanes> class LaneVM {
+  /// The program to execute.
+  const Program &P;
+
+  /// The register file. Register R of lane L is `Regs[R * Lanes + L]`.
+  std::vector<int> Regs;
+
+  /// The next instruction of each lane.
+  unsigned PC[Lanes];
+
+  /// Whether each lane is still running.
+  bool Live[Lanes];
+
+  /// The lanes running the current instruction.
+  bool Mask[Lanes];
+
+  /// Where each lane's `read` takes values from and `write` sends them to.
+  std::istream *In[Lanes];
+  std::ostream *Out[Lanes];
+
+  /// The runtime error each lane stopped with.
+  std::vector<std::string> Errors;
+
+  /// Returns the values of register `R`, one per lane.
+  int *lanes(unsigned R) { return &Regs[R * Lanes]; }
+
+  /// Stops lane `L` with `Error`.
+  void Fail(unsigned L, const std::string &Error);
+
+  /// Runs arithmetic instruction `I` on the masked lanes. `Deferred(L, S)`
+  /// computes the value of lane L with wrapping arithmetic, setting `S` when
+  /// it may have failed; only then is `Checked(L, Out)` asked for the exact
+  /// result, so that the lanes fail exactly like `VM` does.
+  template <typename DeferredFn, typename CheckedFn>
+  void Compute(const Instr &I, DeferredFn Deferred, CheckedFn Checked);
+
+  /// Runs `F(B, C)` on every lane, keeping the result in register A of the
+  /// masked lanes.
+  template <typename Fn> void Map(const Instr &I, Fn F);
+
+  /// Sets `Taken` for the lanes where `Holds(A, B)` does not, the jumps of
+  /// `jump_unless_<op>`.
+  template <typename Fn> void Branch(const Instr &I, bool *Taken, Fn Holds);
+
+  /// Runs the masked lanes from `PC` until they branch apart, stop or reach an
+  /// instruction other lanes wait at.
+  /// \return false once no lane is running.
+  bool Step();
+
+public:
+  LaneVM(const Program &P);
+
+  /// Executes the program once per lane, reading from `Inputs[L]` and writing
+  /// to `Outputs[L]`. At most `Lanes` streams may be passed.
+  /// \return the runtime error of each lane, formatted like `VM::Execute`,
+  /// or an empty string for a lane that finished.
+  std::vector<std::string> Execute(const std::vector<std::istream *> &Inputs,
+                                   const std::vector<std::ostream *> &Outputs);
+};
+
+extern template class LaneVM<8>;
+extern template class LaneVM<16>;
+
+#endif
@@ -0,0 +1,40 @@
+//===--- Trace.h ----------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Turns the path one iteration of a loop took through its
+// bytecode into a linear trace guarded by the outcomes of its branches.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CORE_VM_TRACE_H
+#define CORE_VM_TRACE_H
+
+#include "core/VM/Bytecode.h"
+
+#include <vector> // std::vector
+
+namespace Trace {
+
+/// Finds the loop of `P`: the instruction its back-edge jumps to and the
+/// back-edge itself. Only a program with a single loop, such as a compiled
+/// innermost loop, can be traced.
+/// \return false if `P` has no loop or more than one.
+bool FindLoop(const Program &P, unsigned &Head, unsigned &BackEdge);
+
+/// Returns a copy of `P` with a trace of `Path` appended, `Path` being the
+/// instructions one iteration ran from the head of the loop to its back-edge
+/// (see `VM::setTrace`). The back-edge is redirected to the trace.
+///
+/// The trace copies the instructions of the path without the jumps between
+/// them. Each branch becomes a guard that leaves the trace for the other
+/// side of the branch in the original code, with the same registers, and the
+/// end of the trace goes back to its start. Iterations that take the recorded
+/// path thus run without a single unconditional jump, and the others continue
+/// in the original code until its next back-edge.
+///
+/// \return the traced program, or null if `Path` is not one whole iteration.
+Program *Build(const Program &P, const std::vector<unsigned> &Path);
+
+} // namespace Trace
+
+#endif
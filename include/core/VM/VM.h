@@ -0,0 +1,100 @@
+//===--- VM.h -------------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: A virtual machine that executes compiled CORE bytecode.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CORE_VM_VM_H
+#define CORE_VM_VM_H
+
+#include "core/AST/Arithmetic.h"
+#include "core/VM/Bytecode.h"
+
+#include <iostream> // std::cin, std::cout
+#include <vector>   // std::vector
+
+class Budget;
+
+class VM {
+  /// The program to execute.
+  const Program &P;
+
+  /// The register file. Variables occupy the first registers.
+  std::vector<int> Regs;
+
+  /// Where `read` takes values from and `write` sends them to.
+  std::istream &In;
+  std::ostream &Out;
+
+  /// When set, the number of times each instruction was executed.
+  std::vector<unsigned long long> *Counts = nullptr;
+
+  /// When set, where the path of one iteration of the loop at `TraceHead` is
+  /// recorded, and how many times the head was reached so far.
+  std::vector<unsigned> *Path = nullptr;
+  unsigned TraceHead = 0;
+  unsigned Arrivals = 0;
+
+  /// Whether the run stopped after recording the path.
+  bool Stopped = false;
+
+  /// When set, the limits of the run, spent at every backward jump.
+  Budget *Limits = nullptr;
+
+  /// Records instruction `PC` into `Path`.
+  /// \return whether the path is complete and the run should stop.
+  bool Record(unsigned PC);
+
+  /// Reports the failed arithmetic of instruction `I`.
+  [[noreturn]] void Fail(const Instr &I, ArithResult::ArithResult Result);
+
+  /// Runs the program from the first instruction. Counting and recording, and
+  /// spending the budget, are template parameters so that a normal run pays
+  /// nothing for them.
+  /// \throw LocDiag, Diag, std::string on runtime errors.
+  template <bool Profiling, bool Budgeted> void Run();
+
+  /// Runs the program on the registers as they are, decorating errors.
+  void Dispatch();
+
+  /// Clears the registers and loads the constants.
+  void Reset();
+
+public:
+  VM(const Program &P, std::istream &In = std::cin,
+     std::ostream &Out = std::cout);
+
+  /// Counts how many times each instruction is executed into `C`, which is
+  /// resized to the length of the program.
+  void setProfile(std::vector<unsigned long long> *C) { Counts = C; }
+
+  /// Records into `P` the instructions of the second iteration of the loop
+  /// whose head is instruction `Head`, from the head up to the back-edge. The
+  /// run then stops before going around the loop again, so the variables are
+  /// as on entering the loop (see `Trace::Build`).
+  void setTrace(unsigned Head, std::vector<unsigned> *P) {
+    TraceHead = Head;
+    Path = P;
+  }
+
+  /// Spends a step of `B` every time a loop goes around, see `Budget`.
+  void setBudget(Budget *B) { Limits = B; }
+
+  /// Whether the last run stopped after recording its path instead of
+  /// finishing.
+  bool isStopped() const { return Stopped; }
+
+  /// Executes the program, decorating any runtime errors the same way
+  /// `AST::Execute` does.
+  /// \throw std::string describing the runtime error.
+  void Execute();
+
+  /// Executes the program with the variables starting out at `Vars`, one value
+  /// per name of the program, and stores their final values back into it. This
+  /// moves a run between the tree walker and the virtual machine.
+  /// \throw std::string describing the runtime error.
+  void Execute(std::vector<int> &Vars);
+};
+
+#endif
@@ -7,15 +7,24 @@
 
 #include "core/AST/AST.h"
 #include "core/AST/ASTContext.h"
+#include "core/AST/Checkpoint.h"
 #include "core/AST/Node.h"
+#include "core/AST/OptStats.h"
 #include "core/Diag/Diag.h"
+#include "core/IR/Builder.h"
+#include "core/VM/Compiler.h"
 
-#include <iostream> // std::cout
+#include <algorithm> // std::reverse
+#include <deque>     // std::deque
+#include <iostream>  // std::cout
+#include <string>    // std::to_string
+#include <utility>   // std::move
 
 AST::AST() : Context(*new ASTContext()) {}
 
 AST::~AST() {
   if (TranslationUnit != nullptr) delete TranslationUnit;
+  delete &Context;
 }
 
 void AST::Print() {
@@ -32,11 +41,109 @@ void AST::Print(std::ostringstream &X) {
   TranslationUnit->Print(X, 0);
 }
 
-void AST::Execute() {
-  assert(TranslationUnit != nullptr && "Can not interpret an empty AST.");
+void AST::Mix(const std::string &Data) {
+  // FNV-1a, with a terminator so that the pieces can not run together.
+  for (char C : Data + '\0') {
+    Fingerprint = (Fingerprint ^ (unsigned char)C) * 1099511628211ULL;
+  }
+}
+
+unsigned long long AST::getFingerprint(bool ShortCircuit) const {
+  return ShortCircuit ? Fingerprint : ~Fingerprint;
+}
+
+void AST::Fold() {
+  assert(TranslationUnit != nullptr && "Can not fold an empty AST.");
+  Mix("fold");
+
+  TranslationUnit->Fold();
+  TranslationUnit->Select();
+}
+
+unsigned AST::Specialize(const std::vector<int> &Inputs, OptStats &S) {
+  assert(TranslationUnit != nullptr && "Can not specialize an empty AST.");
+
+  std::deque<int> Known(Inputs.begin(), Inputs.end());
+  while (true) {
+    size_t Before = Known.size();
+    bool Done = TranslationUnit->Specialize(Known);
+    if (Known.size() == Before) break;
+
+    // The new constants may decide branches, bringing the reads in them to
+    // the top level.
+    Fold();
+    Prune(S);
+    if (Done) break;
+  }
+
+  unsigned Used = Inputs.size() - Known.size();
+  Mix("known");
+  for (unsigned K = 0; K < Used; ++K) {
+    Mix(std::to_string(Inputs[K]));
+  }
+  return Used;
+}
+
+void AST::Prune(OptStats &S) {
+  assert(TranslationUnit != nullptr && "Can not prune an empty AST.");
+  Mix("prune");
+
+  ConstEnv Env;
+  TranslationUnit->Propagate(Env, S);
+
+  // Nothing is read once the program ends.
+  std::set<std::string> Live;
+  TranslationUnit->Liveness(Live, &S);
+  TranslationUnit->Select();
+}
+
+void AST::AnalyzeRanges(OptStats &S) {
+  assert(TranslationUnit != nullptr && "Can not analyze an empty AST.");
+  Mix("ranges");
 
+  RangeEnv Env;
+  TranslationUnit->Bound(Env, &S);
+  TranslationUnit->Select();
+}
+
+void AST::FindInductions(OptStats &S) {
+  assert(TranslationUnit != nullptr && "Can not analyze an empty AST.");
+  Mix("closed-form");
+  TranslationUnit->FindInductions(S);
+}
+
+void AST::Compile(Compiler &C) {
+  assert(TranslationUnit != nullptr && "Can not compile an empty AST.");
+
+  TranslationUnit->Compile(C);
+}
+
+void AST::Lower(Function &F, bool ShortCircuit) {
+  assert(TranslationUnit != nullptr && "Can not lower an empty AST.");
+
+  IRBuilder B(F, ShortCircuit);
+  TranslationUnit->Lower(B);
+}
+
+void AST::CompileLoop(const Loop *L, Compiler &C) const {
+  assert(TranslationUnit != nullptr && "Can not compile an empty AST.");
+
+  static_cast<Prog *>(TranslationUnit)->getDeclSeq()->Compile(C);
+  // Lowering only reads the tree; `Compile` is not const as it also lowers
+  // the whole program in place of the parser's tree.
+  const_cast<Loop *>(L)->Compile(C);
+  C.Emit(OpCode::halt);
+}
+
+void AST::Execute(bool DeferChecks, bool ShortCircuit) const {
+  Execute(std::cin, std::cout, DeferChecks, ShortCircuit);
+}
+
+/// Runs `Body`, turning diagnostics into the messages reported to the user.
+/// \throw std::string the message of a diagnostic.
+static void reportDiags(const std::function<void()> &Body) {
   try {
-    TranslationUnit->Execute(Context);
+    Body();
   } catch (LocDiag &D) {
     std::ostringstream error;
     Token t = D.getToken();
@@ -50,3 +157,96 @@ void AST::Execute() {
     throw error.str();
   }
 }
+
+void AST::Execute(std::istream &In, std::ostream &Out, bool DeferChecks,
+                  bool ShortCircuit, Tiers *T, Budget *Limits) const {
+  assert(TranslationUnit != nullptr && "Can not interpret an empty AST.");
+
+  ASTContext Run(Context, In, Out);
+  Run.setDeferChecks(DeferChecks);
+  Run.setShortCircuit(ShortCircuit);
+  Run.setTiers(T);
+  Run.setBudget(Limits);
+  reportDiags([&]() { TranslationUnit->Execute(Run); });
+}
+
+void AST::Execute(std::istream &In, std::ostream &Out,
+                  volatile std::sig_atomic_t *Request,
+                  const std::function<bool(const Checkpoint &)> &Save,
+                  const Checkpoint *From, bool DeferChecks,
+                  bool ShortCircuit, Budget *Limits) const {
+  assert(TranslationUnit != nullptr && "Can not interpret an empty AST.");
+
+  ASTContext Run(Context, In, Out);
+  Run.setDeferChecks(DeferChecks);
+  Run.setShortCircuit(ShortCircuit);
+  Run.setCheckpointRequest(Request);
+  Run.setBudget(Limits);
+  Run.setFingerprint(getFingerprint(ShortCircuit));
+  if (From != nullptr && !Run.Restore(*From)) {
+    std::string Error = "The checkpoint does not match the program.";
+    throw Error;
+  }
+
+  const Prog *P = static_cast<const Prog *>(TranslationUnit);
+  std::vector<unsigned> Path;
+  if (From != nullptr) Path = From->Path;
+  reportDiags([&]() {
+    while (true) {
+      try {
+        if (Path.empty()) {
+          P->Execute(Run);
+        } else {
+          P->Resume(Run, Path, 0);
+        }
+        return;
+      } catch (Checkpoint &CP) {
+        // The path was built from the innermost statement outwards.
+        std::reverse(CP.Path.begin(), CP.Path.end());
+        Run.Save(CP);
+        if (Request != nullptr) *Request = 0;
+        if (!Save(CP)) return;
+        Path = CP.Path;
+      }
+    }
+  });
+}
+
+bool AST::ExecuteUntilRead(std::istream &In, std::ostream &Out,
+                           unsigned long long Supplied, Checkpoint &State,
+                           bool Resume, std::string &Waiting, bool DeferChecks,
+                           bool ShortCircuit, Budget *Limits) const {
+  assert(TranslationUnit != nullptr && "Can not interpret an empty AST.");
+
+  ASTContext Run(Context, In, Out);
+  Run.setDeferChecks(DeferChecks);
+  Run.setShortCircuit(ShortCircuit);
+  Run.setSupplied(Supplied);
+  Run.setBudget(Limits);
+  Run.setFingerprint(getFingerprint(ShortCircuit));
+  if (Resume && !Run.Restore(State)) {
+    std::string Error = "The checkpoint does not match the program.";
+    throw Error;
+  }
+
+  const Prog *P = static_cast<const Prog *>(TranslationUnit);
+  bool Finished = true;
+  Waiting.clear();
+  reportDiags([&]() {
+    try {
+      if (Resume) {
+        P->Resume(Run, State.Path, 0);
+      } else {
+        P->Execute(Run);
+      }
+    } catch (Checkpoint &CP) {
+      // Stopped at the `read` or the loop, which runs again when resumed.
+      std::reverse(CP.Path.begin(), CP.Path.end());
+      Run.Save(CP);
+      State = std::move(CP);
+      Finished = false;
+      if (Run.getWaiting() != nullptr) Waiting = Run.getWaiting()->getName();
+    }
+  });
+  return Finished;
+}
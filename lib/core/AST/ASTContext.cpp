@@ -7,10 +7,25 @@
 //===----------------------------------------------------------------------===//
 
 #include "core/AST/ASTContext.h"
+#include "core/AST/Checkpoint.h"
 #include "core/AST/Node.h"
 #include "core/Diag/Diag.h"
 
-#include <iostream> // std::cout, std::endl
+#include <iostream> // std::endl
+
+ASTContext::ASTContext(const ASTContext &Declarations, std::istream &In,
+                       std::ostream &Out)
+    : In(&In), Out(&Out) {
+  for (auto &Entry : Declarations.SM) {
+    SM[Entry.first] = new IdSym;
+  }
+}
+
+ASTContext::~ASTContext() {
+  for (auto &Entry : SM) {
+    delete Entry.second;
+  }
+}
 
 void ASTContext::Declare(IdList *L) {
   if (Has(L->getId())) {
@@ -34,11 +49,7 @@ void ASTContext::Reference(IdList *L) {
 }
 
 void ASTContext::Reference(Id *I) {
-  IdSym *Sym = SM[I->getName()];
-
-  if (Sym == nullptr) {
-    throw Diag(DiagType::parser_undeclared_identifier, I->getName().c_str());
-  }
+  IdSym *Sym = FetchId(I);
 
   if (!Sym->Initialized) {
     throw Diag(DiagType::parser_uninitialized_identifier, I->getName().c_str());
@@ -51,14 +62,19 @@ bool ASTContext::Has(Id *I) {
   return IT != SM.end();
 }
 
+IdSym *ASTContext::Lookup(const std::string &Name) {
+  auto It = SM.find(Name);
+  return It == SM.end() ? nullptr : It->second;
+}
+
 IdSym *ASTContext::FetchId(Id *I) {
-  IdSym *Sym = SM[I->getName()];
+  auto It = SM.find(I->getName());
 
-  if (Sym == nullptr) {
+  if (It == SM.end()) {
     throw Diag(DiagType::parser_undeclared_identifier, I->getName().c_str());
   }
 
-  return Sym;
+  return It->second;
 }
 
 void ASTContext::Initialize(Id *I) {
@@ -94,12 +110,13 @@ int ASTContext::Get(Id *I) {
 
 void ASTContext::SetFromIn(IdList *L) {
   int i;
-  std::cout << L->getId()->getName() << " =? ";
-  std::cin >> i;
-  if (std::cin.fail()) {
+  *Out << L->getId()->getName() << " =? ";
+  *In >> i;
+  if (In->fail()) {
     std::string Error = "Invalid integer input.";
     throw Error;
   }
+  ++Reads;
   Set(L->getId(), i);
 
   if (L->getSeq() != nullptr) {
@@ -107,11 +124,53 @@ void ASTContext::SetFromIn(IdList *L) {
   }
 }
 
+void ASTContext::WaitForIn(IdList *L) {
+  // Nothing is read until the whole list can be, so that running the
+  // statement again once the values arrive reads them all in order.
+  for (unsigned long long Next = Reads; L != nullptr; L = L->getSeq(), ++Next) {
+    if (Next >= Supplied) {
+      Waiting = L->getId();
+      throw Checkpoint();
+    }
+  }
+}
+
 void ASTContext::WriteToOut(IdList *L) {
   int i = Get(L->getId());
-  std::cout << L->getId()->getName() << " = " << i << std::endl;
+  *Out << L->getId()->getName() << " = " << i << std::endl;
 
   if (L->getSeq() != nullptr) {
     WriteToOut(L->getSeq());
   }
 }
+
+void ASTContext::Save(Checkpoint &CP) const {
+  // The names are sorted, so a run of the same program has the same order.
+  CP.Slots.clear();
+  for (auto &Entry : SM) {
+    CP.Slots.push_back(*Entry.second);
+  }
+  // Asking a stream at its end for its position would make it fail.
+  CP.InputOffset = In->good() ? (long long)In->tellg() : -1;
+  CP.Reads = Reads;
+  CP.Program = Fingerprint;
+}
+
+bool ASTContext::Restore(const Checkpoint &CP) {
+  if (CP.Program != Fingerprint || CP.Slots.size() != SM.size()) return false;
+
+  unsigned K = 0;
+  for (auto &Entry : SM) {
+    *Entry.second = CP.Slots[K++];
+  }
+  Reads = CP.Reads;
+  if (CP.InputOffset >= 0 && In->seekg(CP.InputOffset)) return true;
+
+  // Streams that can not seek, such as a pipe, are replayed from the start.
+  In->clear();
+  int Skipped;
+  for (unsigned long long R = 0; R < CP.Reads; ++R) {
+    if (!(*In >> Skipped)) break;
+  }
+  return true;
+}
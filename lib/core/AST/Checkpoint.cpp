@@ -0,0 +1,90 @@
+//===--- Checkpoint.cpp ---------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements writing and reading checkpoints.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/AST/Checkpoint.h"
+
+#include <cstring> // std::memcmp
+
+/// Identifies the file, followed by the version of the format.
+static const char Magic[8] = {'C', 'O', 'R', 'E', 'C', 'K', 'P', 'T'};
+static const unsigned Version = 2;
+
+/// Writes the low `Bytes` bytes of `V`, least significant first.
+static void put(std::ostream &X, unsigned long long V, unsigned Bytes) {
+  for (unsigned B = 0; B < Bytes; ++B) {
+    X.put((char)(V >> (8 * B)));
+  }
+}
+
+/// Reads a value written by `put`.
+static bool get(std::istream &X, unsigned long long &V, unsigned Bytes) {
+  V = 0;
+  for (unsigned B = 0; B < Bytes; ++B) {
+    int C = X.get();
+    if (C == std::char_traits<char>::eof()) return false;
+    V |= (unsigned long long)(unsigned char)C << (8 * B);
+  }
+  return true;
+}
+
+void Checkpoint::Write(std::ostream &X) const {
+  X.write(Magic, sizeof(Magic));
+  put(X, Version, 4);
+  put(X, Program, 8);
+
+  put(X, Slots.size(), 4);
+  for (const IdSym &Slot : Slots) {
+    put(X, Slot.Initialized, 1);
+    put(X, (unsigned)Slot.Value, 4);
+  }
+  put(X, Path.size(), 4);
+  for (unsigned Index : Path) {
+    put(X, Index, 4);
+  }
+  put(X, InputOffset, 8);
+  put(X, Reads, 8);
+}
+
+bool Checkpoint::Read(std::istream &X, Checkpoint &CP) {
+  char Header[sizeof(Magic)];
+  unsigned long long V;
+  if (!X.read(Header, sizeof(Header)) ||
+      std::memcmp(Header, Magic, sizeof(Magic)) != 0 || !get(X, V, 4) ||
+      V != Version) {
+    return false;
+  }
+  if (!get(X, CP.Program, 8)) return false;
+
+  // The slots and the path grow one entry at a time, so a corrupt count stops
+  // at the end of the file instead of allocating it all up front.
+  if (!get(X, V, 4)) return false;
+  CP.Slots.clear();
+  for (unsigned long long K = 0; K < V; ++K) {
+    unsigned long long Initialized, Value;
+    if (!get(X, Initialized, 1) || !get(X, Value, 4) || Initialized > 1) {
+      return false;
+    }
+    IdSym Slot;
+    Slot.Initialized = Initialized;
+    Slot.Value = (int)(unsigned)Value;
+    CP.Slots.push_back(Slot);
+  }
+
+  if (!get(X, V, 4)) return false;
+  CP.Path.clear();
+  for (unsigned long long K = 0; K < V; ++K) {
+    unsigned long long Index;
+    if (!get(X, Index, 4)) return false;
+    CP.Path.push_back(Index);
+  }
+
+  unsigned long long Offset, Reads;
+  if (!get(X, Offset, 8) || !get(X, Reads, 8)) return false;
+  CP.InputOffset = (long long)Offset;
+  CP.Reads = Reads;
+  return X.peek() == std::char_traits<char>::eof();
+}
@@ -0,0 +1,98 @@
+//===--- Induction.cpp ----------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements the closed-form evaluation of counting loops.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/AST/Induction.h"
+#include "core/Tokenizer/Token.h"
+
+#include <algorithm> // std::min
+#include <limits.h>  // INT_MAX, INT_MIN
+
+/// No limit on the number of iterations.
+static const long long Unbounded = -1;
+
+static long long floorDiv(long long N, long long D) {
+  long long Q = N / D;
+  return (N % D != 0 && (N < 0) != (D < 0)) ? Q - 1 : Q;
+}
+
+static long long ceilDiv(long long N, long long D) {
+  return -floorDiv(-N, D);
+}
+
+/// Keeps the smaller of two limits.
+static long long minLimit(long long A, long long B) {
+  if (A == Unbounded) return B;
+  if (B == Unbounded) return A;
+  return std::min(A, B);
+}
+
+/// The number of iterations `J = 0, 1, ...` for which `Start + J * Delta`
+/// compares to `Bound` with `CompType`.
+static long long countTrue(long long Start, long long Delta, long long Bound,
+                           unsigned CompType) {
+  switch (CompType) {
+  case TokenType::comp_less_than:
+    if (Start >= Bound) return 0;
+    return Delta <= 0 ? Unbounded : ceilDiv(Bound - Start, Delta);
+  case TokenType::comp_less_than_equal:
+    if (Start > Bound) return 0;
+    return Delta <= 0 ? Unbounded : floorDiv(Bound - Start, Delta) + 1;
+  case TokenType::comp_greater_than:
+    if (Start <= Bound) return 0;
+    return Delta >= 0 ? Unbounded : ceilDiv(Start - Bound, -Delta);
+  case TokenType::comp_greater_than_equal:
+    if (Start < Bound) return 0;
+    return Delta >= 0 ? Unbounded : floorDiv(Start - Bound, -Delta) + 1;
+  case TokenType::comp_equal:
+    if (Start != Bound) return 0;
+    return Delta == 0 ? Unbounded : 1;
+  case TokenType::comp_not_equal:
+    if (Start == Bound) return 0;
+    if (Delta == 0 || (Bound - Start) % Delta != 0) return Unbounded;
+    return (Bound - Start) / Delta > 0 ? (Bound - Start) / Delta : Unbounded;
+  }
+  return 0;
+}
+
+/// The number of iterations `K = 1, 2, ...` for which `First + (K - 1) *
+/// Delta` stays within an `int`.
+static long long countInRange(long long First, long long Delta) {
+  if (First < INT_MIN || First > INT_MAX) return 0;
+  if (Delta > 0) return floorDiv(INT_MAX - First, Delta) + 1;
+  if (Delta < 0) return floorDiv(First - INT_MIN, -Delta) + 1;
+  return Unbounded;
+}
+
+long long Induction::Skip(int *Values, const int *Steps, int Bound) const {
+  // How much each variable changes over a whole iteration.
+  std::vector<long long> Delta(NumVars, 0);
+  for (unsigned U = 0; U < Updates.size(); ++U) {
+    Delta[Updates[U].Var] += Updates[U].Subtract ? -(long long)Steps[U]
+                                                 : (long long)Steps[U];
+  }
+
+  long long Limit = countTrue(Values[CondVar], Delta[CondVar], Bound, CompType);
+
+  // Each update is checked on its own, against the value it produces in the
+  // first iteration and the change from one iteration to the next.
+  std::vector<long long> Partial(NumVars, 0);
+  for (unsigned U = 0; U < Updates.size(); ++U) {
+    unsigned Var = Updates[U].Var;
+    Partial[Var] += Updates[U].Subtract ? -(long long)Steps[U]
+                                        : (long long)Steps[U];
+    Limit = minLimit(Limit,
+                     countInRange(Values[Var] + Partial[Var], Delta[Var]));
+  }
+
+  // Never try to skip a loop that does not end.
+  if (Limit == Unbounded || Limit <= 0) return 0;
+
+  for (unsigned Var = 0; Var < NumVars; ++Var) {
+    Values[Var] = (int)(Values[Var] + Limit * Delta[Var]);
+  }
+  return Limit;
+}
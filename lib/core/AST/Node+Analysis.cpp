@@ -0,0 +1,184 @@
+//===--- Node+Analysis.cpp ------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements methods for collecting which identifiers `Node`s read
+//   (uses) and write (defs). Used by the optimizations.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/AST/Node.h"
+
+//===----------------------------------------------------------------------===//
+// Analysis: top level
+//===----------------------------------------------------------------------===//
+
+/// <prog> ::= program <decl-seq> begin <stmt-seq> end
+void Prog::CollectUses(std::set<std::string> &Uses) {
+  StmtSeq->CollectUses(Uses);
+}
+
+void Prog::CollectDefs(std::set<std::string> &Defs) {
+  StmtSeq->CollectDefs(Defs);
+}
+
+//===----------------------------------------------------------------------===//
+// Analysis: sequence-like grammar rules (<x-seq> ::= <x> <x-seq>)
+//===----------------------------------------------------------------------===//
+
+/// <decl-seq> ::= <decl> | <decl> <decl-seq>
+/// Declaring an identifier neither reads nor changes its value.
+void DeclSeq::CollectUses(std::set<std::string> & /*Uses*/) {}
+void DeclSeq::CollectDefs(std::set<std::string> & /*Defs*/) {}
+
+/// <stmt-seq> ::= <stmt> | <stmt> <stmt-seq>
+void StmtSeq::CollectUses(std::set<std::string> &Uses) {
+  if (isEmpty()) return;
+  Stmt->CollectUses(Uses);
+  if (Seq != nullptr) {
+    Seq->CollectUses(Uses);
+  }
+}
+
+void StmtSeq::CollectDefs(std::set<std::string> &Defs) {
+  if (isEmpty()) return;
+  Stmt->CollectDefs(Defs);
+  if (Seq != nullptr) {
+    Seq->CollectDefs(Defs);
+  }
+}
+
+/// <id-list> ::= <id> | <id> <id-list>
+/// Whether the identifiers are read or written depends on the statement that
+/// owns the list, so both collect every identifier.
+void IdList::CollectUses(std::set<std::string> &Uses) {
+  Id->CollectUses(Uses);
+  if (Seq != nullptr) {
+    Seq->CollectUses(Uses);
+  }
+}
+
+void IdList::CollectDefs(std::set<std::string> &Defs) {
+  Id->CollectDefs(Defs);
+  if (Seq != nullptr) {
+    Seq->CollectDefs(Defs);
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// Analysis: elements of sequence-like grammar rules
+//===----------------------------------------------------------------------===//
+
+/// <decl> ::= int <id-list>;
+void Decl::CollectUses(std::set<std::string> & /*Uses*/) {}
+void Decl::CollectDefs(std::set<std::string> & /*Defs*/) {}
+
+/// <stmt> ::= <assign> | <if> | <loop> | <in> | <out>
+void Stmt::CollectUses(std::set<std::string> &Uses) { Node->CollectUses(Uses); }
+void Stmt::CollectDefs(std::set<std::string> &Defs) { Node->CollectDefs(Defs); }
+
+/// <id> ::= <let-seq> | <let-seq><int>
+void Id::CollectUses(std::set<std::string> &Uses) { Uses.insert(Name); }
+void Id::CollectDefs(std::set<std::string> &Defs) { Defs.insert(Name); }
+
+//===----------------------------------------------------------------------===//
+// Analysis: specific statements
+//===----------------------------------------------------------------------===//
+
+/// <assign> ::= <id> = <exp>;
+void Assign::CollectUses(std::set<std::string> &Uses) {
+  Exp->CollectUses(Uses);
+}
+
+void Assign::CollectDefs(std::set<std::string> &Defs) {
+  Id->CollectDefs(Defs);
+}
+
+/// <if> ::= if <cond> then <stmt-seq> end;
+///        | if <cond> then <stmt-seq> else <stmt-seq> end;
+void If::CollectUses(std::set<std::string> &Uses) {
+  Cond->CollectUses(Uses);
+  IfSeq->CollectUses(Uses);
+  if (ElseSeq != nullptr) {
+    ElseSeq->CollectUses(Uses);
+  }
+}
+
+void If::CollectDefs(std::set<std::string> &Defs) {
+  IfSeq->CollectDefs(Defs);
+  if (ElseSeq != nullptr) {
+    ElseSeq->CollectDefs(Defs);
+  }
+}
+
+/// <loop> ::= while <cond> loop <stmt-seq> end;
+void Loop::CollectUses(std::set<std::string> &Uses) {
+  Cond->CollectUses(Uses);
+  Seq->CollectUses(Uses);
+}
+
+void Loop::CollectDefs(std::set<std::string> &Defs) { Seq->CollectDefs(Defs); }
+
+/// <in> ::= read <id-list>;
+void In::CollectUses(std::set<std::string> & /*Uses*/) {}
+void In::CollectDefs(std::set<std::string> &Defs) { Seq->CollectDefs(Defs); }
+
+/// <out> ::= write <id-list>;
+void Out::CollectUses(std::set<std::string> &Uses) { Seq->CollectUses(Uses); }
+void Out::CollectDefs(std::set<std::string> & /*Defs*/) {}
+
+/// <cond> ::= <comp> | !<cond> | [ <cond> and <cond> ] | [ <cond> or <cond> ]
+void Cond::CollectUses(std::set<std::string> &Uses) {
+  if (Comp != nullptr) {
+    Comp->CollectUses(Uses);
+    return;
+  }
+  if (LHSCond != nullptr) {
+    LHSCond->CollectUses(Uses);
+  }
+  RHSCond->CollectUses(Uses);
+}
+
+void Cond::CollectDefs(std::set<std::string> & /*Defs*/) {}
+
+/// <comp> ::= ( <fac> <comp-op> <fac> )
+void Comp::CollectUses(std::set<std::string> &Uses) {
+  LHSFac->CollectUses(Uses);
+  RHSFac->CollectUses(Uses);
+}
+
+void Comp::CollectDefs(std::set<std::string> & /*Defs*/) {}
+
+//===----------------------------------------------------------------------===//
+// Analysis: math related statements
+//===----------------------------------------------------------------------===//
+
+/// <fac> ::= <int> | <id> | ( <exp> )
+void Fac::CollectUses(std::set<std::string> &Uses) {
+  if (Id != nullptr) {
+    Id->CollectUses(Uses);
+  } else if (Exp != nullptr) {
+    Exp->CollectUses(Uses);
+  }
+}
+
+void Fac::CollectDefs(std::set<std::string> & /*Defs*/) {}
+
+/// <exp> ::= <term> | <term> + <exp> | <term> - <exp>
+void Exp::CollectUses(std::set<std::string> &Uses) {
+  LHSTerm->CollectUses(Uses);
+  if (RHSExp != nullptr) {
+    RHSExp->CollectUses(Uses);
+  }
+}
+
+void Exp::CollectDefs(std::set<std::string> & /*Defs*/) {}
+
+/// <term> ::= <fac> | <fac> * <term>
+void Term::CollectUses(std::set<std::string> &Uses) {
+  LHSFac->CollectUses(Uses);
+  if (RHSTerm != nullptr) {
+    RHSTerm->CollectUses(Uses);
+  }
+}
+
+void Term::CollectDefs(std::set<std::string> & /*Defs*/) {}
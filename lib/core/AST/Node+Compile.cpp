@@ -0,0 +1,352 @@
+//===--- Node+Compile.cpp -------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements methods for lowering `Node`s to bytecode.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/AST/Node.h"
+#include "core/VM/Compiler.h"
+
+//===----------------------------------------------------------------------===//
+// Compiling: helper functions
+//===----------------------------------------------------------------------===//
+
+/// The jump taken unless `CompType` holds, or unless it does not hold if
+/// `Negate` is set.
+static OpCode::OpCode jumpUnless(unsigned CompType, bool Negate) {
+  switch (CompType) {
+  case TokenType::comp_not_equal:
+    return Negate ? OpCode::jump_unless_eq : OpCode::jump_unless_ne;
+  case TokenType::comp_less_than:
+    return Negate ? OpCode::jump_unless_ge : OpCode::jump_unless_lt;
+  case TokenType::comp_greater_than:
+    return Negate ? OpCode::jump_unless_le : OpCode::jump_unless_gt;
+  case TokenType::comp_less_than_equal:
+    return Negate ? OpCode::jump_unless_gt : OpCode::jump_unless_le;
+  case TokenType::comp_greater_than_equal:
+    return Negate ? OpCode::jump_unless_lt : OpCode::jump_unless_ge;
+  case TokenType::comp_equal:
+    return Negate ? OpCode::jump_unless_ne : OpCode::jump_unless_eq;
+  }
+  assert(false && "Unknown comparison.");
+  return OpCode::jump_unless_eq;
+}
+
+void Cond::CompileBranch(Compiler &C, bool When,
+                         std::vector<unsigned> &Jumps) {
+  if (Comp != nullptr) {
+    Comp->CompileBranch(C, When, Jumps);
+    return;
+  }
+  if (!C.shortCircuits()) {
+    Jumps.push_back(C.Emit(When ? OpCode::jump_if_true : OpCode::jump_if_false,
+                           Compile(C)));
+    return;
+  }
+  if (CondType == TokenType::exclamation_mark) {
+    RHSCond->CompileBranch(C, !When, Jumps);
+    return;
+  }
+
+  // Jumping when an `and` is false / an `or` is true: either side decides.
+  if ((CondType == TokenType::rw_and) != When) {
+    LHSCond->CompileBranch(C, When, Jumps);
+    RHSCond->CompileBranch(C, When, Jumps);
+    return;
+  }
+
+  // Otherwise the left hand side alone can only decide the opposite outcome,
+  // which skips the right hand side and falls through.
+  std::vector<unsigned> Skip;
+  LHSCond->CompileBranch(C, !When, Skip);
+  RHSCond->CompileBranch(C, When, Jumps);
+  C.Patch(Skip, C.Here());
+}
+
+void Comp::CompileBranch(Compiler &C, bool When,
+                         std::vector<unsigned> &Jumps) {
+  // A hoisted comparison is already a value.
+  if (!C.fuses() || C.canHoist(this)) {
+    Jumps.push_back(C.Emit(When ? OpCode::jump_if_true : OpCode::jump_if_false,
+                           Compile(C)));
+    return;
+  }
+
+  unsigned LHS = LHSFac->Compile(C);
+  unsigned RHS = RHSFac->Compile(C);
+  Jumps.push_back(C.Emit(jumpUnless(CompType, When), LHS, RHS));
+}
+
+//===----------------------------------------------------------------------===//
+// Compiling: top level
+//===----------------------------------------------------------------------===//
+
+/// <prog> ::= program <decl-seq> begin <stmt-seq> end
+unsigned Prog::Compile(Compiler &C) {
+  DeclSeq->Compile(C);
+  StmtSeq->Compile(C);
+  C.Emit(OpCode::halt);
+  return Compiler::NoRegister;
+}
+
+//===----------------------------------------------------------------------===//
+// Compiling: sequence-like grammar rules (<x-seq> ::= <x> <x-seq>)
+//===----------------------------------------------------------------------===//
+
+/// <decl-seq> ::= <decl> | <decl> <decl-seq>
+unsigned DeclSeq::Compile(Compiler &C) {
+  Decl->Compile(C);
+  if (Seq != nullptr) {
+    Seq->Compile(C);
+  }
+  return Compiler::NoRegister;
+}
+
+/// <stmt-seq> ::= <stmt> | <stmt> <stmt-seq>
+unsigned StmtSeq::Compile(Compiler &C) {
+  if (isEmpty()) return Compiler::NoRegister;
+  Stmt->Compile(C);
+  if (Seq != nullptr) {
+    Seq->Compile(C);
+  }
+  return Compiler::NoRegister;
+}
+
+/// <id-list> ::= <id> | <id> <id-list>
+unsigned IdList::Compile(Compiler & /*C*/) {
+  assert(false && "IdList should not be envoked for compiling.");
+  return Compiler::NoRegister;
+}
+
+//===----------------------------------------------------------------------===//
+// Compiling: elements of sequence-like grammar rules
+//===----------------------------------------------------------------------===//
+
+/// <decl> ::= int <id-list>;
+unsigned Decl::Compile(Compiler &C) {
+  C.Declare(Seq);
+  return Compiler::NoRegister;
+}
+
+/// <stmt> ::= <assign> | <if> | <loop> | <in> | <out>
+unsigned Stmt::Compile(Compiler &C) {
+  // No value lives across statements so their temporaries can be reused.
+  unsigned Mark = C.MarkTemps();
+  Node->Compile(C);
+  C.ReleaseTemps(Mark);
+  return Compiler::NoRegister;
+}
+
+/// <id> ::= <let-seq> | <let-seq><int>
+/// The value of an identifier lives in its own register.
+unsigned Id::Compile(Compiler &C) { return C.Slot(this); }
+
+//===----------------------------------------------------------------------===//
+// Compiling: specific statements
+//===----------------------------------------------------------------------===//
+
+/// <assign> ::= <id> = <exp>;
+unsigned Assign::Compile(Compiler &C) {
+  C.Move(C.Slot(Id), Exp->Compile(C));
+  return Compiler::NoRegister;
+}
+
+/// <if> ::= if <cond> then <stmt-seq> end;
+///        | if <cond> then <stmt-seq> else <stmt-seq> end;
+unsigned If::Compile(Compiler &C) {
+  std::vector<unsigned> ToElse;
+  Cond->CompileBranch(C, false, ToElse);
+  IfSeq->Compile(C);
+  if (ElseSeq != nullptr) {
+    unsigned ToEnd = C.Emit(OpCode::jump);
+    C.Patch(ToElse, C.Here());
+    ElseSeq->Compile(C);
+    C.Patch(ToEnd, C.Here());
+  } else {
+    C.Patch(ToElse, C.Here());
+  }
+  return Compiler::NoRegister;
+}
+
+/// <loop> ::= while <cond> loop <stmt-seq> end;
+unsigned Loop::Compile(Compiler &C) {
+  std::set<std::string> Defs;
+  CollectDefs(Defs);
+  C.EnterLoop(Defs);
+
+  if (IV != nullptr) {
+    // Variables, steps and bound are identifiers or constants, which already
+    // live in a register.
+    std::vector<unsigned> Regs;
+    for (class Id *V : IVVars) {
+      Regs.push_back(V->Compile(C));
+    }
+    for (Fac *F : IVSteps) {
+      Regs.push_back(F->Compile(C));
+    }
+    Regs.push_back(IVBound->Compile(C));
+    C.SkipLoop(*IV, Regs);
+  }
+
+  // A loop known to run `Trips` times needs no condition at all. The first
+  // copy of the body tells whether the others fit; if not, the rest of the
+  // iterations run in the loop below.
+  if (C.getUnroll() > 1 && IV == nullptr && Trips > 0) {
+    unsigned Start = C.Here();
+    Seq->Compile(C);
+    if ((C.Here() - Start) * Trips <= Compiler::MaxFullUnroll) {
+      for (int N = 1; N < Trips; ++N) {
+        Seq->Compile(C);
+      }
+      C.ExitLoop();
+      return Compiler::NoRegister;
+    }
+  }
+
+  unsigned Head = C.Here();
+  std::vector<unsigned> ToExit;
+  Cond->CompileBranch(C, false, ToExit);
+  unsigned Start = C.Here();
+  Seq->Compile(C);
+
+  // Small bodies are repeated, testing the condition between the copies, to
+  // save the jump back.
+  if (C.Here() - Start <= Compiler::MaxUnrollBody) {
+    for (unsigned Copy = 1; Copy < C.getUnroll(); ++Copy) {
+      Cond->CompileBranch(C, false, ToExit);
+      Seq->Compile(C);
+    }
+  }
+  C.Emit(OpCode::jump, Head);
+  C.Patch(ToExit, C.Here());
+
+  C.ExitLoop();
+  return Compiler::NoRegister;
+}
+
+/// <in> ::= read <id-list>;
+unsigned In::Compile(Compiler &C) {
+  IdList *L = Seq;
+  for (int Value : Known) {
+    C.Move(C.Slot(L->getId()), C.Constant(Value));
+    L = L->getSeq();
+  }
+  for (; L != nullptr; L = L->getSeq()) {
+    C.Emit(OpCode::read, C.Slot(L->getId()));
+  }
+  return Compiler::NoRegister;
+}
+
+/// <out> ::= write <id-list>;
+unsigned Out::Compile(Compiler &C) {
+  for (IdList *L = Seq; L != nullptr; L = L->getSeq()) {
+    C.Emit(OpCode::write, C.Slot(L->getId()));
+  }
+  return Compiler::NoRegister;
+}
+
+/// <cond> ::= <comp> | !<cond> | [ <cond> and <cond> ] | [ <cond> or <cond> ]
+unsigned Cond::Compile(Compiler &C) {
+  if (Comp != nullptr) {
+    return Comp->Compile(C);
+  }
+
+  unsigned Result = C.Temp();
+  if (CondType == TokenType::exclamation_mark) {
+    C.Emit(OpCode::logic_not, Result, RHSCond->Compile(C));
+    return Result;
+  }
+
+  // Both sides are evaluated, just like `Cond::Execute` without
+  // short-circuiting.
+  unsigned LHS = LHSCond->Compile(C);
+  unsigned RHS = RHSCond->Compile(C);
+  C.Emit(CondType == TokenType::rw_and ? OpCode::logic_and : OpCode::logic_or,
+         Result, LHS, RHS);
+  return Result;
+}
+
+/// <comp> ::= ( <fac> <comp-op> <fac> )
+unsigned Comp::Compile(Compiler &C) {
+  if (C.canHoist(this)) return C.Hoist(this);
+
+  unsigned LHS = LHSFac->Compile(C);
+  unsigned RHS = RHSFac->Compile(C);
+  unsigned Result = C.Temp();
+
+  OpCode::OpCode Op = OpCode::cmp_equal;
+  switch (CompType) {
+  case TokenType::comp_not_equal: Op = OpCode::cmp_not_equal; break;
+  case TokenType::comp_less_than: Op = OpCode::cmp_less_than; break;
+  case TokenType::comp_greater_than: Op = OpCode::cmp_greater_than; break;
+  case TokenType::comp_less_than_equal: Op = OpCode::cmp_less_than_equal; break;
+  case TokenType::comp_greater_than_equal:
+    Op = OpCode::cmp_greater_than_equal;
+    break;
+  case TokenType::comp_equal: Op = OpCode::cmp_equal; break;
+  }
+  C.Emit(Op, Result, LHS, RHS);
+  return Result;
+}
+
+//===----------------------------------------------------------------------===//
+// Compiling: math related statements
+//===----------------------------------------------------------------------===//
+
+/// <fac> ::= <int> | <id> | ( <exp> )
+unsigned Fac::Compile(Compiler &C) {
+  if (Id != nullptr) {
+    return Id->Compile(C);
+  } else if (Exp != nullptr) {
+    return Exp->Compile(C);
+  }
+  return C.Constant(Int);
+}
+
+/// <exp> ::= <term> | <term> + <exp> | <term> - <exp>
+unsigned Exp::Compile(Compiler &C) {
+  if (RHSExp == nullptr) return LHSTerm->Compile(C);
+  if (C.canHoist(this)) return C.Hoist(this);
+
+  // `X + 1`, `1 + X` and `X - 1` keep the constant in the instruction.
+  if (C.fuses() && Checked && RHSExp->isConstant()) {
+    unsigned LHS = LHSTerm->Compile(C);
+    unsigned Result = C.Temp();
+    C.Emit(Tok, ExpType == TokenType::plus ? OpCode::add_imm : OpCode::sub_imm,
+           Result, LHS, RHSExp->getConstant());
+    return Result;
+  }
+  if (C.fuses() && Checked && ExpType == TokenType::plus &&
+      LHSTerm->isConstant()) {
+    unsigned RHS = RHSExp->Compile(C);
+    unsigned Result = C.Temp();
+    C.Emit(Tok, OpCode::add_imm, Result, RHS, LHSTerm->getConstant());
+    return Result;
+  }
+
+  unsigned LHS = LHSTerm->Compile(C);
+  unsigned RHS = RHSExp->Compile(C);
+  unsigned Result = C.Temp();
+  OpCode::OpCode Op;
+  if (ExpType == TokenType::plus) {
+    Op = Checked ? OpCode::add : OpCode::add_unchecked;
+  } else {
+    Op = Checked ? OpCode::sub : OpCode::sub_unchecked;
+  }
+  C.Emit(Tok, Op, Result, LHS, RHS);
+  return Result;
+}
+
+/// <term> ::= <fac> | <fac> * <term>
+unsigned Term::Compile(Compiler &C) {
+  if (RHSTerm == nullptr) return LHSFac->Compile(C);
+  if (C.canHoist(this)) return C.Hoist(this);
+
+  unsigned LHS = LHSFac->Compile(C);
+  unsigned RHS = RHSTerm->Compile(C);
+  unsigned Result = C.Temp();
+  C.Emit(Tok, Checked ? OpCode::mul : OpCode::mul_unchecked, Result, LHS,
+         RHS);
+  return Result;
+}
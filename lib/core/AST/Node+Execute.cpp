@@ -6,17 +6,19 @@
 //===----------------------------------------------------------------------===//
 
 #include "core/AST/ASTContext.h"
+#include "core/AST/Arithmetic.h"
+#include "core/AST/Checkpoint.h"
 #include "core/AST/Node.h"
+#include "core/Exec/Budget.h"
+#include "core/Exec/Tiers.h"
 #include "core/Parser/Parser.h"
 
-#include <limits.h>
-
 //===----------------------------------------------------------------------===//
 // Executing: top level
 //===----------------------------------------------------------------------===//
 
 /// <prog> ::= program <decl-seq> begin <stmt-seq> end
-void Prog::Execute(ASTContext &C) {
+void Prog::Execute(ASTContext &C) const {
   // No need to execute declerations as they have already been processed during
   // parsing.
   // DeclSeq->Execute(C);
@@ -28,20 +30,29 @@ void Prog::Execute(ASTContext &C) {
 //===----------------------------------------------------------------------===//
 
 /// <decl-seq> ::= <decl> | <decl> <decl-seq>
-void DeclSeq::Execute(ASTContext & /*C*/) {
+void DeclSeq::Execute(ASTContext & /*C*/) const {
   assert(false && "DeclSeq should not be envoked for interpreting.");
 }
 
 /// <stmt-seq> ::= <stmt> | <stmt> <stmt-seq>
-void StmtSeq::Execute(ASTContext &C) {
-  Stmt->Execute(C);
-  if (Seq != nullptr) {
-    Seq->Execute(C);
+void StmtSeq::Execute(ASTContext &C) const { ExecuteFrom(C, this, 0); }
+
+void StmtSeq::ExecuteFrom(ASTContext &C, const StmtSeq *L, unsigned Index) {
+  // Each enclosing sequence adds the index of its statement while the
+  // checkpoint unwinds, see `Checkpoint::Path`.
+  try {
+    for (; L != nullptr && !L->isEmpty(); L = L->Seq, ++Index) {
+      if (C.isCheckpointRequested()) throw Checkpoint();
+      L->Stmt->Execute(C);
+    }
+  } catch (Checkpoint &CP) {
+    CP.Path.push_back(Index);
+    throw;
   }
 }
 
 /// <id-list> ::= <id> | <id> <id-list>
-void IdList::Execute(ASTContext & /*C*/) {
+void IdList::Execute(ASTContext & /*C*/) const {
   assert(false && "IdList should not be envoked for interpreting.");
 }
 
@@ -50,17 +61,17 @@ void IdList::Execute(ASTContext & /*C*/) {
 //===----------------------------------------------------------------------===//
 
 /// <decl> ::= int <id-list>;
-void Decl::Execute(ASTContext & /*C*/) {
+void Decl::Execute(ASTContext & /*C*/) const {
   // We can skip running C.Initialize(Seq) because we do that before execution.
   assert(false && "Decl should not be envoked for interpreting.");
 }
 
 /// <stmt> ::= <assign> | <if> | <loop> | <in> | <out>
-void Stmt::Execute(ASTContext &C) { Node->Execute(C); }
+void Stmt::Execute(ASTContext &C) const { Node->Execute(C); }
 
 /// <id> ::= <let-seq> | <let-seq><int>
 /// <id> is just a token here
-void Id::Execute(ASTContext & /*C*/) {
+void Id::Execute(ASTContext & /*C*/) const {
   assert(false && "Id should not be envoked for interpreting.");
 }
 
@@ -69,71 +80,104 @@ void Id::Execute(ASTContext & /*C*/) {
 //===----------------------------------------------------------------------===//
 
 /// <assign> ::= <id> = <exp>;
-void Assign::Execute(ASTContext &C) {
+void Assign::Execute(ASTContext &C) const {
   assert(C.Has(Id) && "An undeclared identifier made it past the parser.");
-  Exp->Execute(C);
-  C.Set(Id, Exp->getValue());
+  C.Set(Id, C.isDeferringChecks() ? Exp->Evaluate(C) : Exp->Calculate(C));
 }
 
 /// <if> ::= if <cond> then <stmt-seq> end;
 ///        | if <cond> then <stmt-seq> else <stmt-seq> end;
-void If::Execute(ASTContext &C) {
-  Cond->Execute(C);
-  if (Cond->getValue()) {
-    IfSeq->Execute(C);
-  } else if (ElseSeq != nullptr) {
-    ElseSeq->Execute(C);
+void If::Execute(ASTContext &C) const {
+  bool Taken = Cond->Evaluate(C);
+  try {
+    if (Taken) {
+      IfSeq->Execute(C);
+    } else if (ElseSeq != nullptr) {
+      ElseSeq->Execute(C);
+    }
+  } catch (Checkpoint &CP) {
+    CP.Path.push_back(!Taken);
+    throw;
   }
 }
 
 /// <loop> ::= while <cond> loop <stmt-seq> end;
-void Loop::Execute(ASTContext &C) {
-  Cond->Execute(C);
-  while (Cond->getValue()) {
+void Loop::Execute(ASTContext &C) const {
+  // A loop that is hot already runs in bytecode from the start.
+  Tiers *T = C.getTiers();
+  if (T != nullptr && T->Enter(this, C)) return;
+
+  if (IV != nullptr) {
+    SkipIterations(C);
+  }
+
+  unsigned *Iterations = T != nullptr ? &C.getIterations(this) : nullptr;
+  Budget *Limits = C.getBudget();
+  while (Cond->Evaluate(C)) {
     Seq->Execute(C);
-    Cond->Execute(C);
+    if (Limits != nullptr) Limits->Step();
+    // At the back-edge the state is just like on entering the loop, so a loop
+    // that becomes hot can continue in bytecode from here.
+    if (Iterations != nullptr && ++*Iterations >= T->getThreshold() &&
+        T->Promote(this, C)) {
+      return;
+    }
   }
 }
 
 /// <in> ::= read <id-list>;
-void In::Execute(ASTContext &C) { C.SetFromIn(Seq); }
+void In::Execute(ASTContext &C) const {
+  IdList *L = Seq;
+  for (int Value : Known) {
+    C.Set(L->getId(), Value);
+    L = L->getSeq();
+  }
+  if (L != nullptr) {
+    C.WaitForIn(L);
+    C.SetFromIn(L);
+  }
+}
 
 /// <out> ::= write <id-list>;
-void Out::Execute(ASTContext &C) { C.WriteToOut(Seq); }
+void Out::Execute(ASTContext &C) const { C.WriteToOut(Seq); }
 
 /// <cond> ::= <comp> | !<cond> | [ <cond> and <cond> ] | [ <cond> or <cond> ]
-void Cond::Execute(ASTContext &C) {
-  if (Comp != nullptr) {
-    Comp->Execute(C);
-    Value = Comp->getValue();
-  } else if (CondType == TokenType::exclamation_mark) {
-    RHSCond->Execute(C);
-    Value = !RHSCond->getValue();
-  } else {
-    LHSCond->Execute(C);
-    RHSCond->Execute(C);
-    if (CondType == TokenType::rw_and) {
-      Value = LHSCond->getValue() && RHSCond->getValue();
-    } else {
-      Value = LHSCond->getValue() || RHSCond->getValue();
-    }
-  }
+/// Conditions produce a value, see `Cond::Evaluate`.
+void Cond::Execute(ASTContext &C) const { Evaluate(C); }
+
+bool Cond::Evaluate(ASTContext &C) const {
+  if (Comp != nullptr) return Comp->Evaluate(C);
+  if (CondType == TokenType::exclamation_mark) return !RHSCond->Evaluate(C);
+
+  bool LHS = LHSCond->Evaluate(C);
+  // A false `and` / true `or` is decided by its left hand side alone. The
+  // right hand side is then skipped along with any overflow it would report.
+  bool Decided = LHS != (CondType == TokenType::rw_and);
+  if (Decided && C.isShortCircuiting()) return LHS;
+
+  bool RHS = RHSCond->Evaluate(C);
+  return CondType == TokenType::rw_and ? LHS && RHS : LHS || RHS;
 }
 
 /// <comp> ::= ( <fac> <comp-op> <fac> )
-void Comp::Execute(ASTContext &C) {
-  LHSFac->Execute(C);
-  RHSFac->Execute(C);
-  int L = LHSFac->getValue();
-  int R = RHSFac->getValue();
+void Comp::Execute(ASTContext &C) const { Evaluate(C); }
+
+bool Comp::Evaluate(ASTContext &C) const {
+  // The evaluator chosen by `Comp::Select` checks every operation.
+  if (!C.isDeferringChecks()) return Test(*this, C);
+
+  int L = LHSFac->Evaluate(C);
+  int R = RHSFac->Evaluate(C);
   switch (CompType) {
-  case TokenType::comp_not_equal: Value = L != R; break;
-  case TokenType::comp_less_than: Value = L < R; break;
-  case TokenType::comp_greater_than: Value = L > R; break;
-  case TokenType::comp_less_than_equal: Value = L <= R; break;
-  case TokenType::comp_greater_than_equal: Value = L >= R; break;
-  case TokenType::comp_equal: Value = L == R; break;
+  case TokenType::comp_not_equal: return L != R;
+  case TokenType::comp_less_than: return L < R;
+  case TokenType::comp_greater_than: return L > R;
+  case TokenType::comp_less_than_equal: return L <= R;
+  case TokenType::comp_greater_than_equal: return L >= R;
+  case TokenType::comp_equal: return L == R;
   }
+  assert(false && "Unknown comparison.");
+  return false;
 }
 
 //===----------------------------------------------------------------------===//
@@ -141,76 +185,148 @@ void Comp::Execute(ASTContext &C) {
 //===----------------------------------------------------------------------===//
 
 /// <fac> ::= <int> | <id> | ( <exp> )
-void Fac::Execute(ASTContext &C) {
-  class Exp *ExpNode;
+/// Math produces a value, see `Fac::Calculate`. The evaluator for each shape
+/// of factor, term and expression is in Node+Select.cpp.
+void Fac::Execute(ASTContext &C) const { Calculate(C); }
+
+/// <exp> ::= <term> | <term> + <exp> | <term> - <exp>
+void Exp::Execute(ASTContext &C) const { Calculate(C); }
+
+/// <term> ::= <fac> | <fac> * <term>
+void Term::Execute(ASTContext &C) const { Calculate(C); }
+
+//===----------------------------------------------------------------------===//
+// Interpreting: deferred overflow checks
+//===----------------------------------------------------------------------===//
+
+/// <fac> ::= <int> | <id> | ( <exp> )
+int Fac::Evaluate(ASTContext &C, bool &Suspect) const {
   if (Id != nullptr) {
-    Value = C.Get(Id);
-  } else if ((ExpNode = dynamic_cast<class Exp *>(Exp)) != nullptr) {
-    ExpNode->Execute(C);
-    Value = ExpNode->getValue();
-  } else {
-    Value = Int;
+    return C.Get(Id);
+  } else if (Exp != nullptr) {
+    return static_cast<class Exp *>(Exp)->Evaluate(C, Suspect);
   }
+  return Int;
+}
+
+int Fac::Evaluate(ASTContext &C) const {
+  bool Suspect = false;
+  int V = Evaluate(C, Suspect);
+  if (!Suspect) return V;
+
+  // Expressions do not have side effects, so evaluating again with checks
+  // reports the first operation that failed.
+  return Calculate(C);
 }
 
 /// <exp> ::= <term> | <term> + <exp> | <term> - <exp>
-/// Remove checks if you want performance.
-void Exp::Execute(ASTContext &C) {
-  LHSTerm->Execute(C);
-  Value = LHSTerm->getValue();
-  if (ExpType == TokenType::plus) {
-    RHSExp->Execute(C);
-    int RHS = RHSExp->getValue();
-    // If we ever added throwing to a compiled solution we could make throwing
-    // for oveflow errors optional and only generate these checks when these
-    // operations are wrapped in a try-catch.
-    if (Value > 0 && RHS > (INT_MAX - Value)) {
-      throw LocDiag(Tok, DiagType::runtime_arithmitic_x_causes_y, "addition",
-                    "overflow");
-    }
-    if (Value < 0 && RHS < (INT_MIN - Value)) {
-      throw LocDiag(Tok, DiagType::runtime_arithmitic_x_causes_y, "addition",
-                    "underflow");
-    }
-    Value += RHS;
-  } else if (ExpType == TokenType::minus) {
-    RHSExp->Execute(C);
-    int RHS = RHSExp->getValue();
-    if (RHS > 0 && Value < (INT_MIN + RHS)) {
-      throw LocDiag(Tok, DiagType::runtime_arithmitic_x_causes_y, "subtraction",
-                    "underflow");
-    }
-    if (RHS < 0 && Value > (INT_MAX + RHS)) {
-      throw LocDiag(Tok, DiagType::runtime_arithmitic_x_causes_y, "subtraction",
-                    "overflow");
-    }
+int Exp::Evaluate(ASTContext &C, bool &Suspect) const {
+  int V = LHSTerm->Evaluate(C, Suspect);
+  if (ExpType == 0) return V;
 
-    Value -= RHS;
+  int R = RHSExp->Evaluate(C, Suspect);
+  if (ExpType == TokenType::plus) {
+    return Checked ? Arith::AddDeferred(V, R, Suspect) : V + R;
   }
+  return Checked ? Arith::SubtractDeferred(V, R, Suspect) : V - R;
+}
+
+int Exp::Evaluate(ASTContext &C) const {
+  bool Suspect = false;
+  int V = Evaluate(C, Suspect);
+  if (!Suspect) return V;
+
+  // See `Fac::Evaluate`.
+  return Calculate(C);
 }
 
 /// <term> ::= <fac> | <fac> * <term>
-/// Remove checks if you want performance.
-void Term::Execute(ASTContext &C) {
-  LHSFac->Execute(C);
-  Value = LHSFac->getValue();
-  if (RHSTerm != nullptr) {
-    RHSTerm->Execute(C);
-    int RHS = RHSTerm->Value;
-    if (RHS == 0) {
-      // Short-circuit for multiplication by 0.
-      Value = 0;
+int Term::Evaluate(ASTContext &C, bool &Suspect) const {
+  int V = LHSFac->Evaluate(C, Suspect);
+  if (RHSTerm == nullptr) return V;
+
+  int R = RHSTerm->Evaluate(C, Suspect);
+  return Checked ? Arith::MultiplyDeferred(V, R, Suspect) : V * R;
+}
+
+//===----------------------------------------------------------------------===//
+// Interpreting: resuming from a checkpoint
+//===----------------------------------------------------------------------===//
+
+/// The error for a checkpoint of another program.
+static std::string mismatch() {
+  return "The checkpoint does not match the program.";
+}
+
+/// <prog> ::= program <decl-seq> begin <stmt-seq> end
+void Prog::Resume(ASTContext &C, const std::vector<unsigned> &Path,
+                  unsigned Pos) const {
+  StmtSeq->Resume(C, Path, Pos);
+}
+
+/// <stmt-seq> ::= <stmt> | <stmt> <stmt-seq>
+void StmtSeq::Resume(ASTContext &C, const std::vector<unsigned> &Path,
+                     unsigned Pos) const {
+  if (Pos >= Path.size()) throw mismatch();
+  const StmtSeq *L = this;
+  unsigned Index = 0;
+  for (; L != nullptr && !L->isEmpty() && Index < Path[Pos]; ++Index) {
+    L = L->Seq;
+  }
+  if (L == nullptr || L->isEmpty()) throw mismatch();
+
+  try {
+    // The last index is the statement the run stopped before. It runs before
+    // another checkpoint is looked for, so that every one makes progress.
+    if (Pos + 1 == Path.size()) {
+      L->Stmt->Execute(C);
     } else {
-      if (Value > INT_MAX / RHS) {
-        throw LocDiag(Tok, DiagType::runtime_arithmitic_x_causes_y,
-                      "multiplication", "overflow");
-      }
-      if (Value < INT_MIN / RHS) {
-        throw LocDiag(Tok, DiagType::runtime_arithmitic_x_causes_y,
-                      "multiplication", "underflow");
-      }
-
-      Value *= RHS;
+      L->Stmt->Resume(C, Path, Pos + 1);
     }
+  } catch (Checkpoint &CP) {
+    CP.Path.push_back(Index);
+    throw;
+  }
+  ExecuteFrom(C, L->Seq, Index + 1);
+}
+
+/// <stmt> ::= <assign> | <if> | <loop> | <in> | <out>
+void Stmt::Resume(ASTContext &C, const std::vector<unsigned> &Path,
+                  unsigned Pos) const {
+  // Only statements with a body can be stopped in.
+  if (const If *I = dynamic_cast<const If *>(Node)) {
+    I->Resume(C, Path, Pos);
+  } else if (const Loop *L = dynamic_cast<const Loop *>(Node)) {
+    L->Resume(C, Path, Pos);
+  } else {
+    throw mismatch();
+  }
+}
+
+/// <if> ::= if <cond> then <stmt-seq> end;
+///        | if <cond> then <stmt-seq> else <stmt-seq> end;
+void If::Resume(ASTContext &C, const std::vector<unsigned> &Path,
+                unsigned Pos) const {
+  if (Pos >= Path.size() || Path[Pos] > 1) throw mismatch();
+  bool Else = Path[Pos] == 1;
+  if (Else && ElseSeq == nullptr) throw mismatch();
+  try {
+    (Else ? ElseSeq : IfSeq)->Resume(C, Path, Pos + 1);
+  } catch (Checkpoint &CP) {
+    CP.Path.push_back(Else);
+    throw;
+  }
+}
+
+/// <loop> ::= while <cond> loop <stmt-seq> end;
+void Loop::Resume(ASTContext &C, const std::vector<unsigned> &Path,
+                  unsigned Pos) const {
+  // The rest of the iteration, then the loop as usual.
+  Seq->Resume(C, Path, Pos);
+  Budget *Limits = C.getBudget();
+  if (Limits != nullptr) Limits->Step();
+  while (Cond->Evaluate(C)) {
+    Seq->Execute(C);
+    if (Limits != nullptr) Limits->Step();
   }
 }
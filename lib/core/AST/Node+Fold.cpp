@@ -0,0 +1,212 @@
+//===--- Node+Fold.cpp ----------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements constant folding and algebraic simplification of
+//   `Node`s. Runs once after parsing so that the work is not repeated every
+//   time a statement is executed.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/AST/Arithmetic.h"
+#include "core/AST/Node.h"
+
+//===----------------------------------------------------------------------===//
+// Folding: helper functions
+//===----------------------------------------------------------------------===//
+
+void Fac::setConstant(int V) {
+  if (Id != nullptr) delete Id;
+  if (Exp != nullptr) delete Exp;
+  Id = nullptr;
+  Exp = nullptr;
+  Int = V;
+}
+
+void Term::setConstant(int V) {
+  LHSFac->setConstant(V);
+  delete RHSTerm;
+  RHSTerm = nullptr;
+}
+
+Fac *Exp::getLoneFac() const {
+  if (ExpType != 0 || LHSTerm->getRHSTerm() != nullptr) return nullptr;
+  return LHSTerm->getLHSFac();
+}
+
+//===----------------------------------------------------------------------===//
+// Folding: top level
+//===----------------------------------------------------------------------===//
+
+/// <prog> ::= program <decl-seq> begin <stmt-seq> end
+void Prog::Fold() { StmtSeq->Fold(); }
+
+//===----------------------------------------------------------------------===//
+// Folding: sequence-like grammar rules (<x-seq> ::= <x> <x-seq>)
+//===----------------------------------------------------------------------===//
+
+/// <decl-seq> ::= <decl> | <decl> <decl-seq>
+void DeclSeq::Fold() {
+  // Declarations contain nothing to fold.
+}
+
+/// <stmt-seq> ::= <stmt> | <stmt> <stmt-seq>
+void StmtSeq::Fold() {
+  if (isEmpty()) return;
+  Stmt->Fold();
+  if (Seq != nullptr) {
+    Seq->Fold();
+  }
+}
+
+/// <id-list> ::= <id> | <id> <id-list>
+void IdList::Fold() {}
+
+//===----------------------------------------------------------------------===//
+// Folding: elements of sequence-like grammar rules
+//===----------------------------------------------------------------------===//
+
+/// <decl> ::= int <id-list>;
+void Decl::Fold() {}
+
+/// <stmt> ::= <assign> | <if> | <loop> | <in> | <out>
+void Stmt::Fold() { Node->Fold(); }
+
+/// <id> ::= <let-seq> | <let-seq><int>
+void Id::Fold() {}
+
+//===----------------------------------------------------------------------===//
+// Folding: specific statements
+//===----------------------------------------------------------------------===//
+
+/// <assign> ::= <id> = <exp>;
+void Assign::Fold() { Exp->Fold(); }
+
+/// <if> ::= if <cond> then <stmt-seq> end;
+///        | if <cond> then <stmt-seq> else <stmt-seq> end;
+void If::Fold() {
+  Cond->Fold();
+  IfSeq->Fold();
+  if (ElseSeq != nullptr) {
+    ElseSeq->Fold();
+  }
+}
+
+/// <loop> ::= while <cond> loop <stmt-seq> end;
+void Loop::Fold() {
+  Cond->Fold();
+  Seq->Fold();
+}
+
+/// <in> ::= read <id-list>;
+void In::Fold() {}
+
+/// <out> ::= write <id-list>;
+void Out::Fold() {}
+
+/// <cond> ::= <comp> | !<cond> | [ <cond> and <cond> ] | [ <cond> or <cond> ]
+void Cond::Fold() {
+  if (Comp != nullptr) {
+    Comp->Fold();
+    return;
+  }
+  if (LHSCond != nullptr) {
+    LHSCond->Fold();
+  }
+  RHSCond->Fold();
+}
+
+/// <comp> ::= ( <fac> <comp-op> <fac> )
+void Comp::Fold() {
+  LHSFac->Fold();
+  RHSFac->Fold();
+}
+
+//===----------------------------------------------------------------------===//
+// Folding: math related statements
+//===----------------------------------------------------------------------===//
+
+/// <fac> ::= <int> | <id> | ( <exp> )
+void Fac::Fold() {
+  if (Exp == nullptr) return;
+
+  class Exp *ExpNode = static_cast<class Exp *>(Exp);
+  ExpNode->Fold();
+
+  // Drop the parentheses around anything that is left as a single factor:
+  // `( 6 )`, `( X )` or `( ( X + 1 ) )`.
+  Fac *Lone = ExpNode->getLoneFac();
+  if (Lone == nullptr) return;
+
+  Int = Lone->Int;
+  Id = Lone->Id;
+  Exp = Lone->Exp;
+  Lone->Id = nullptr;
+  Lone->Exp = nullptr;
+  delete ExpNode;
+}
+
+/// <term> ::= <fac> | <fac> * <term>
+void Term::Fold() {
+  LHSFac->Fold();
+  if (RHSTerm == nullptr) return;
+
+  RHSTerm->Fold();
+  if (!RHSTerm->isConstant()) return;
+
+  int RHS = RHSTerm->getConstant();
+  if (LHSFac->isConstant()) {
+    int Result;
+    // An operation that would fail is kept as is so that it is reported only
+    // if (and when) it is executed.
+    if (Arith::Multiply(LHSFac->getConstant(), RHS, Result) != ArithResult::ok)
+      return;
+    setConstant(Result);
+  } else if (RHS == 1) {
+    // `X * 1` can never fail. Note that `1 * X` can, see `Arith::Multiply`.
+    delete RHSTerm;
+    RHSTerm = nullptr;
+  } else if (RHS == 0 && !LHSFac->mayThrow()) {
+    // `X * 0` short-circuits. The factor must not be able to fail on its own.
+    setConstant(0);
+  }
+}
+
+/// <exp> ::= <term> | <term> + <exp> | <term> - <exp>
+void Exp::Fold() {
+  LHSTerm->Fold();
+  if (RHSExp == nullptr) return;
+
+  RHSExp->Fold();
+  if (RHSExp->isConstant()) {
+    int RHS = RHSExp->getConstant();
+    if (LHSTerm->isConstant()) {
+      int Result;
+      ArithResult::ArithResult R =
+          ExpType == TokenType::plus
+              ? Arith::Add(LHSTerm->getConstant(), RHS, Result)
+              : Arith::Subtract(LHSTerm->getConstant(), RHS, Result);
+      if (R != ArithResult::ok) return;
+      LHSTerm->setConstant(Result);
+    } else if (RHS != 0) {
+      return;
+    }
+
+    // Either fully folded or `X + 0` / `X - 0`.
+    ExpType = 0;
+    delete RHSExp;
+    RHSExp = nullptr;
+  } else if (ExpType == TokenType::plus && LHSTerm->isConstant() &&
+             LHSTerm->getConstant() == 0) {
+    // `0 + <exp>` becomes `<exp>`. The token moves along with the operators so
+    // that diagnostics still point at the same place.
+    class Exp *Rest = RHSExp;
+    delete LHSTerm;
+    Tok = Rest->Tok;
+    ExpType = Rest->ExpType;
+    LHSTerm = Rest->LHSTerm;
+    RHSExp = Rest->RHSExp;
+    Rest->LHSTerm = nullptr;
+    Rest->RHSExp = nullptr;
+    delete Rest;
+  }
+}
@@ -0,0 +1,216 @@
+//===--- Node+Induction.cpp -----------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements the recognition of counting loops, see `Induction`,
+//   and skipping their iterations in the tree walker.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/AST/ASTContext.h"
+#include "core/AST/Induction.h"
+#include "core/AST/Node.h"
+#include "core/AST/OptStats.h"
+#include "core/Exec/Budget.h"
+
+#include <utility> // std::swap
+
+//===----------------------------------------------------------------------===//
+// Induction: helper functions
+//===----------------------------------------------------------------------===//
+
+/// Whether `F` is a literal or an identifier not in `Defs`, so that its value
+/// does not change while the loop runs and reading it can not fail.
+static bool isInvariant(Fac *F, const std::set<std::string> &Defs) {
+  if (F == nullptr || F->mayThrow()) return false;
+  return F->getId() == nullptr ||
+         Defs.find(F->getId()->getName()) == Defs.end();
+}
+
+/// Returns the comparison that holds with both sides swapped.
+static unsigned mirrorComparison(unsigned CompType) {
+  switch (CompType) {
+  case TokenType::comp_less_than: return TokenType::comp_greater_than;
+  case TokenType::comp_greater_than: return TokenType::comp_less_than;
+  case TokenType::comp_less_than_equal:
+    return TokenType::comp_greater_than_equal;
+  case TokenType::comp_greater_than_equal:
+    return TokenType::comp_less_than_equal;
+  }
+  return CompType;
+}
+
+bool Assign::isUpdate(const std::set<std::string> &Defs, Fac *&Step,
+                      bool &Subtract) const {
+  if (Exp->getRHSExp() == nullptr) return false;
+  Term *LHS = Exp->getLHSTerm();
+  Fac *RHS = Exp->getRHSExp()->getLoneFac();
+  if (LHS->getRHSTerm() != nullptr || RHS == nullptr) return false;
+
+  Fac *First = LHS->getLHSFac();
+  auto IsSelf = [this](Fac *F) {
+    return F->getId() != nullptr && F->getId()->getName() == Id->getName();
+  };
+
+  Subtract = Exp->getExpType() == TokenType::minus;
+  if (IsSelf(First) && isInvariant(RHS, Defs)) {
+    Step = RHS;
+    return true;
+  }
+  // `Step - Id` does not count up or down.
+  if (!Subtract && IsSelf(RHS) && isInvariant(First, Defs)) {
+    Step = First;
+    return true;
+  }
+  return false;
+}
+
+void Loop::SkipIterations(ASTContext &C) const {
+  std::vector<int> Values(IV->NumVars), Steps(IV->Updates.size());
+  for (unsigned V = 0; V < Values.size(); ++V) {
+    Values[V] = C.Get(IVVars[V]);
+  }
+  for (unsigned U = 0; U < Steps.size(); ++U) {
+    Steps[U] = IVSteps[U]->Evaluate(C);
+  }
+
+  long long Skipped = IV->Skip(Values.data(), Steps.data(),
+                               IVBound->Evaluate(C));
+  if (Skipped > 0) {
+    for (unsigned V = 0; V < Values.size(); ++V) {
+      C.Set(IVVars[V], Values[V]);
+    }
+    // Charged once the values are in place, so that a run preempted here
+    // resumes after the skipped iterations.
+    if (Budget *Limits = C.getBudget()) Limits->Step(Skipped);
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// Induction: top level
+//===----------------------------------------------------------------------===//
+
+/// <prog> ::= program <decl-seq> begin <stmt-seq> end
+void Prog::FindInductions(OptStats &S) { StmtSeq->FindInductions(S); }
+
+//===----------------------------------------------------------------------===//
+// Induction: sequence-like grammar rules (<x-seq> ::= <x> <x-seq>)
+//===----------------------------------------------------------------------===//
+
+/// <decl-seq> ::= <decl> | <decl> <decl-seq>
+void DeclSeq::FindInductions(OptStats & /*S*/) {}
+
+/// <stmt-seq> ::= <stmt> | <stmt> <stmt-seq>
+void StmtSeq::FindInductions(OptStats &S) {
+  if (isEmpty()) return;
+  Stmt->FindInductions(S);
+  if (Seq != nullptr) {
+    Seq->FindInductions(S);
+  }
+}
+
+/// <id-list> ::= <id> | <id> <id-list>
+void IdList::FindInductions(OptStats & /*S*/) {}
+
+//===----------------------------------------------------------------------===//
+// Induction: elements of sequence-like grammar rules
+//===----------------------------------------------------------------------===//
+
+/// <decl> ::= int <id-list>;
+void Decl::FindInductions(OptStats & /*S*/) {}
+
+/// <stmt> ::= <assign> | <if> | <loop> | <in> | <out>
+void Stmt::FindInductions(OptStats &S) { Node->FindInductions(S); }
+
+/// <id> ::= <let-seq> | <let-seq><int>
+void Id::FindInductions(OptStats & /*S*/) {}
+
+//===----------------------------------------------------------------------===//
+// Induction: specific statements
+//===----------------------------------------------------------------------===//
+
+/// <assign> ::= <id> = <exp>;
+void Assign::FindInductions(OptStats & /*S*/) {}
+
+/// <if> ::= if <cond> then <stmt-seq> end;
+///        | if <cond> then <stmt-seq> else <stmt-seq> end;
+void If::FindInductions(OptStats &S) {
+  IfSeq->FindInductions(S);
+  if (ElseSeq != nullptr) {
+    ElseSeq->FindInductions(S);
+  }
+}
+
+/// <loop> ::= while <cond> loop <stmt-seq> end;
+/// The body must only be updates (see `Assign::isUpdate`) and the condition a
+/// comparison of an updated identifier against an invariant factor.
+void Loop::FindInductions(OptStats &S) {
+  Seq->FindInductions(S);
+  if (IV != nullptr || Cond->getComp() == nullptr) return;
+
+  std::set<std::string> Defs;
+  CollectDefs(Defs);
+
+  Induction Shape;
+  std::vector<class Id *> Vars;
+  std::vector<Fac *> Steps;
+  std::map<std::string, unsigned> Index;
+  for (StmtSeq *L = Seq; L != nullptr && !L->isEmpty(); L = L->getSeq()) {
+    Assign *A = dynamic_cast<Assign *>(L->getStmt()->getNode());
+    Fac *Step;
+    bool Subtract;
+    if (A == nullptr || !A->isUpdate(Defs, Step, Subtract)) return;
+
+    std::string Name = A->getId()->getName();
+    if (Index.find(Name) == Index.end()) {
+      Index[Name] = Vars.size();
+      Vars.push_back(A->getId());
+    }
+    Shape.Updates.push_back(Induction::Update{Index[Name], Subtract});
+    Steps.push_back(Step);
+  }
+
+  // The compared identifier may be on either side.
+  Comp *C = Cond->getComp();
+  Fac *Counter = C->getLHSFac(), *Bound = C->getRHSFac();
+  Shape.CompType = C->getCompType();
+  if (!isInvariant(Bound, Defs)) {
+    std::swap(Counter, Bound);
+    Shape.CompType = mirrorComparison(Shape.CompType);
+  }
+  if (!isInvariant(Bound, Defs) || Counter->getId() == nullptr) return;
+  auto It = Index.find(Counter->getId()->getName());
+  if (It == Index.end()) return;
+
+  Shape.NumVars = Vars.size();
+  Shape.CondVar = It->second;
+  IV = new Induction(Shape);
+  IVVars = Vars;
+  IVSteps = Steps;
+  IVBound = Bound;
+  ++S.ClosedFormLoops;
+}
+
+/// <in> ::= read <id-list>;
+void In::FindInductions(OptStats & /*S*/) {}
+
+/// <out> ::= write <id-list>;
+void Out::FindInductions(OptStats & /*S*/) {}
+
+/// <cond> ::= <comp> | !<cond> | [ <cond> and <cond> ] | [ <cond> or <cond> ]
+void Cond::FindInductions(OptStats & /*S*/) {}
+
+/// <comp> ::= ( <fac> <comp-op> <fac> )
+void Comp::FindInductions(OptStats & /*S*/) {}
+
+//===----------------------------------------------------------------------===//
+// Induction: math related statements
+//===----------------------------------------------------------------------===//
+
+/// <fac> ::= <int> | <id> | ( <exp> )
+void Fac::FindInductions(OptStats & /*S*/) {}
+
+/// <exp> ::= <term> | <term> + <exp> | <term> - <exp>
+void Exp::FindInductions(OptStats & /*S*/) {}
+
+/// <term> ::= <fac> | <fac> * <term>
+void Term::FindInductions(OptStats & /*S*/) {}
@@ -0,0 +1,252 @@
+//===--- Node+Lower.cpp ---------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements methods for lowering `Node`s to SSA form.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/AST/Node.h"
+#include "core/IR/Builder.h"
+
+//===----------------------------------------------------------------------===//
+// Lowering: helper functions
+//===----------------------------------------------------------------------===//
+
+void Cond::LowerBranch(IRBuilder &B, unsigned True, unsigned False) {
+  if (Comp != nullptr) {
+    Comp->LowerBranch(B, True, False);
+    return;
+  }
+  if (!B.shortCircuits()) {
+    B.Branch(Lower(B), True, False);
+    return;
+  }
+  if (CondType == TokenType::exclamation_mark) {
+    RHSCond->LowerBranch(B, False, True);
+    return;
+  }
+
+  // The right hand side is only reached when the left hand side does not
+  // decide the outcome.
+  unsigned RHS = B.CreateBlock();
+  if (CondType == TokenType::rw_and) {
+    LHSCond->LowerBranch(B, RHS, False);
+  } else {
+    LHSCond->LowerBranch(B, True, RHS);
+  }
+  B.Seal(RHS);
+  B.SetBlock(RHS);
+  RHSCond->LowerBranch(B, True, False);
+}
+
+void Comp::LowerBranch(IRBuilder &B, unsigned True, unsigned False) {
+  B.Branch(Lower(B), True, False);
+}
+
+//===----------------------------------------------------------------------===//
+// Lowering: top level
+//===----------------------------------------------------------------------===//
+
+/// <prog> ::= program <decl-seq> begin <stmt-seq> end
+unsigned Prog::Lower(IRBuilder &B) {
+  DeclSeq->Lower(B);
+  StmtSeq->Lower(B);
+  B.Return();
+  return IRBuilder::NoValue;
+}
+
+//===----------------------------------------------------------------------===//
+// Lowering: sequence-like grammar rules (<x-seq> ::= <x> <x-seq>)
+//===----------------------------------------------------------------------===//
+
+/// <decl-seq> ::= <decl> | <decl> <decl-seq>
+unsigned DeclSeq::Lower(IRBuilder &B) {
+  Decl->Lower(B);
+  if (Seq != nullptr) {
+    Seq->Lower(B);
+  }
+  return IRBuilder::NoValue;
+}
+
+/// <stmt-seq> ::= <stmt> | <stmt> <stmt-seq>
+unsigned StmtSeq::Lower(IRBuilder &B) {
+  if (isEmpty()) return IRBuilder::NoValue;
+  Stmt->Lower(B);
+  if (Seq != nullptr) {
+    Seq->Lower(B);
+  }
+  return IRBuilder::NoValue;
+}
+
+/// <id-list> ::= <id> | <id> <id-list>
+unsigned IdList::Lower(IRBuilder & /*B*/) {
+  assert(false && "IdList should not be envoked for lowering.");
+  return IRBuilder::NoValue;
+}
+
+//===----------------------------------------------------------------------===//
+// Lowering: elements of sequence-like grammar rules
+//===----------------------------------------------------------------------===//
+
+/// <decl> ::= int <id-list>;
+unsigned Decl::Lower(IRBuilder &B) {
+  for (IdList *L = Seq; L != nullptr; L = L->getSeq()) {
+    B.Declare(L->getId()->getName());
+  }
+  return IRBuilder::NoValue;
+}
+
+/// <stmt> ::= <assign> | <if> | <loop> | <in> | <out>
+unsigned Stmt::Lower(IRBuilder &B) { return Node->Lower(B); }
+
+/// <id> ::= <let-seq> | <let-seq><int>
+unsigned Id::Lower(IRBuilder &B) { return B.Read(Name); }
+
+//===----------------------------------------------------------------------===//
+// Lowering: specific statements
+//===----------------------------------------------------------------------===//
+
+/// <assign> ::= <id> = <exp>;
+unsigned Assign::Lower(IRBuilder &B) {
+  std::string Name = Id->getName();
+  B.Write(Name, B.Emit(IROp::copy, Name, {Exp->Lower(B)}));
+  return IRBuilder::NoValue;
+}
+
+/// <if> ::= if <cond> then <stmt-seq> end;
+///        | if <cond> then <stmt-seq> else <stmt-seq> end;
+unsigned If::Lower(IRBuilder &B) {
+  unsigned Then = B.CreateBlock();
+  unsigned Else = ElseSeq != nullptr ? B.CreateBlock() : IRBuilder::NoValue;
+  unsigned End = B.CreateBlock();
+  Cond->LowerBranch(B, Then, ElseSeq != nullptr ? Else : End);
+
+  B.Seal(Then);
+  B.SetBlock(Then);
+  IfSeq->Lower(B);
+  B.Jump(End);
+  if (ElseSeq != nullptr) {
+    B.Seal(Else);
+    B.SetBlock(Else);
+    ElseSeq->Lower(B);
+    B.Jump(End);
+  }
+
+  B.Seal(End);
+  B.SetBlock(End);
+  return IRBuilder::NoValue;
+}
+
+/// <loop> ::= while <cond> loop <stmt-seq> end;
+/// Counting loops run every iteration; skipping them is left to the tree
+/// walker and `Compiler`.
+unsigned Loop::Lower(IRBuilder &B) {
+  unsigned Head = B.CreateBlock();
+  unsigned Body = B.CreateBlock();
+  unsigned Exit = B.CreateBlock();
+  B.Jump(Head);
+
+  // The head is sealed once the back-edge exists.
+  B.SetBlock(Head);
+  Cond->LowerBranch(B, Body, Exit);
+  B.Seal(Body);
+  B.SetBlock(Body);
+  Seq->Lower(B);
+  B.Jump(Head);
+  B.Seal(Head);
+
+  B.Seal(Exit);
+  B.SetBlock(Exit);
+  return IRBuilder::NoValue;
+}
+
+/// <in> ::= read <id-list>;
+unsigned In::Lower(IRBuilder &B) {
+  IdList *L = Seq;
+  for (int Value : Known) {
+    B.Write(L->getId()->getName(), B.Constant(Value));
+    L = L->getSeq();
+  }
+  for (; L != nullptr; L = L->getSeq()) {
+    std::string Name = L->getId()->getName();
+    B.Write(Name, B.Emit(IROp::read, Name, {}));
+  }
+  return IRBuilder::NoValue;
+}
+
+/// <out> ::= write <id-list>;
+unsigned Out::Lower(IRBuilder &B) {
+  for (IdList *L = Seq; L != nullptr; L = L->getSeq()) {
+    std::string Name = L->getId()->getName();
+    B.Emit(IROp::write, Name, {B.Read(Name)});
+  }
+  return IRBuilder::NoValue;
+}
+
+/// <cond> ::= <comp> | !<cond> | [ <cond> and <cond> ] | [ <cond> or <cond> ]
+/// Both sides are evaluated, just like `Cond::Execute` without
+/// short-circuiting.
+unsigned Cond::Lower(IRBuilder &B) {
+  if (Comp != nullptr) return Comp->Lower(B);
+  if (CondType == TokenType::exclamation_mark) {
+    return B.Emit(IROp::logic_not, {RHSCond->Lower(B)});
+  }
+
+  unsigned LHS = LHSCond->Lower(B);
+  unsigned RHS = RHSCond->Lower(B);
+  return B.Emit(CondType == TokenType::rw_and ? IROp::logic_and
+                                               : IROp::logic_or,
+                {LHS, RHS});
+}
+
+/// <comp> ::= ( <fac> <comp-op> <fac> )
+unsigned Comp::Lower(IRBuilder &B) {
+  unsigned LHS = LHSFac->Lower(B);
+  unsigned RHS = RHSFac->Lower(B);
+
+  IROp::IROp Op = IROp::cmp_equal;
+  switch (CompType) {
+  case TokenType::comp_not_equal: Op = IROp::cmp_not_equal; break;
+  case TokenType::comp_less_than: Op = IROp::cmp_less_than; break;
+  case TokenType::comp_greater_than: Op = IROp::cmp_greater_than; break;
+  case TokenType::comp_less_than_equal: Op = IROp::cmp_less_than_equal; break;
+  case TokenType::comp_greater_than_equal:
+    Op = IROp::cmp_greater_than_equal;
+    break;
+  case TokenType::comp_equal: Op = IROp::cmp_equal; break;
+  }
+  return B.Emit(Op, {LHS, RHS});
+}
+
+//===----------------------------------------------------------------------===//
+// Lowering: math related statements
+//===----------------------------------------------------------------------===//
+
+/// <fac> ::= <int> | <id> | ( <exp> )
+unsigned Fac::Lower(IRBuilder &B) {
+  if (Id != nullptr) {
+    return Id->Lower(B);
+  } else if (Exp != nullptr) {
+    return Exp->Lower(B);
+  }
+  return B.Constant(Int);
+}
+
+/// <exp> ::= <term> | <term> + <exp> | <term> - <exp>
+unsigned Exp::Lower(IRBuilder &B) {
+  if (RHSExp == nullptr) return LHSTerm->Lower(B);
+
+  unsigned LHS = LHSTerm->Lower(B);
+  unsigned RHS = RHSExp->Lower(B);
+  return B.Emit(Tok, ExpType == TokenType::plus ? IROp::add : IROp::sub,
+                {LHS, RHS}, Checked);
+}
+
+/// <term> ::= <fac> | <fac> * <term>
+unsigned Term::Lower(IRBuilder &B) {
+  if (RHSTerm == nullptr) return LHSFac->Lower(B);
+
+  unsigned LHS = LHSFac->Lower(B);
+  unsigned RHS = RHSTerm->Lower(B);
+  return B.Emit(Tok, IROp::mul, {LHS, RHS}, Checked);
+}
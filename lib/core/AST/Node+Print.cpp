@@ -8,12 +8,32 @@
 #include "core/AST/Node.h"
 #include "core/Parser/Parser.h"
 
+#include <climits>  // INT_MAX, INT_MIN
 #include <iostream> // std::endl
 #include <sstream>  // std::ostringstream
 
 using std::endl;
 using std::ostringstream;
 
+/// Prints the value `V`, which folding may have left outside of what a CORE
+/// literal can hold: there are no negative literals and at most 8 digits.
+static void printInt(ostringstream &X, int V) {
+  if (V == INT_MIN) {
+    X << "( ";
+    printInt(X, INT_MIN + 1);
+    X << " - 1 )";
+  } else if (V < 0) {
+    X << "( 0 - ";
+    printInt(X, -V);
+    X << " )";
+  } else if (V > 99999999) {
+    X << "( " << V / 100000000 << " * 10000 * 10000 + " << V % 100000000
+      << " )";
+  } else {
+    X << V;
+  }
+}
+
 std::string Indent(unsigned Ind) {
   // return std::string(Ind * 4, ' ');
   // TODO: In the future we would want to allow specifying the indentation by
@@ -51,6 +71,7 @@ void DeclSeq::Print(ostringstream &X, unsigned Ind) {
 
 /// <stmt-seq> ::= <stmt> | <stmt> <stmt-seq>
 void StmtSeq::Print(ostringstream &X, unsigned Ind) {
+  if (isEmpty()) return;
   Stmt->Print(X, Ind);
   if (Seq != nullptr) {
     Seq->Print(X, Ind);
@@ -120,9 +141,19 @@ void Loop::Print(ostringstream &X, unsigned Ind) {
 }
 
 /// <in> ::= read <id-list>;
+/// The known identifiers are printed as assignments.
 void In::Print(ostringstream &X, unsigned Ind) {
+  IdList *L = Seq;
+  for (int Value : Known) {
+    L->getId()->Print(X, Ind);
+    X << " = ";
+    printInt(X, Value);
+    X << ";" << endl;
+    L = L->getSeq();
+  }
+  if (L == nullptr) return;
   X << Indent(Ind) << "read ";
-  Seq->Print(X, 0);
+  L->Print(X, 0);
   X << ";" << endl;
 }
 
@@ -184,7 +215,7 @@ void Fac::Print(ostringstream &X, unsigned Ind) {
     Exp->Print(X, 0);
     X << " )";
   } else {
-    X << Int;
+    printInt(X, Int);
   }
 }
 
@@ -0,0 +1,508 @@
+//===--- Node+Prune.cpp ---------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements constant propagation and liveness for `Node`s. The
+//   first prunes branches whose condition is decided by the known constants,
+//   the second removes assignments whose value is never read. Statements with
+//   side effects (`read`, `write` and arithmetic that could overflow) are never
+//   removed.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/AST/Node.h"
+#include "core/AST/OptStats.h"
+
+#include <vector> // std::vector
+
+//===----------------------------------------------------------------------===//
+// Pruning: helper functions
+//===----------------------------------------------------------------------===//
+
+StmtSeq *StmtSeq::Erase(StmtSeq *Prev) {
+  delete Stmt;
+  Stmt = nullptr;
+
+  if (Seq != nullptr) {
+    // Pull the next statement into this node so that `Prev` stays valid.
+    StmtSeq *Next = Seq;
+    Stmt = Next->Stmt;
+    Seq = Next->Seq;
+    Next->Stmt = nullptr;
+    Next->Seq = nullptr;
+    delete Next;
+    return this;
+  }
+
+  // Only the head of a chain is left empty, the parent still points to it.
+  if (Prev != nullptr) {
+    Prev->Seq = nullptr;
+    delete this;
+  }
+  return nullptr;
+}
+
+StmtSeq *StmtSeq::Splice(StmtSeq *Body) {
+  assert(!Body->isEmpty() && "Can not splice an empty body.");
+
+  StmtSeq *Rest = Seq;
+  StmtSeq *Last = Body;
+  while (Last->Seq != nullptr) {
+    Last = Last->Seq;
+  }
+
+  delete Stmt;
+  Stmt = Body->Stmt;
+  Seq = Body->Seq;
+  Body->Stmt = nullptr;
+  Body->Seq = nullptr;
+  delete Body;
+
+  if (Last == Body) Last = this;
+  Last->Seq = Rest;
+  return Last;
+}
+
+StmtSeq *Stmt::releaseBody() { return static_cast<If *>(Node)->releaseBody(); }
+
+StmtSeq *If::releaseBody() {
+  StmtSeq *Body = IfSeq;
+  IfSeq = nullptr;
+  return Body;
+}
+
+bool Fac::isKnown(const ConstEnv &Env, int &V) const {
+  if (isConstant()) {
+    V = Int;
+    return true;
+  } else if (Id != nullptr) {
+    auto It = Env.find(Id->getName());
+    if (It == Env.end()) return false;
+    V = It->second;
+    return true;
+  }
+  return false;
+}
+
+bool Exp::mayThrow() const {
+  Fac *Lone = getLoneFac();
+  return Lone == nullptr || Lone->mayThrow();
+}
+
+bool Comp::Decide(const ConstEnv &Env, bool &V) const {
+  int LHS, RHS;
+  if (!LHSFac->isKnown(Env, LHS) || !RHSFac->isKnown(Env, RHS)) return false;
+
+  switch (CompType) {
+  case TokenType::comp_not_equal: V = LHS != RHS; break;
+  case TokenType::comp_less_than: V = LHS < RHS; break;
+  case TokenType::comp_greater_than: V = LHS > RHS; break;
+  case TokenType::comp_less_than_equal: V = LHS <= RHS; break;
+  case TokenType::comp_greater_than_equal: V = LHS >= RHS; break;
+  case TokenType::comp_equal: V = LHS == RHS; break;
+  default: return false;
+  }
+  return true;
+}
+
+bool Cond::Decide(const ConstEnv &Env, bool &V) const {
+  if (Comp != nullptr) return Comp->Decide(Env, V);
+
+  bool RHS;
+  bool HasRHS = RHSCond->Decide(Env, RHS);
+  if (CondType == TokenType::exclamation_mark) {
+    V = !RHS;
+    return HasRHS;
+  }
+
+  bool LHS;
+  bool HasLHS = LHSCond->Decide(Env, LHS);
+  bool IsAnd = CondType == TokenType::rw_and;
+  if (HasLHS && HasRHS) {
+    V = IsAnd ? LHS && RHS : LHS || RHS;
+    return true;
+  }
+
+  // One side may settle the outcome on its own, but the other side is still
+  // evaluated and must not be able to fail.
+  bool Settles = !IsAnd;
+  if ((HasLHS && LHS == Settles && !RHSCond->mayThrow()) ||
+      (HasRHS && RHS == Settles && !LHSCond->mayThrow())) {
+    V = Settles;
+    return true;
+  }
+  return false;
+}
+
+bool Cond::mayThrow() const {
+  if (Comp != nullptr) return Comp->mayThrow();
+  return (LHSCond != nullptr && LHSCond->mayThrow()) || RHSCond->mayThrow();
+}
+
+//===----------------------------------------------------------------------===//
+// Pruning: top level
+//===----------------------------------------------------------------------===//
+
+/// <prog> ::= program <decl-seq> begin <stmt-seq> end
+Rewrite::Rewrite Prog::Propagate(ConstEnv &Env, OptStats &S) {
+  return StmtSeq->Propagate(Env, S);
+}
+
+Rewrite::Rewrite Prog::Liveness(std::set<std::string> &Live, OptStats *S) {
+  return StmtSeq->Liveness(Live, S);
+}
+
+//===----------------------------------------------------------------------===//
+// Pruning: sequence-like grammar rules (<x-seq> ::= <x> <x-seq>)
+//===----------------------------------------------------------------------===//
+
+/// <decl-seq> ::= <decl> | <decl> <decl-seq>
+Rewrite::Rewrite DeclSeq::Propagate(ConstEnv & /*Env*/, OptStats & /*S*/) {
+  return Rewrite::keep;
+}
+
+Rewrite::Rewrite DeclSeq::Liveness(std::set<std::string> & /*Live*/,
+                                   OptStats * /*S*/) {
+  return Rewrite::keep;
+}
+
+/// <stmt-seq> ::= <stmt> | <stmt> <stmt-seq>
+/// Statements are visited in order, so that the constants known after one
+/// statement are the ones known before the next.
+Rewrite::Rewrite StmtSeq::Propagate(ConstEnv &Env, OptStats &S) {
+  StmtSeq *Prev = nullptr;
+  StmtSeq *N = this;
+  while (N != nullptr && !N->isEmpty()) {
+    switch (N->Stmt->Propagate(Env, S)) {
+    case Rewrite::keep:
+      Prev = N;
+      N = N->Seq;
+      break;
+    case Rewrite::remove: N = N->Erase(Prev); break;
+    case Rewrite::inline_body:
+      // The body has already been visited.
+      Prev = N->Splice(N->Stmt->releaseBody());
+      N = Prev->Seq;
+      break;
+    }
+  }
+  return Rewrite::keep;
+}
+
+/// Statements are visited in reverse, so that the identifiers read after one
+/// statement are the ones read after the previous.
+Rewrite::Rewrite StmtSeq::Liveness(std::set<std::string> &Live, OptStats *S) {
+  std::vector<StmtSeq *> Nodes;
+  for (StmtSeq *N = this; N != nullptr && !N->isEmpty(); N = N->Seq) {
+    Nodes.push_back(N);
+  }
+
+  std::vector<bool> Dead(Nodes.size());
+  for (size_t I = Nodes.size(); I-- > 0;) {
+    Dead[I] = Nodes[I]->Stmt->Liveness(Live, S) == Rewrite::remove;
+  }
+
+  if (S == nullptr) return Rewrite::keep;
+
+  // Erase from the back so that the nodes before the one erased stay valid.
+  for (size_t I = Nodes.size(); I-- > 0;) {
+    if (Dead[I]) {
+      Nodes[I]->Erase(I == 0 ? nullptr : Nodes[I - 1]);
+    }
+  }
+  return Rewrite::keep;
+}
+
+/// <id-list> ::= <id> | <id> <id-list>
+Rewrite::Rewrite IdList::Propagate(ConstEnv & /*Env*/, OptStats & /*S*/) {
+  return Rewrite::keep;
+}
+
+Rewrite::Rewrite IdList::Liveness(std::set<std::string> & /*Live*/,
+                                  OptStats * /*S*/) {
+  return Rewrite::keep;
+}
+
+//===----------------------------------------------------------------------===//
+// Pruning: elements of sequence-like grammar rules
+//===----------------------------------------------------------------------===//
+
+/// <decl> ::= int <id-list>;
+Rewrite::Rewrite Decl::Propagate(ConstEnv & /*Env*/, OptStats & /*S*/) {
+  return Rewrite::keep;
+}
+
+Rewrite::Rewrite Decl::Liveness(std::set<std::string> & /*Live*/,
+                                OptStats * /*S*/) {
+  return Rewrite::keep;
+}
+
+/// <stmt> ::= <assign> | <if> | <loop> | <in> | <out>
+Rewrite::Rewrite Stmt::Propagate(ConstEnv &Env, OptStats &S) {
+  return Node->Propagate(Env, S);
+}
+
+Rewrite::Rewrite Stmt::Liveness(std::set<std::string> &Live, OptStats *S) {
+  return Node->Liveness(Live, S);
+}
+
+/// <id> ::= <let-seq> | <let-seq><int>
+Rewrite::Rewrite Id::Propagate(ConstEnv & /*Env*/, OptStats & /*S*/) {
+  return Rewrite::keep;
+}
+
+Rewrite::Rewrite Id::Liveness(std::set<std::string> & /*Live*/,
+                              OptStats * /*S*/) {
+  return Rewrite::keep;
+}
+
+//===----------------------------------------------------------------------===//
+// Pruning: specific statements
+//===----------------------------------------------------------------------===//
+
+/// <assign> ::= <id> = <exp>;
+Rewrite::Rewrite Assign::Propagate(ConstEnv &Env, OptStats &S) {
+  Exp->Propagate(Env, S);
+  Exp->Fold();
+  if (Exp->isConstant()) {
+    Env[Id->getName()] = Exp->getConstant();
+  } else {
+    Env.erase(Id->getName());
+  }
+  return Rewrite::keep;
+}
+
+Rewrite::Rewrite Assign::Liveness(std::set<std::string> &Live, OptStats *S) {
+  // An expression that could overflow has to stay for its diagnostic.
+  if (Live.count(Id->getName()) == 0 && !Exp->mayThrow()) {
+    if (S != nullptr) ++S->DeadStores;
+    return Rewrite::remove;
+  }
+
+  Live.erase(Id->getName());
+  Exp->CollectUses(Live);
+  return Rewrite::keep;
+}
+
+/// <if> ::= if <cond> then <stmt-seq> end;
+///        | if <cond> then <stmt-seq> else <stmt-seq> end;
+Rewrite::Rewrite If::Propagate(ConstEnv &Env, OptStats &S) {
+  Cond->Propagate(Env, S);
+  Cond->Fold();
+
+  bool Taken;
+  if (Cond->Decide(Env, Taken)) {
+    ++S.DeadBranches;
+    // Keep the body that is always taken as `IfSeq`.
+    if (Taken) {
+      delete ElseSeq;
+    } else {
+      delete IfSeq;
+      IfSeq = ElseSeq;
+    }
+    ElseSeq = nullptr;
+
+    if (IfSeq == nullptr) return Rewrite::remove;
+    IfSeq->Propagate(Env, S);
+    return IfSeq->isEmpty() ? Rewrite::remove : Rewrite::inline_body;
+  }
+
+  ConstEnv ElseEnv = Env;
+  IfSeq->Propagate(Env, S);
+  if (ElseSeq != nullptr) {
+    ElseSeq->Propagate(ElseEnv, S);
+  }
+
+  // Only the constants both paths agree on are known after the `if`.
+  for (auto It = Env.begin(); It != Env.end();) {
+    auto Other = ElseEnv.find(It->first);
+    if (Other == ElseEnv.end() || Other->second != It->second) {
+      It = Env.erase(It);
+    } else {
+      ++It;
+    }
+  }
+  return Rewrite::keep;
+}
+
+Rewrite::Rewrite If::Liveness(std::set<std::string> &Live, OptStats *S) {
+  std::set<std::string> ElseLive = Live;
+  IfSeq->Liveness(Live, S);
+  if (ElseSeq != nullptr) {
+    ElseSeq->Liveness(ElseLive, S);
+    if (S != nullptr && ElseSeq->isEmpty()) {
+      delete ElseSeq;
+      ElseSeq = nullptr;
+    }
+  }
+  Live.insert(ElseLive.begin(), ElseLive.end());
+
+  if (IfSeq->isEmpty() && ElseSeq == nullptr && !Cond->mayThrow()) {
+    if (S != nullptr) ++S->DeadBranches;
+    return Rewrite::remove;
+  }
+
+  Cond->CollectUses(Live);
+  return Rewrite::keep;
+}
+
+/// <loop> ::= while <cond> loop <stmt-seq> end;
+Rewrite::Rewrite Loop::Propagate(ConstEnv &Env, OptStats &S) {
+  // Whatever the body changes is unknown from the second iteration on.
+  std::set<std::string> Defs;
+  Seq->CollectDefs(Defs);
+  ConstEnv Entry = Env;
+  for (auto &Name : Defs) {
+    Env.erase(Name);
+  }
+
+  bool Enters;
+  if (Cond->Decide(Entry, Enters) && !Enters) {
+    ++S.DeadLoops;
+    Env = Entry;
+    return Rewrite::remove;
+  }
+
+  Cond->Propagate(Env, S);
+  Cond->Fold();
+  ConstEnv BodyEnv = Env;
+  Seq->Propagate(BodyEnv, S);
+  return Rewrite::keep;
+}
+
+Rewrite::Rewrite Loop::Liveness(std::set<std::string> &Live, OptStats *S) {
+  // Iterate until the identifiers live at the head of the loop are stable.
+  // They are read either after the loop, by the condition or by the body.
+  std::set<std::string> Head = Live;
+  Cond->CollectUses(Head);
+  while (true) {
+    std::set<std::string> BodyLive = Head;
+    Seq->Liveness(BodyLive, nullptr);
+    size_t Before = Head.size();
+    Head.insert(BodyLive.begin(), BodyLive.end());
+    if (Head.size() == Before) break;
+  }
+
+  // The loop itself is kept even with an empty body as it may never end.
+  std::set<std::string> BodyLive = Head;
+  Seq->Liveness(BodyLive, S);
+  Live = Head;
+  return Rewrite::keep;
+}
+
+/// <in> ::= read <id-list>;
+Rewrite::Rewrite In::Propagate(ConstEnv &Env, OptStats & /*S*/) {
+  IdList *L = Seq;
+  for (int Value : Known) {
+    Env[L->getId()->getName()] = Value;
+    L = L->getSeq();
+  }
+  for (; L != nullptr; L = L->getSeq()) {
+    Env.erase(L->getId()->getName());
+  }
+  return Rewrite::keep;
+}
+
+Rewrite::Rewrite In::Liveness(std::set<std::string> &Live, OptStats *S) {
+  std::set<std::string> Defs;
+  Seq->CollectDefs(Defs);
+
+  // Without anything to read, the statement only assigns constants.
+  if (getUnknown() == nullptr) {
+    bool Used = false;
+    for (auto &Name : Defs) {
+      Used = Used || Live.count(Name) != 0;
+    }
+    if (!Used) {
+      if (S != nullptr) ++S->DeadStores;
+      return Rewrite::remove;
+    }
+  }
+
+  for (auto &Name : Defs) {
+    Live.erase(Name);
+  }
+  return Rewrite::keep;
+}
+
+/// <out> ::= write <id-list>;
+Rewrite::Rewrite Out::Propagate(ConstEnv & /*Env*/, OptStats & /*S*/) {
+  return Rewrite::keep;
+}
+
+Rewrite::Rewrite Out::Liveness(std::set<std::string> &Live, OptStats * /*S*/) {
+  Seq->CollectUses(Live);
+  return Rewrite::keep;
+}
+
+/// <cond> ::= <comp> | !<cond> | [ <cond> and <cond> ] | [ <cond> or <cond> ]
+Rewrite::Rewrite Cond::Propagate(ConstEnv &Env, OptStats &S) {
+  if (Comp != nullptr) return Comp->Propagate(Env, S);
+  if (LHSCond != nullptr) {
+    LHSCond->Propagate(Env, S);
+  }
+  return RHSCond->Propagate(Env, S);
+}
+
+Rewrite::Rewrite Cond::Liveness(std::set<std::string> & /*Live*/,
+                                OptStats * /*S*/) {
+  return Rewrite::keep;
+}
+
+/// <comp> ::= ( <fac> <comp-op> <fac> )
+Rewrite::Rewrite Comp::Propagate(ConstEnv &Env, OptStats &S) {
+  LHSFac->Propagate(Env, S);
+  return RHSFac->Propagate(Env, S);
+}
+
+Rewrite::Rewrite Comp::Liveness(std::set<std::string> & /*Live*/,
+                                OptStats * /*S*/) {
+  return Rewrite::keep;
+}
+
+//===----------------------------------------------------------------------===//
+// Pruning: math related statements
+//===----------------------------------------------------------------------===//
+
+/// <fac> ::= <int> | <id> | ( <exp> )
+Rewrite::Rewrite Fac::Propagate(ConstEnv &Env, OptStats &S) {
+  int V;
+  if (Id != nullptr && isKnown(Env, V)) {
+    setConstant(V);
+  } else if (Exp != nullptr) {
+    Exp->Propagate(Env, S);
+  }
+  return Rewrite::keep;
+}
+
+Rewrite::Rewrite Fac::Liveness(std::set<std::string> & /*Live*/,
+                               OptStats * /*S*/) {
+  return Rewrite::keep;
+}
+
+/// <exp> ::= <term> | <term> + <exp> | <term> - <exp>
+Rewrite::Rewrite Exp::Propagate(ConstEnv &Env, OptStats &S) {
+  LHSTerm->Propagate(Env, S);
+  if (RHSExp != nullptr) {
+    RHSExp->Propagate(Env, S);
+  }
+  return Rewrite::keep;
+}
+
+Rewrite::Rewrite Exp::Liveness(std::set<std::string> & /*Live*/,
+                               OptStats * /*S*/) {
+  return Rewrite::keep;
+}
+
+/// <term> ::= <fac> | <fac> * <term>
+Rewrite::Rewrite Term::Propagate(ConstEnv &Env, OptStats &S) {
+  LHSFac->Propagate(Env, S);
+  if (RHSTerm != nullptr) {
+    RHSTerm->Propagate(Env, S);
+  }
+  return Rewrite::keep;
+}
+
+Rewrite::Rewrite Term::Liveness(std::set<std::string> & /*Live*/,
+                                OptStats * /*S*/) {
+  return Rewrite::keep;
+}
@@ -0,0 +1,357 @@
+//===--- Node+Range.cpp ---------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements the value-range analysis of `Node`s. The ranges are
+//   seeded by integer literals, narrowed by the comparisons of conditions and
+//   widened to the `int` limits around loops. Arithmetic whose result is proven
+//   to stay within an `int` is marked as unchecked so that every engine can
+//   skip its overflow check.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/AST/Node.h"
+#include "core/AST/OptStats.h"
+
+//===----------------------------------------------------------------------===//
+// Ranges: helper functions
+//===----------------------------------------------------------------------===//
+
+/// Keeps in `Env` the ranges covering both `Env` and `Other`.
+static void joinEnv(RangeEnv &Env, const RangeEnv &Other) {
+  for (auto It = Env.begin(); It != Env.end();) {
+    auto O = Other.find(It->first);
+    if (O == Other.end()) {
+      // Missing means any value.
+      It = Env.erase(It);
+    } else {
+      It->second = It->second.join(O->second);
+      ++It;
+    }
+  }
+}
+
+/// Widens every range of `Env` that grew since `Old`.
+static void widenEnv(RangeEnv &Env, const RangeEnv &Old) {
+  for (auto &Entry : Env) {
+    auto O = Old.find(Entry.first);
+    if (O != Old.end()) {
+      Entry.second = Entry.second.widen(O->second);
+    }
+  }
+}
+
+/// Counts an overflow check and whether it could be removed.
+static void countCheck(OptStats *S, bool Safe) {
+  if (S == nullptr) return;
+  ++S->Checks;
+  if (Safe) ++S->ChecksEliminated;
+}
+
+/// Whether refining for an outcome of a condition left some identifier
+/// without any value, so that the outcome is impossible.
+static bool hasEmpty(const RangeEnv &Env) {
+  for (auto &Entry : Env) {
+    if (Entry.second.isEmpty()) return true;
+  }
+  return false;
+}
+
+/// Returns the comparison that holds when `CompType` does not.
+static unsigned negateComparison(unsigned CompType) {
+  switch (CompType) {
+  case TokenType::comp_not_equal: return TokenType::comp_equal;
+  case TokenType::comp_less_than: return TokenType::comp_greater_than_equal;
+  case TokenType::comp_greater_than: return TokenType::comp_less_than_equal;
+  case TokenType::comp_less_than_equal: return TokenType::comp_greater_than;
+  case TokenType::comp_greater_than_equal: return TokenType::comp_less_than;
+  case TokenType::comp_equal: return TokenType::comp_not_equal;
+  }
+  assert(false && "Unknown comparison.");
+  return CompType;
+}
+
+/// Removes `V` from `R` if it is one of its bounds.
+static Range exclude(Range R, const Range &V) {
+  if (V.isEmpty() || V.Lo != V.Hi) return R;
+  if (R.Lo == V.Lo) ++R.Lo;
+  if (R.Hi == V.Lo) --R.Hi;
+  return R;
+}
+
+void Comp::Refine(RangeEnv &Env, bool Outcome) {
+  unsigned Op = Outcome ? CompType : negateComparison(CompType);
+  Range L = LHSFac->Bound(Env, nullptr);
+  Range R = RHSFac->Bound(Env, nullptr);
+
+  Range NewL = L, NewR = R;
+  switch (Op) {
+  case TokenType::comp_less_than:
+    NewL = L.meet(Range(INT_MIN, R.Hi - 1));
+    NewR = R.meet(Range(L.Lo + 1, INT_MAX));
+    break;
+  case TokenType::comp_less_than_equal:
+    NewL = L.meet(Range(INT_MIN, R.Hi));
+    NewR = R.meet(Range(L.Lo, INT_MAX));
+    break;
+  case TokenType::comp_greater_than:
+    NewL = L.meet(Range(R.Lo + 1, INT_MAX));
+    NewR = R.meet(Range(INT_MIN, L.Hi - 1));
+    break;
+  case TokenType::comp_greater_than_equal:
+    NewL = L.meet(Range(R.Lo, INT_MAX));
+    NewR = R.meet(Range(INT_MIN, L.Hi));
+    break;
+  case TokenType::comp_equal: NewL = NewR = L.meet(R); break;
+  case TokenType::comp_not_equal:
+    NewL = exclude(L, R);
+    NewR = exclude(R, L);
+    break;
+  }
+
+  // Only identifiers keep what was learned.
+  if (LHSFac->getId() != nullptr) {
+    Env[LHSFac->getId()->getName()] = NewL;
+  }
+  if (RHSFac->getId() != nullptr) {
+    Env[RHSFac->getId()->getName()] = NewR;
+  }
+}
+
+void Cond::Refine(RangeEnv &Env, bool Outcome) {
+  if (Comp != nullptr) {
+    Comp->Refine(Env, Outcome);
+    return;
+  }
+  if (CondType == TokenType::exclamation_mark) {
+    RHSCond->Refine(Env, !Outcome);
+    return;
+  }
+
+  // A true `and` / false `or` means both sides had the outcome.
+  if (Outcome == (CondType == TokenType::rw_and)) {
+    LHSCond->Refine(Env, Outcome);
+    RHSCond->Refine(Env, Outcome);
+    return;
+  }
+
+  // Otherwise either side could be responsible for it.
+  RangeEnv Other = Env;
+  LHSCond->Refine(Env, Outcome);
+  RHSCond->Refine(Other, Outcome);
+  joinEnv(Env, Other);
+}
+
+//===----------------------------------------------------------------------===//
+// Ranges: top level
+//===----------------------------------------------------------------------===//
+
+/// <prog> ::= program <decl-seq> begin <stmt-seq> end
+Range Prog::Bound(RangeEnv &Env, OptStats *S) {
+  return StmtSeq->Bound(Env, S);
+}
+
+//===----------------------------------------------------------------------===//
+// Ranges: sequence-like grammar rules (<x-seq> ::= <x> <x-seq>)
+//===----------------------------------------------------------------------===//
+
+/// <decl-seq> ::= <decl> | <decl> <decl-seq>
+Range DeclSeq::Bound(RangeEnv & /*Env*/, OptStats * /*S*/) {
+  return Range::full();
+}
+
+/// <stmt-seq> ::= <stmt> | <stmt> <stmt-seq>
+Range StmtSeq::Bound(RangeEnv &Env, OptStats *S) {
+  if (isEmpty()) return Range::full();
+  Stmt->Bound(Env, S);
+  if (Seq != nullptr) {
+    Seq->Bound(Env, S);
+  }
+  return Range::full();
+}
+
+/// <id-list> ::= <id> | <id> <id-list>
+Range IdList::Bound(RangeEnv & /*Env*/, OptStats * /*S*/) {
+  return Range::full();
+}
+
+//===----------------------------------------------------------------------===//
+// Ranges: elements of sequence-like grammar rules
+//===----------------------------------------------------------------------===//
+
+/// <decl> ::= int <id-list>;
+Range Decl::Bound(RangeEnv & /*Env*/, OptStats * /*S*/) {
+  return Range::full();
+}
+
+/// <stmt> ::= <assign> | <if> | <loop> | <in> | <out>
+Range Stmt::Bound(RangeEnv &Env, OptStats *S) { return Node->Bound(Env, S); }
+
+/// <id> ::= <let-seq> | <let-seq><int>
+Range Id::Bound(RangeEnv &Env, OptStats * /*S*/) {
+  auto It = Env.find(Name);
+  return It == Env.end() ? Range::full() : It->second;
+}
+
+//===----------------------------------------------------------------------===//
+// Ranges: specific statements
+//===----------------------------------------------------------------------===//
+
+/// <assign> ::= <id> = <exp>;
+Range Assign::Bound(RangeEnv &Env, OptStats *S) {
+  Env[Id->getName()] = Exp->Bound(Env, S);
+  return Range::full();
+}
+
+/// <if> ::= if <cond> then <stmt-seq> end;
+///        | if <cond> then <stmt-seq> else <stmt-seq> end;
+Range If::Bound(RangeEnv &Env, OptStats *S) {
+  Cond->Bound(Env, S);
+
+  RangeEnv ElseEnv = Env;
+  Cond->Refine(Env, true);
+  IfSeq->Bound(Env, S);
+  Cond->Refine(ElseEnv, false);
+  if (ElseSeq != nullptr) {
+    ElseSeq->Bound(ElseEnv, S);
+  }
+  joinEnv(Env, ElseEnv);
+  return Range::full();
+}
+
+/// <loop> ::= while <cond> loop <stmt-seq> end;
+Range Loop::Bound(RangeEnv &Env, OptStats *S) {
+  // Find the ranges at the head of the loop: those on entry joined with those
+  // at the end of the body, until nothing changes.
+  RangeEnv Head = Env;
+  while (true) {
+    RangeEnv BodyEnv = Head;
+    Cond->Refine(BodyEnv, true);
+    Seq->Bound(BodyEnv, nullptr);
+
+    RangeEnv Next = Head;
+    joinEnv(Next, BodyEnv);
+    widenEnv(Next, Head);
+    if (Next == Head) break;
+    Head = Next;
+  }
+
+  // Only now are the ranges final and can the checks be marked.
+  unsigned Kept = S != nullptr ? S->Checks - S->ChecksEliminated : 0;
+  Cond->Bound(Head, S);
+
+  // A condition that may report an overflow has to be evaluated, however
+  // well its outcome is known.
+  if (S != nullptr) {
+    bool CondChecked = S->Checks - S->ChecksEliminated != Kept;
+    Trips = CondChecked ? -1 : CountTrips(Env);
+  }
+
+  RangeEnv BodyEnv = Head;
+  Cond->Refine(BodyEnv, true);
+  Seq->Bound(BodyEnv, S);
+
+  Env = Head;
+  Cond->Refine(Env, false);
+  return Range::full();
+}
+
+int Loop::CountTrips(const RangeEnv &Env) {
+  // Fully unrolling longer loops would not pay off.
+  static const int MaxTrips = 64;
+
+  RangeEnv Sim = Env;
+  if (hasEmpty(Sim)) return -1;
+  for (int N = 0; N <= MaxTrips; ++N) {
+    RangeEnv Exit = Sim;
+    Cond->Refine(Exit, false);
+    if (hasEmpty(Exit)) {
+      // The condition holds, so the body runs once more.
+      Cond->Refine(Sim, true);
+      Seq->Bound(Sim, nullptr);
+      if (hasEmpty(Sim)) return -1;
+      continue;
+    }
+    RangeEnv Enter = Sim;
+    Cond->Refine(Enter, true);
+    return hasEmpty(Enter) ? N : -1;
+  }
+  return -1;
+}
+
+/// <in> ::= read <id-list>;
+/// Input can be any `int`.
+Range In::Bound(RangeEnv &Env, OptStats * /*S*/) {
+  IdList *L = Seq;
+  for (int Value : Known) {
+    Env[L->getId()->getName()] = Range(Value, Value);
+    L = L->getSeq();
+  }
+  for (; L != nullptr; L = L->getSeq()) {
+    Env.erase(L->getId()->getName());
+  }
+  return Range::full();
+}
+
+/// <out> ::= write <id-list>;
+Range Out::Bound(RangeEnv & /*Env*/, OptStats * /*S*/) {
+  return Range::full();
+}
+
+/// <cond> ::= <comp> | !<cond> | [ <cond> and <cond> ] | [ <cond> or <cond> ]
+Range Cond::Bound(RangeEnv &Env, OptStats *S) {
+  if (Comp != nullptr) return Comp->Bound(Env, S);
+  if (LHSCond != nullptr) {
+    LHSCond->Bound(Env, S);
+  }
+  return RHSCond->Bound(Env, S);
+}
+
+/// <comp> ::= ( <fac> <comp-op> <fac> )
+Range Comp::Bound(RangeEnv &Env, OptStats *S) {
+  LHSFac->Bound(Env, S);
+  RHSFac->Bound(Env, S);
+  return Range(0, 1);
+}
+
+//===----------------------------------------------------------------------===//
+// Ranges: math related statements
+//===----------------------------------------------------------------------===//
+
+/// <fac> ::= <int> | <id> | ( <exp> )
+Range Fac::Bound(RangeEnv &Env, OptStats *S) {
+  if (Id != nullptr) {
+    return Id->Bound(Env, S);
+  } else if (Exp != nullptr) {
+    return Exp->Bound(Env, S);
+  }
+  return Range(Int, Int);
+}
+
+/// <exp> ::= <term> | <term> + <exp> | <term> - <exp>
+Range Exp::Bound(RangeEnv &Env, OptStats *S) {
+  Range L = LHSTerm->Bound(Env, S);
+  if (RHSExp == nullptr) return L;
+
+  Range R = RHSExp->Bound(Env, S);
+  Range Result = ExpType == TokenType::plus ? L + R : L - R;
+  countCheck(S, Result.fitsInt());
+  if (S != nullptr) Checked = !Result.fitsInt();
+
+  // Past the check the value is an `int`.
+  return Result.clamp();
+}
+
+/// <term> ::= <fac> | <fac> * <term>
+Range Term::Bound(RangeEnv &Env, OptStats *S) {
+  Range L = LHSFac->Bound(Env, S);
+  if (RHSTerm == nullptr) return L;
+
+  // The check is only exact for a non-negative right hand side, see
+  // `Arith::Multiply`.
+  Range R = RHSTerm->Bound(Env, S);
+  Range Result = L * R;
+  bool Safe = Result.fitsInt() && (R.isEmpty() || R.Lo >= 0);
+  countCheck(S, Safe);
+  if (S != nullptr) Checked = !Safe;
+  return Result.clamp();
+}
@@ -0,0 +1,339 @@
+//===--- Node+Select.cpp --------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements choosing the evaluator of each factor, term,
+//   expression and comparison. Every combination of operator, overflow check
+//   and operand shape is its own instantiation of a template, so the variant is
+//   decided once when the tree changes instead of on every evaluation.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/AST/ASTContext.h"
+#include "core/AST/Arithmetic.h"
+#include "core/AST/Node.h"
+
+#include <functional> // std::equal_to, std::less, ...
+
+//===----------------------------------------------------------------------===//
+// Selecting: helper functions
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+/// What an operand is once single factors are looked through: `X` and `( 5 )`
+/// in a term or expression are read directly instead of calling down the
+/// tree.
+namespace Shape {
+enum Shape { constant = 0, id, other };
+} // namespace Shape
+
+Shape::Shape getShape(const Fac *F) {
+  if (F == nullptr) return Shape::other;
+  if (F->isConstant()) return Shape::constant;
+  return F->getId() != nullptr ? Shape::id : Shape::other;
+}
+
+/// The factor an operand consists of. Only valid if its shape is not `other`.
+const Fac *getLone(const Fac *F) { return F; }
+const Fac *getLone(const Term *T) { return T->getLHSFac(); }
+const Fac *getLone(const Exp *E) { return E->getLHSTerm()->getLHSFac(); }
+
+/// Reads an operand of shape `S`.
+template <Shape::Shape S> struct Operand {
+  template <typename T> static int get(const T *N, ASTContext &C) {
+    return N->Calculate(C);
+  }
+};
+
+template <> struct Operand<Shape::constant> {
+  template <typename T> static int get(const T *N, ASTContext &) {
+    return getLone(N)->getConstant();
+  }
+};
+
+template <> struct Operand<Shape::id> {
+  template <typename T> static int get(const T *N, ASTContext &C) {
+    return C.Get(getLone(N)->getId());
+  }
+};
+
+/// The arithmetic operators, unchecked and checked.
+struct Plus {
+  static int apply(int L, int R) { return L + R; }
+  static ArithResult::ArithResult check(int L, int R, int &Out) {
+    return Arith::Add(L, R, Out);
+  }
+};
+
+struct Minus {
+  static int apply(int L, int R) { return L - R; }
+  static ArithResult::ArithResult check(int L, int R, int &Out) {
+    return Arith::Subtract(L, R, Out);
+  }
+};
+
+struct Times {
+  static int apply(int L, int R) { return L * R; }
+  static ArithResult::ArithResult check(int L, int R, int &Out) {
+    return Arith::Multiply(L, R, Out);
+  }
+};
+
+/// Applies `Op` to the operands, throwing at `Tok` if it is `Checked` and
+/// fails. `Checked` is a constant, so each instantiation keeps one branch.
+template <typename Op, bool Checked>
+int apply(int L, int R, const Token &Tok) {
+  if (!Checked) {
+    // Proven safe by the value-range analysis.
+    return Op::apply(L, R);
+  }
+  int Value;
+  ArithResult::ArithResult Result = Op::check(L, R, Value);
+  if (Result != ArithResult::ok) throw Arith::Diagnose(Tok, Result);
+  return Value;
+}
+
+/// <fac> ::= <int> | <id> | ( <exp> )
+template <Shape::Shape S> int calcFac(const Fac &F, ASTContext &C) {
+  return Operand<S>::get(&F, C);
+}
+
+template <> int calcFac<Shape::other>(const Fac &F, ASTContext &C) {
+  return static_cast<const Exp *>(F.getExp())->Calculate(C);
+}
+
+/// <term> ::= <fac>
+template <Shape::Shape S> int calcLoneTerm(const Term &T, ASTContext &C) {
+  return Operand<S>::get(T.getLHSFac(), C);
+}
+
+/// <term> ::= <fac> * <term>
+template <bool Checked> struct TermEval {
+  template <Shape::Shape L, Shape::Shape R>
+  static int run(const Term &T, ASTContext &C) {
+    int LHS = Operand<L>::get(T.getLHSFac(), C);
+    int RHS = Operand<R>::get(T.getRHSTerm(), C);
+    return apply<Times, Checked>(LHS, RHS, T.getToken());
+  }
+};
+
+/// <exp> ::= <term>
+template <Shape::Shape S> int calcLoneExp(const Exp &E, ASTContext &C) {
+  return Operand<S>::get(E.getLHSTerm(), C);
+}
+
+/// <exp> ::= <term> + <exp> | <term> - <exp>
+template <typename Op, bool Checked> struct ExpEval {
+  template <Shape::Shape L, Shape::Shape R>
+  static int run(const Exp &E, ASTContext &C) {
+    int LHS = Operand<L>::get(E.getLHSTerm(), C);
+    int RHS = Operand<R>::get(E.getRHSExp(), C);
+    return apply<Op, Checked>(LHS, RHS, E.getToken());
+  }
+};
+
+/// <comp> ::= ( <fac> <comp-op> <fac> )
+template <typename Cmp> struct CompEval {
+  template <Shape::Shape L, Shape::Shape R>
+  static bool run(const Comp &N, ASTContext &C) {
+    int LHS = Operand<L>::get(N.getLHSFac(), C);
+    int RHS = Operand<R>::get(N.getRHSFac(), C);
+    return Cmp()(LHS, RHS);
+  }
+};
+
+/// Picks the instantiation of `Eval::run` for the shapes of both operands.
+template <typename Eval, typename Fn> struct Pick {
+  template <Shape::Shape L> static Fn right(Shape::Shape R) {
+    switch (R) {
+    case Shape::constant: return &Eval::template run<L, Shape::constant>;
+    case Shape::id: return &Eval::template run<L, Shape::id>;
+    case Shape::other: break;
+    }
+    return &Eval::template run<L, Shape::other>;
+  }
+
+  static Fn get(Shape::Shape L, Shape::Shape R) {
+    switch (L) {
+    case Shape::constant: return right<Shape::constant>(R);
+    case Shape::id: return right<Shape::id>(R);
+    case Shape::other: break;
+    }
+    return right<Shape::other>(R);
+  }
+};
+
+} // end anonymous namespace
+
+//===----------------------------------------------------------------------===//
+// Selecting: top level
+//===----------------------------------------------------------------------===//
+
+/// <prog> ::= program <decl-seq> begin <stmt-seq> end
+void Prog::Select() { StmtSeq->Select(); }
+
+//===----------------------------------------------------------------------===//
+// Selecting: sequence-like grammar rules (<x-seq> ::= <x> <x-seq>)
+//===----------------------------------------------------------------------===//
+
+/// <decl-seq> ::= <decl> | <decl> <decl-seq>
+void DeclSeq::Select() {}
+
+/// <stmt-seq> ::= <stmt> | <stmt> <stmt-seq>
+void StmtSeq::Select() {
+  if (isEmpty()) return;
+  Stmt->Select();
+  if (Seq != nullptr) {
+    Seq->Select();
+  }
+}
+
+/// <id-list> ::= <id> | <id> <id-list>
+void IdList::Select() {}
+
+//===----------------------------------------------------------------------===//
+// Selecting: elements of sequence-like grammar rules
+//===----------------------------------------------------------------------===//
+
+/// <decl> ::= int <id-list>;
+void Decl::Select() {}
+
+/// <stmt> ::= <assign> | <if> | <loop> | <in> | <out>
+void Stmt::Select() { Node->Select(); }
+
+/// <id> ::= <let-seq> | <let-seq><int>
+void Id::Select() {}
+
+//===----------------------------------------------------------------------===//
+// Selecting: specific statements
+//===----------------------------------------------------------------------===//
+
+/// <assign> ::= <id> = <exp>;
+void Assign::Select() { Exp->Select(); }
+
+/// <if> ::= if <cond> then <stmt-seq> end;
+///        | if <cond> then <stmt-seq> else <stmt-seq> end;
+void If::Select() {
+  Cond->Select();
+  IfSeq->Select();
+  if (ElseSeq != nullptr) {
+    ElseSeq->Select();
+  }
+}
+
+/// <loop> ::= while <cond> loop <stmt-seq> end;
+void Loop::Select() {
+  Cond->Select();
+  Seq->Select();
+}
+
+/// <in> ::= read <id-list>;
+void In::Select() {}
+
+/// <out> ::= write <id-list>;
+void Out::Select() {}
+
+/// <cond> ::= <comp> | !<cond> | [ <cond> and <cond> ] | [ <cond> or <cond> ]
+void Cond::Select() {
+  if (Comp != nullptr) {
+    Comp->Select();
+    return;
+  }
+  if (LHSCond != nullptr) {
+    LHSCond->Select();
+  }
+  RHSCond->Select();
+}
+
+/// <comp> ::= ( <fac> <comp-op> <fac> )
+void Comp::Select() {
+  LHSFac->Select();
+  RHSFac->Select();
+
+  Shape::Shape L = getShape(LHSFac), R = getShape(RHSFac);
+  typedef bool (*Fn)(const class Comp &, ASTContext &);
+  switch (CompType) {
+  case TokenType::comp_not_equal:
+    Test = Pick<CompEval<std::not_equal_to<int>>, Fn>::get(L, R);
+    return;
+  case TokenType::comp_less_than:
+    Test = Pick<CompEval<std::less<int>>, Fn>::get(L, R);
+    return;
+  case TokenType::comp_greater_than:
+    Test = Pick<CompEval<std::greater<int>>, Fn>::get(L, R);
+    return;
+  case TokenType::comp_less_than_equal:
+    Test = Pick<CompEval<std::less_equal<int>>, Fn>::get(L, R);
+    return;
+  case TokenType::comp_greater_than_equal:
+    Test = Pick<CompEval<std::greater_equal<int>>, Fn>::get(L, R);
+    return;
+  case TokenType::comp_equal:
+    Test = Pick<CompEval<std::equal_to<int>>, Fn>::get(L, R);
+    return;
+  }
+  assert(false && "Unknown comparison.");
+}
+
+//===----------------------------------------------------------------------===//
+// Selecting: math related statements
+//===----------------------------------------------------------------------===//
+
+/// <fac> ::= <int> | <id> | ( <exp> )
+void Fac::Select() {
+  if (Exp != nullptr) {
+    Exp->Select();
+  }
+  switch (getShape(this)) {
+  case Shape::constant: Calc = calcFac<Shape::constant>; return;
+  case Shape::id: Calc = calcFac<Shape::id>; return;
+  case Shape::other: Calc = calcFac<Shape::other>; return;
+  }
+}
+
+/// <exp> ::= <term> | <term> + <exp> | <term> - <exp>
+void Exp::Select() {
+  LHSTerm->Select();
+  Shape::Shape L = getShape(LHSTerm->getRHSTerm() == nullptr
+                                ? LHSTerm->getLHSFac()
+                                : nullptr);
+  if (ExpType == 0) {
+    switch (L) {
+    case Shape::constant: Calc = calcLoneExp<Shape::constant>; return;
+    case Shape::id: Calc = calcLoneExp<Shape::id>; return;
+    case Shape::other: Calc = calcLoneExp<Shape::other>; return;
+    }
+  }
+
+  RHSExp->Select();
+  Shape::Shape R = getShape(RHSExp->getLoneFac());
+  typedef int (*Fn)(const class Exp &, ASTContext &);
+  if (ExpType == TokenType::plus) {
+    Calc = Checked ? Pick<ExpEval<Plus, true>, Fn>::get(L, R)
+                   : Pick<ExpEval<Plus, false>, Fn>::get(L, R);
+  } else {
+    Calc = Checked ? Pick<ExpEval<Minus, true>, Fn>::get(L, R)
+                   : Pick<ExpEval<Minus, false>, Fn>::get(L, R);
+  }
+}
+
+/// <term> ::= <fac> | <fac> * <term>
+void Term::Select() {
+  LHSFac->Select();
+  Shape::Shape L = getShape(LHSFac);
+  if (RHSTerm == nullptr) {
+    switch (L) {
+    case Shape::constant: Calc = calcLoneTerm<Shape::constant>; return;
+    case Shape::id: Calc = calcLoneTerm<Shape::id>; return;
+    case Shape::other: Calc = calcLoneTerm<Shape::other>; return;
+    }
+  }
+
+  RHSTerm->Select();
+  Shape::Shape R = getShape(RHSTerm->getRHSTerm() == nullptr
+                                ? RHSTerm->getLHSFac()
+                                : nullptr);
+  typedef int (*Fn)(const Term &, ASTContext &);
+  Calc = Checked ? Pick<TermEval<true>, Fn>::get(L, R)
+                 : Pick<TermEval<false>, Fn>::get(L, R);
+}
@@ -0,0 +1,120 @@
+//===--- Node+Specialize.cpp ----------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements giving the first reads of a program values known
+//   ahead of the run. Those reads become constants for the other
+//   optimizations, leaving a residual program that reads only the rest.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/AST/Node.h"
+
+//===----------------------------------------------------------------------===//
+// Specializing: helper functions
+//===----------------------------------------------------------------------===//
+
+IdList *In::getUnknown() const {
+  IdList *L = Seq;
+  for (size_t N = 0; N < Known.size(); ++N) {
+    L = L->getSeq();
+  }
+  return L;
+}
+
+//===----------------------------------------------------------------------===//
+// Specializing: top level
+//===----------------------------------------------------------------------===//
+
+/// <prog> ::= program <decl-seq> begin <stmt-seq> end
+bool Prog::Specialize(std::deque<int> &Inputs) {
+  return StmtSeq->Specialize(Inputs);
+}
+
+//===----------------------------------------------------------------------===//
+// Specializing: sequence-like grammar rules (<x-seq> ::= <x> <x-seq>)
+//===----------------------------------------------------------------------===//
+
+/// <decl-seq> ::= <decl> | <decl> <decl-seq>
+bool DeclSeq::Specialize(std::deque<int> & /*Inputs*/) { return true; }
+
+/// <stmt-seq> ::= <stmt> | <stmt> <stmt-seq>
+bool StmtSeq::Specialize(std::deque<int> &Inputs) {
+  if (isEmpty()) return true;
+  if (!Stmt->Specialize(Inputs)) return false;
+  return Seq == nullptr || Seq->Specialize(Inputs);
+}
+
+/// <id-list> ::= <id> | <id> <id-list>
+bool IdList::Specialize(std::deque<int> & /*Inputs*/) { return true; }
+
+//===----------------------------------------------------------------------===//
+// Specializing: elements of sequence-like grammar rules
+//===----------------------------------------------------------------------===//
+
+/// <decl> ::= int <id-list>;
+bool Decl::Specialize(std::deque<int> & /*Inputs*/) { return true; }
+
+/// <stmt> ::= <assign> | <if> | <loop> | <in> | <out>
+bool Stmt::Specialize(std::deque<int> &Inputs) {
+  return Node->Specialize(Inputs);
+}
+
+/// <id> ::= <let-seq> | <let-seq><int>
+bool Id::Specialize(std::deque<int> & /*Inputs*/) { return true; }
+
+//===----------------------------------------------------------------------===//
+// Specializing: specific statements
+//===----------------------------------------------------------------------===//
+
+/// <assign> ::= <id> = <exp>;
+bool Assign::Specialize(std::deque<int> & /*Inputs*/) { return true; }
+
+/// <if> ::= if <cond> then <stmt-seq> end;
+///        | if <cond> then <stmt-seq> else <stmt-seq> end;
+bool If::Specialize(std::deque<int> & /*Inputs*/) {
+  // Either body may run first, so neither can be given values until pruning
+  // decides the branch. With no values to give, a body only specializes if it
+  // does not read.
+  std::deque<int> None;
+  return IfSeq->Specialize(None) &&
+         (ElseSeq == nullptr || ElseSeq->Specialize(None));
+}
+
+/// <loop> ::= while <cond> loop <stmt-seq> end;
+bool Loop::Specialize(std::deque<int> & /*Inputs*/) {
+  // Reads in the body run an unknown number of times.
+  std::deque<int> None;
+  return Seq->Specialize(None);
+}
+
+/// <in> ::= read <id-list>;
+bool In::Specialize(std::deque<int> &Inputs) {
+  for (IdList *L = getUnknown(); L != nullptr && !Inputs.empty();
+       L = L->getSeq()) {
+    Known.push_back(Inputs.front());
+    Inputs.pop_front();
+  }
+  return getUnknown() == nullptr;
+}
+
+/// <out> ::= write <id-list>;
+bool Out::Specialize(std::deque<int> & /*Inputs*/) { return true; }
+
+/// <cond> ::= <comp> | !<cond> | [ <cond> and <cond> ] | [ <cond> or <cond> ]
+bool Cond::Specialize(std::deque<int> & /*Inputs*/) { return true; }
+
+/// <comp> ::= ( <fac> <comp-op> <fac> )
+bool Comp::Specialize(std::deque<int> & /*Inputs*/) { return true; }
+
+//===----------------------------------------------------------------------===//
+// Specializing: math related statements
+//===----------------------------------------------------------------------===//
+
+/// <fac> ::= <int> | <id> | ( <exp> )
+bool Fac::Specialize(std::deque<int> & /*Inputs*/) { return true; }
+
+/// <exp> ::= <term> | <term> + <exp> | <term> - <exp>
+bool Exp::Specialize(std::deque<int> & /*Inputs*/) { return true; }
+
+/// <term> ::= <fac> | <fac> * <term>
+bool Term::Specialize(std::deque<int> & /*Inputs*/) { return true; }
@@ -0,0 +1,24 @@
+//===--- OptStats.cpp -----------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements printing of the optimization counters.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/AST/OptStats.h"
+
+#include <iomanip>  // std::setprecision
+#include <iostream> // std::endl
+
+void OptStats::Print(std::ostream &X) const {
+  X << "Dead stores removed:     " << DeadStores << std::endl;
+  X << "Dead branches pruned:    " << DeadBranches << std::endl;
+  X << "Dead loops removed:      " << DeadLoops << std::endl;
+  X << "Total nodes removed:     " << getRemoved() << std::endl;
+  X << "Closed-form loops:       " << ClosedFormLoops << std::endl;
+
+  double Fraction = Checks == 0 ? 0 : 100.0 * ChecksEliminated / Checks;
+  X << "Overflow checks removed: " << ChecksEliminated << " of " << Checks
+    << " (" << std::fixed << std::setprecision(1) << Fraction << "%)"
+    << std::endl;
+}
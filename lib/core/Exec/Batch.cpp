@@ -0,0 +1,144 @@
+//===--- Batch.cpp --------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements the work-stealing batch executor.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/Exec/Batch.h"
+
+#include <algorithm>          // std::min
+#include <condition_variable> // std::condition_variable
+#include <deque>              // std::deque
+#include <mutex>              // std::mutex, std::lock_guard, std::unique_lock
+#include <sstream>            // std::istringstream, std::ostringstream
+#include <thread>             // std::thread
+
+namespace {
+
+/// The groups of records a worker still has to run (single records unless
+/// running lanes). The owner takes from the front and thieves take from the
+/// back, so that each worker mostly runs a contiguous range of records and the
+/// outputs can be written early.
+struct WorkQueue {
+  std::mutex Lock;
+  std::deque<size_t> Groups;
+};
+
+/// Takes the next group for worker `Self`, stealing from the other workers
+/// once its own queue is empty.
+/// \return false when no group is left anywhere.
+bool take(std::vector<WorkQueue> &Queues, unsigned Self, size_t &Index) {
+  for (unsigned N = 0; N < Queues.size(); ++N) {
+    WorkQueue &Q = Queues[(Self + N) % Queues.size()];
+    std::lock_guard<std::mutex> Guard(Q.Lock);
+    if (Q.Groups.empty()) continue;
+    if (N == 0) {
+      Index = Q.Groups.front();
+      Q.Groups.pop_front();
+    } else {
+      Index = Q.Groups.back();
+      Q.Groups.pop_back();
+    }
+    return true;
+  }
+  // Records are never added, so there is nothing left to steal either.
+  return false;
+}
+
+} // end anonymous namespace
+
+Batch::Batch(Runner Single, unsigned Threads)
+    : Lanes(1), Threads(Threads == 0 ? 1 : Threads) {
+  Run = [Single](const std::vector<std::istream *> &Ins,
+                 const std::vector<std::ostream *> &Outs) {
+    std::vector<std::string> Errors(1);
+    try {
+      Single(*Ins[0], *Outs[0]);
+    } catch (std::string &Error) {
+      Errors[0] = Error;
+    }
+    return Errors;
+  };
+}
+
+Batch::Batch(LaneRunner Run, unsigned Lanes, unsigned Threads)
+    : Run(Run), Lanes(Lanes == 0 ? 1 : Lanes),
+      Threads(Threads == 0 ? 1 : Threads) {}
+
+void Batch::Execute(const std::vector<std::string> &Records,
+                    std::ostream &Out) {
+  size_t Total = Records.size();
+  size_t Groups = (Total + Lanes - 1) / Lanes;
+  std::vector<WorkQueue> Queues(Threads);
+  for (unsigned W = 0; W < Threads; ++W) {
+    for (size_t G = W * Groups / Threads; G < (W + 1) * Groups / Threads;
+         ++G) {
+      Queues[W].Groups.push_back(G);
+    }
+  }
+
+  // Finished outputs wait here until every record before them is written.
+  std::vector<std::string> Results(Total);
+  std::vector<bool> Done(Total, false);
+  size_t Next = 0;
+  std::mutex DoneLock;
+  std::condition_variable Ready;
+
+  auto Work = [&](unsigned Self) {
+    size_t Group;
+    while (take(Queues, Self, Group)) {
+      size_t First = Group * Lanes;
+      size_t Count = std::min<size_t>(Lanes, Total - First);
+      std::vector<std::istringstream> Ins(Count);
+      std::vector<std::ostringstream> Outputs(Count);
+      std::vector<std::istream *> InPtrs;
+      std::vector<std::ostream *> OutPtrs;
+      for (size_t N = 0; N < Count; ++N) {
+        Ins[N].str(Records[First + N]);
+        InPtrs.push_back(&Ins[N]);
+        OutPtrs.push_back(&Outputs[N]);
+      }
+      std::vector<std::string> Errors = Run(InPtrs, OutPtrs);
+      for (size_t N = 0; N < Count; ++N) {
+        if (!Errors[N].empty()) Outputs[N] << Errors[N] << std::endl;
+      }
+
+      std::lock_guard<std::mutex> Guard(DoneLock);
+      for (size_t N = 0; N < Count; ++N) {
+        Results[First + N] = Outputs[N].str();
+        Done[First + N] = true;
+      }
+      if (Next >= First && Next < First + Count) Ready.notify_one();
+    }
+  };
+
+  std::vector<std::thread> Workers;
+  for (unsigned W = 0; W < Threads; ++W) {
+    Workers.push_back(std::thread(Work, W));
+  }
+
+  std::unique_lock<std::mutex> Guard(DoneLock);
+  for (; Next < Total; ++Next) {
+    Ready.wait(Guard, [&]() { return Done[Next]; });
+    std::string Text;
+    Text.swap(Results[Next]);
+    Guard.unlock();
+    Out << Text;
+    Guard.lock();
+  }
+  Guard.unlock();
+
+  for (auto &Worker : Workers) {
+    Worker.join();
+  }
+}
+
+std::vector<std::string> Batch::ReadRecords(std::istream &In) {
+  std::vector<std::string> Records;
+  std::string Line;
+  while (std::getline(In, Line)) {
+    Records.push_back(Line);
+  }
+  return Records;
+}
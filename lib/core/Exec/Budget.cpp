@@ -0,0 +1,65 @@
+//===--- Budget.cpp -------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements the limits of a run.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/Exec/Budget.h"
+#include "core/AST/Checkpoint.h"
+#include "core/Diag/Diag.h"
+
+#include <algorithm> // std::min
+#include <limits>    // std::numeric_limits
+#include <string>    // std::to_string
+
+Budget::Budget(unsigned long long MaxSteps, unsigned MaxMillis,
+               unsigned Quantum)
+    : MaxSteps(MaxSteps), MaxMillis(MaxMillis),
+      Deadline(std::chrono::steady_clock::now() +
+               std::chrono::milliseconds(MaxMillis)),
+      Quantum(Quantum), SliceEnd(Quantum) {
+  Refill();
+}
+
+bool Budget::Advance() {
+  Spent += Chunk;
+  Chunk = 0;
+  if (MaxSteps != 0 && Spent > MaxSteps) {
+    throw Diag(DiagType::runtime_step_budget_x_exceeded,
+               std::to_string(MaxSteps).c_str());
+  }
+  if (MaxMillis != 0 && std::chrono::steady_clock::now() >= Deadline) {
+    throw Diag(DiagType::runtime_time_limit_x_exceeded,
+               std::to_string(MaxMillis).c_str());
+  }
+
+  bool Preempt = Quantum != 0 && Spent >= SliceEnd;
+  if (Preempt) SliceEnd = Spent + Quantum;
+
+  // Without a time limit the countdown runs straight to the last step.
+  Chunk = MaxMillis != 0 ? CheckInterval
+                         : std::numeric_limits<unsigned long long>::max();
+  if (MaxSteps != 0) Chunk = std::min(Chunk, MaxSteps + 1 - Spent);
+  if (Quantum != 0) Chunk = std::min(Chunk, SliceEnd - Spent);
+  Countdown = Chunk;
+
+  // The next slice is counted already, so the run resumed from the back-edge
+  // goes on with a full quantum.
+  return Preempt;
+}
+
+void Budget::Refill() {
+  if (Advance()) throw Checkpoint();
+}
+
+void Budget::Step(unsigned long long N) {
+  bool Preempt = false;
+  while (N >= Countdown) {
+    N -= Countdown;
+    Countdown = 0;
+    Preempt |= Advance();
+  }
+  Countdown -= N;
+  if (Preempt) throw Checkpoint();
+}
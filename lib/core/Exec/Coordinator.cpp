@@ -0,0 +1,266 @@
+//===--- Coordinator.cpp --------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements the multi-process batch executor.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/Exec/Coordinator.h"
+
+#include <cerrno>     // errno, EINTR
+#include <csignal>    // std::signal, SIGPIPE
+#include <cstdint>    // uint64_t
+#include <cstring>    // strsignal
+#include <deque>      // std::deque
+#include <map>        // std::map
+#include <poll.h>     // poll
+#include <sstream>    // std::istringstream, std::ostringstream
+#include <string>     // std::string, std::to_string
+#include <sys/wait.h> // waitpid
+#include <unistd.h>   // fork, pipe, read, write, close, _exit
+#include <vector>     // std::vector
+
+namespace {
+
+/// A record to run, and how many times it was started already.
+struct Job {
+  uint64_t Index;
+  std::string Record;
+  unsigned Attempts;
+};
+
+/// A worker process and the ends of its pipes the coordinator holds.
+struct Worker {
+  pid_t Pid = -1;
+  int ToWorker = -1;
+  int FromWorker = -1;
+
+  /// The job it runs, if it is busy.
+  bool Busy = false;
+  Job Current;
+};
+
+bool writeAll(int Fd, const char *Data, size_t Size) {
+  while (Size > 0) {
+    ssize_t N = write(Fd, Data, Size);
+    if (N < 0 && errno == EINTR) continue;
+    if (N <= 0) return false;
+    Data += N;
+    Size -= N;
+  }
+  return true;
+}
+
+bool readAll(int Fd, char *Data, size_t Size) {
+  while (Size > 0) {
+    ssize_t N = read(Fd, Data, Size);
+    if (N < 0 && errno == EINTR) continue;
+    if (N <= 0) return false;
+    Data += N;
+    Size -= N;
+  }
+  return true;
+}
+
+/// A message is the index of its record and the length of its text, in the
+/// byte order of the machine, followed by the text. Both ends are forks of
+/// the same program.
+bool send(int Fd, uint64_t Index, const std::string &Text) {
+  uint64_t Header[2] = {Index, Text.size()};
+  return writeAll(Fd, (const char *)Header, sizeof(Header)) &&
+         writeAll(Fd, Text.data(), Text.size());
+}
+
+bool receive(int Fd, uint64_t &Index, std::string &Text) {
+  uint64_t Header[2];
+  if (!readAll(Fd, (char *)Header, sizeof(Header))) return false;
+  Index = Header[0];
+  Text.resize(Header[1]);
+  return Text.empty() || readAll(Fd, &Text[0], Text.size());
+}
+
+/// The loop of a worker: runs each record it receives until the coordinator
+/// closes the pipe.
+void serve(int In, int Out, const Batch::Runner &Run) {
+  uint64_t Index;
+  std::string Record;
+  while (receive(In, Index, Record)) {
+    std::istringstream RecordIn(Record);
+    std::ostringstream Output;
+    try {
+      Run(RecordIn, Output);
+    } catch (std::string &Error) {
+      Output << Error << std::endl;
+    }
+    if (!send(Out, Index, Output.str())) return;
+  }
+}
+
+/// Describes how worker `Pid` ended, waiting for it if needed.
+std::string reap(pid_t Pid) {
+  int Status;
+  while (waitpid(Pid, &Status, 0) < 0) {
+    if (errno != EINTR) return "The worker running this record was lost.";
+  }
+  if (WIFSIGNALED(Status)) {
+    return "The worker running this record was killed by signal " +
+           std::to_string(WTERMSIG(Status)) + " (" +
+           strsignal(WTERMSIG(Status)) + ").";
+  }
+  return "The worker running this record exited with status " +
+         std::to_string(WEXITSTATUS(Status)) + ".";
+}
+
+/// Forks worker `Self`. The child closes the pipes of every other worker, so
+/// that the death of one is seen as the end of its pipe.
+/// \return false if the process or its pipes could not be created.
+bool start(std::vector<Worker> &Workers, unsigned Self,
+           const Batch::Runner &Run) {
+  int Down[2], Up[2];
+  if (pipe(Down) != 0) return false;
+  if (pipe(Up) != 0) {
+    close(Down[0]);
+    close(Down[1]);
+    return false;
+  }
+
+  pid_t Pid = fork();
+  if (Pid == 0) {
+    for (unsigned W = 0; W < Workers.size(); ++W) {
+      if (Workers[W].ToWorker >= 0) close(Workers[W].ToWorker);
+      if (Workers[W].FromWorker >= 0) close(Workers[W].FromWorker);
+    }
+    close(Down[1]);
+    close(Up[0]);
+    serve(Down[0], Up[1], Run);
+    // Skip the destructors and buffers the coordinator owns.
+    _exit(0);
+  }
+
+  close(Down[0]);
+  close(Up[1]);
+  if (Pid < 0) {
+    close(Down[1]);
+    close(Up[0]);
+    return false;
+  }
+  Worker &W = Workers[Self];
+  W.Pid = Pid;
+  W.ToWorker = Down[1];
+  W.FromWorker = Up[0];
+  W.Busy = false;
+  return true;
+}
+
+/// Closes the pipes of a worker that died, so that it can be started again.
+std::string bury(Worker &W) {
+  close(W.ToWorker);
+  close(W.FromWorker);
+  W.ToWorker = W.FromWorker = -1;
+  return reap(W.Pid);
+}
+
+} // end anonymous namespace
+
+Coordinator::Coordinator(Batch::Runner Run, unsigned Processes)
+    : Run(Run), Processes(Processes == 0 ? 1 : Processes) {}
+
+void Coordinator::Execute(std::istream &In, std::ostream &Out) {
+  Restarts = 0;
+  // A worker that died is noticed when reading its pipe, not by a signal.
+  void (*Previous)(int) = std::signal(SIGPIPE, SIG_IGN);
+
+  std::vector<Worker> Workers(Processes);
+  Out.flush();
+  for (unsigned W = 0; W < Workers.size(); ++W) {
+    if (!start(Workers, W, Run)) {
+      std::string Error = "Unable to start a worker process.";
+      throw Error;
+    }
+  }
+
+  // Finished outputs wait here until every record before them is written.
+  std::map<uint64_t, std::string> Results;
+  std::deque<Job> Retries;
+  uint64_t Next = 0, Read = 0;
+  bool Exhausted = false;
+
+  // Ends the job of a worker that died and forks it again.
+  auto Restart = [&](unsigned Self) {
+    Worker &W = Workers[Self];
+    std::string Reason = bury(W);
+    if (W.Busy) {
+      Job &J = W.Current;
+      if (++J.Attempts < MaxAttempts) {
+        Retries.push_back(J);
+      } else {
+        Results[J.Index] = "Runtime Error: " + Reason + "\n";
+      }
+    }
+    W.Busy = false;
+    ++Restarts;
+    Out.flush();
+    if (!start(Workers, Self, Run)) {
+      std::string Error = "Unable to start a worker process.";
+      throw Error;
+    }
+  };
+
+  while (true) {
+    // Hand a record to every idle worker.
+    for (unsigned Self = 0; Self < Workers.size(); ++Self) {
+      Worker &W = Workers[Self];
+      if (W.Busy) continue;
+      if (!Retries.empty()) {
+        W.Current = Retries.front();
+        Retries.pop_front();
+      } else {
+        std::string Line;
+        if (Exhausted || !std::getline(In, Line)) {
+          Exhausted = true;
+          continue;
+        }
+        W.Current = {Read++, Line, 0};
+      }
+      W.Busy = true;
+      if (!send(W.ToWorker, W.Current.Index, W.Current.Record)) {
+        Restart(Self);
+      }
+    }
+
+    for (auto It = Results.find(Next); It != Results.end();
+         It = Results.find(++Next)) {
+      Out << It->second;
+      Results.erase(It);
+    }
+
+    std::vector<pollfd> Fds;
+    std::vector<unsigned> Owners;
+    for (unsigned Self = 0; Self < Workers.size(); ++Self) {
+      if (!Workers[Self].Busy) continue;
+      Fds.push_back({Workers[Self].FromWorker, POLLIN, 0});
+      Owners.push_back(Self);
+    }
+    if (Fds.empty() && Retries.empty()) break;
+    if (!Fds.empty() && poll(Fds.data(), Fds.size(), -1) < 0) continue;
+
+    for (unsigned F = 0; F < Fds.size(); ++F) {
+      if (Fds[F].revents == 0) continue;
+      Worker &W = Workers[Owners[F]];
+      uint64_t Index;
+      std::string Output;
+      if (receive(W.FromWorker, Index, Output) && Index == W.Current.Index) {
+        Results[Index] = Output;
+        W.Busy = false;
+      } else {
+        Restart(Owners[F]);
+      }
+    }
+  }
+
+  // Closing the pipes ends the workers.
+  for (Worker &W : Workers) {
+    bury(W);
+  }
+  std::signal(SIGPIPE, Previous);
+}
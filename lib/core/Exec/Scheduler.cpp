@@ -0,0 +1,253 @@
+//===--- Scheduler.cpp ----------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements the scheduler of program instances.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/Exec/Scheduler.h"
+#include "core/Exec/Budget.h"
+#include "core/Exec/Session.h"
+
+#include <cassert> // assert
+#include <chrono>  // std::chrono::steady_clock
+#include <sstream> // std::ostringstream
+
+struct Scheduler::Instance {
+  Instance(const AST &A, unsigned long long MaxSteps, unsigned Quantum,
+           bool DeferChecks, bool ShortCircuit, unsigned Id, unsigned Home)
+      : Run(A, DeferChecks, ShortCircuit), Limits(MaxSteps, 0, Quantum),
+        Id(Id), Home(Home) {
+    Run.setBudget(&Limits);
+  }
+
+  /// Only touched by the worker running the instance.
+  Session Run;
+  Budget Limits;
+
+  const unsigned Id;
+
+  /// Guards the fields below, which the host reads and writes while the
+  /// instance runs.
+  std::mutex Lock;
+
+  /// The worker whose queue the instance goes to.
+  unsigned Home;
+
+  /// Values supplied but not yet given to the session.
+  std::vector<int> Pending;
+
+  Status State = runnable;
+  std::string Waiting;
+  std::string Output;
+  std::string Error;
+  Usage Used;
+};
+
+Scheduler::Scheduler(unsigned Threads, unsigned Quantum)
+    : Quantum(Quantum), Queues(Threads == 0 ? 1 : Threads) {
+  for (unsigned W = 0; W < Queues.size(); ++W) {
+    Workers.push_back(std::thread(&Scheduler::Serve, this, W));
+  }
+}
+
+Scheduler::~Scheduler() {
+  {
+    std::lock_guard<std::mutex> Guard(Lock);
+    Stopping = true;
+  }
+  Wake.notify_all();
+  for (auto &Worker : Workers) {
+    Worker.join();
+  }
+  for (Instance *I : Instances) {
+    delete I;
+  }
+}
+
+unsigned Scheduler::Spawn(const AST &A, unsigned long long MaxSteps,
+                          bool DeferChecks, bool ShortCircuit) {
+  Instance *I;
+  {
+    std::lock_guard<std::mutex> Guard(Lock);
+    unsigned Id = Instances.size();
+    I = new Instance(A, MaxSteps, Quantum, DeferChecks, ShortCircuit, Id,
+                     Id % Queues.size());
+    Instances.push_back(I);
+    ++Active;
+  }
+  Enqueue(I);
+  return I->Id;
+}
+
+void Scheduler::Supply(unsigned Id, int Value) {
+  Instance *I = get(Id);
+  {
+    std::lock_guard<std::mutex> Guard(I->Lock);
+    if (I->State == finished) return;
+    I->Pending.push_back(Value);
+    // A running instance picks the value up at the end of its slice.
+    if (I->State == runnable) return;
+    I->State = runnable;
+    I->Waiting.clear();
+  }
+  {
+    std::lock_guard<std::mutex> Guard(Lock);
+    ++Active;
+  }
+  Enqueue(I);
+}
+
+void Scheduler::Wait() {
+  std::unique_lock<std::mutex> Guard(Lock);
+  Idle.wait(Guard, [this]() { return Active == 0; });
+}
+
+void Scheduler::Enqueue(Instance *I) {
+  unsigned Home;
+  {
+    std::lock_guard<std::mutex> Guard(I->Lock);
+    Home = I->Home;
+  }
+  {
+    std::lock_guard<std::mutex> Guard(Queues[Home].Lock);
+    Queues[Home].Ready.push_back(I);
+  }
+  {
+    std::lock_guard<std::mutex> Guard(Lock);
+    ++Queued;
+  }
+  Wake.notify_one();
+}
+
+Scheduler::Instance *Scheduler::Take(unsigned Self) {
+  // The owner takes from the front, thieves from the back.
+  for (unsigned N = 0; N < Queues.size(); ++N) {
+    WorkQueue &Q = Queues[(Self + N) % Queues.size()];
+    Instance *I;
+    {
+      std::lock_guard<std::mutex> Guard(Q.Lock);
+      if (Q.Ready.empty()) continue;
+      if (N == 0) {
+        I = Q.Ready.front();
+        Q.Ready.pop_front();
+      } else {
+        I = Q.Ready.back();
+        Q.Ready.pop_back();
+      }
+    }
+    std::lock_guard<std::mutex> Guard(Lock);
+    --Queued;
+    return I;
+  }
+  return nullptr;
+}
+
+void Scheduler::Serve(unsigned Self) {
+  while (true) {
+    // A preempted instance is always queued again, so the queues of a
+    // scheduler running a loop that never ends are never empty.
+    {
+      std::lock_guard<std::mutex> Guard(Lock);
+      if (Stopping) return;
+    }
+    Instance *I = Take(Self);
+    if (I != nullptr) {
+      RunSlice(I, Self);
+      continue;
+    }
+    std::unique_lock<std::mutex> Guard(Lock);
+    Wake.wait(Guard, [this]() { return Queued > 0 || Stopping; });
+    if (Stopping) return;
+  }
+}
+
+void Scheduler::RunSlice(Instance *I, unsigned Self) {
+  {
+    std::lock_guard<std::mutex> Guard(I->Lock);
+    // A stolen instance stays with its thief.
+    I->Home = Self;
+    for (int Value : I->Pending) {
+      I->Run.Supply(Value);
+    }
+    I->Pending.clear();
+  }
+
+  std::ostringstream Out;
+  std::string Error;
+  auto Start = std::chrono::steady_clock::now();
+  try {
+    I->Run.Run(Out);
+  } catch (std::string &E) {
+    Error = E;
+  }
+  auto Nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now() - Start)
+                   .count();
+
+  bool Requeue = false;
+  {
+    std::lock_guard<std::mutex> Guard(I->Lock);
+    I->Output += Out.str();
+    I->Used.Steps = I->Limits.getSteps();
+    I->Used.Supplied = I->Run.getSupplied();
+    ++I->Used.Slices;
+    I->Used.Nanos += Nanos;
+    if (I->Run.isFinished()) {
+      I->State = finished;
+      I->Error = Error;
+    } else if (I->Run.getWaiting().empty() || !I->Pending.empty()) {
+      // Preempted, or given a value while it ran.
+      Requeue = true;
+    } else {
+      I->State = waiting;
+      I->Waiting = I->Run.getWaiting();
+    }
+  }
+  if (Requeue) {
+    Enqueue(I);
+    return;
+  }
+
+  if (OnPark) OnPark(I->Id);
+  std::lock_guard<std::mutex> Guard(Lock);
+  if (--Active == 0) Idle.notify_all();
+}
+
+Scheduler::Instance *Scheduler::get(unsigned Id) {
+  std::lock_guard<std::mutex> Guard(Lock);
+  assert(Id < Instances.size() && "No instance with this id.");
+  return Instances[Id];
+}
+
+Scheduler::Status Scheduler::getStatus(unsigned Id) {
+  Instance *I = get(Id);
+  std::lock_guard<std::mutex> Guard(I->Lock);
+  return I->State;
+}
+
+std::string Scheduler::getWaiting(unsigned Id) {
+  Instance *I = get(Id);
+  std::lock_guard<std::mutex> Guard(I->Lock);
+  return I->Waiting;
+}
+
+std::string Scheduler::TakeOutput(unsigned Id) {
+  Instance *I = get(Id);
+  std::lock_guard<std::mutex> Guard(I->Lock);
+  std::string Output;
+  Output.swap(I->Output);
+  return Output;
+}
+
+std::string Scheduler::getError(unsigned Id) {
+  Instance *I = get(Id);
+  std::lock_guard<std::mutex> Guard(I->Lock);
+  return I->Error;
+}
+
+Scheduler::Usage Scheduler::getUsage(unsigned Id) {
+  Instance *I = get(Id);
+  std::lock_guard<std::mutex> Guard(I->Lock);
+  return I->Used;
+}
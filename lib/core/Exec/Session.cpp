@@ -0,0 +1,39 @@
+//===--- Session.cpp ------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements runs that are given their input a value at a time.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/Exec/Session.h"
+#include "core/AST/AST.h"
+
+void Session::Supply(int Value) {
+  // Each value ends in a space, so that the stream can still tell its
+  // position after reading the last one (see `ASTContext::Save`).
+  Input << Value << ' ';
+  ++Supplied;
+}
+
+const std::string &Session::Run(std::ostream &Out) {
+  if (Finished) return Waiting;
+  try {
+    Finished = A.ExecuteUntilRead(Input, Out, Supplied, State, Started,
+                                  Waiting, DeferChecks, ShortCircuit, Limits);
+  } catch (...) {
+    Finished = true;
+    Waiting.clear();
+    throw;
+  }
+  Started = true;
+
+  // Drop the values read already, so that a session holds only the ones it
+  // was given ahead. The checkpoint then resumes at the start of the rest.
+  if (!Finished && State.InputOffset >= 0) {
+    Input.str(Input.str().substr(State.InputOffset));
+    Input.clear();
+    Input.seekp(0, std::ios::end);
+    State.InputOffset = 0;
+  }
+  return Waiting;
+}
@@ -0,0 +1,204 @@
+//===--- Tiers.cpp --------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements moving hot loops from the tree walker to bytecode.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/Exec/Tiers.h"
+#include "core/AST/AST.h"
+#include "core/AST/ASTContext.h"
+#include "core/VM/Compiler.h"
+#include "core/VM/Trace.h"
+#include "core/VM/VM.h"
+
+#include <cassert> // assert
+#include <chrono>  // std::chrono::steady_clock
+#include <iomanip> // std::setprecision
+#include <vector>  // std::vector
+
+/// Nanoseconds since `Start`.
+static unsigned long long
+elapsed(std::chrono::steady_clock::time_point Start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - Start)
+      .count();
+}
+
+void TierStats::Print(std::ostream &X) const {
+  unsigned long long Bytecode = BytecodeTime, Stall = StallTime;
+  unsigned long long Tree = TotalTime - Bytecode - Stall;
+  unsigned Loops = LoopsCompiled;
+  double Latency = Loops == 0 ? 0 : CompileLatency / 1e6 / Loops;
+  X << std::fixed << std::setprecision(3);
+  X << "Tree walker time:        " << Tree / 1e6 << " ms" << std::endl;
+  X << "Bytecode time:           " << Bytecode / 1e6 << " ms" << std::endl;
+  X << "Waiting for compiles:    " << Stall / 1e6 << " ms" << std::endl;
+  X << "Compile time:            " << CompileTime / 1e6 << " ms" << std::endl;
+  X << "Compile latency:         " << Latency << " ms per loop" << std::endl;
+  X << "Loops compiled:          " << Loops << std::endl;
+  X << "Moves into bytecode:     " << Transfers << std::endl;
+  X << "Loops traced:            " << LoopsTraced << std::endl;
+}
+
+Tiers::Tiers(const AST &A, unsigned Threshold, bool ShortCircuit,
+             bool Background)
+    : A(A), Threshold(Threshold), ShortCircuit(ShortCircuit) {
+  if (Background) {
+    Worker = std::thread(&Tiers::Work, this);
+  }
+}
+
+Tiers::~Tiers() {
+  if (Worker.joinable()) {
+    {
+      std::lock_guard<std::mutex> Guard(Lock);
+      Stopping = true;
+    }
+    Wake.notify_one();
+    Worker.join();
+  }
+  for (auto &Entry : Requests) {
+    delete Entry.second.Code;
+  }
+  for (const Program *P : Retired) {
+    delete P;
+  }
+}
+
+void Tiers::Execute(std::istream &In, std::ostream &Out, bool DeferChecks,
+                    Budget *Limits) {
+  auto Start = std::chrono::steady_clock::now();
+  try {
+    A.Execute(In, Out, DeferChecks, ShortCircuit, this, Limits);
+  } catch (...) {
+    Stats.TotalTime += elapsed(Start);
+    throw;
+  }
+  Stats.TotalTime += elapsed(Start);
+}
+
+void Tiers::Compile(const Loop *L) {
+  auto Start = std::chrono::steady_clock::now();
+  Compiler Comp(true, true, ShortCircuit);
+  A.CompileLoop(L, Comp);
+  const Program *P = Comp.Finish();
+  Stats.CompileTime += elapsed(Start);
+
+  std::lock_guard<std::mutex> Guard(Lock);
+  Request &R = Requests[L];
+  R.Code = P;
+  Stats.CompileLatency += elapsed(R.Time);
+  ++Stats.LoopsCompiled;
+}
+
+void Tiers::Work() {
+  std::unique_lock<std::mutex> Guard(Lock);
+  while (true) {
+    Wake.wait(Guard, [this]() { return Stopping || !Queue.empty(); });
+    if (Stopping) return;
+    const Loop *L = Queue.front();
+    Queue.pop_front();
+    Guard.unlock();
+    Compile(L);
+    Guard.lock();
+  }
+}
+
+bool Tiers::Enter(const Loop *L, ASTContext &C) {
+  const Program *P;
+  {
+    std::lock_guard<std::mutex> Guard(Lock);
+    auto It = Requests.find(L);
+    if (It == Requests.end() || It->second.Code == nullptr) return false;
+    P = It->second.Code;
+  }
+  Transfer(L, *P, C);
+  return true;
+}
+
+bool Tiers::Promote(const Loop *L, ASTContext &C) {
+  const Program *P;
+  {
+    std::unique_lock<std::mutex> Guard(Lock);
+    auto It = Requests.find(L);
+    if (It == Requests.end()) {
+      auto Start = std::chrono::steady_clock::now();
+      Requests[L].Time = Start;
+      if (Worker.joinable()) {
+        Queue.push_back(L);
+        Wake.notify_one();
+        return false;
+      }
+      // Without a background thread the run waits for the bytecode.
+      Guard.unlock();
+      Compile(L);
+      Stats.StallTime += elapsed(Start);
+      Guard.lock();
+      It = Requests.find(L);
+    }
+    P = It->second.Code;
+  }
+  if (P == nullptr) return false;
+  Transfer(L, *P, C);
+  return true;
+}
+
+void Tiers::Transfer(const Loop *L, const Program &P, ASTContext &C) {
+  auto Start = std::chrono::steady_clock::now();
+  ++Stats.Transfers;
+
+  std::vector<int> Vars(P.Names.size(), 0);
+  for (unsigned N = 0; N < Vars.size(); ++N) {
+    IdSym *Sym = C.Lookup(P.Names[N]);
+    if (Sym->Initialized) Vars[N] = Sym->Value;
+  }
+
+  // Only one run records the path of a loop.
+  unsigned Head, BackEdge;
+  bool Record = false;
+  if (Tracing && Trace::FindLoop(P, Head, BackEdge)) {
+    std::lock_guard<std::mutex> Guard(Lock);
+    Request &R = Requests[L];
+    Record = !R.Traced;
+    R.Traced = true;
+  }
+
+  try {
+    VM Machine(P, C.getIn(), C.getOut());
+    Machine.setBudget(C.getBudget());
+    std::vector<unsigned> Path;
+    if (Record) {
+      Machine.setTrace(Head, &Path);
+    }
+    Machine.Execute(Vars);
+
+    // The run stopped at the back-edge, where the loop can be entered anew.
+    const Program *Traced = nullptr;
+    if (Machine.isStopped()) {
+      Traced = Trace::Build(P, Path);
+      assert(Traced != nullptr && "A whole iteration was recorded.");
+      std::lock_guard<std::mutex> Guard(Lock);
+      Requests[L].Code = Traced;
+      Retired.push_back(&P);
+      ++Stats.LoopsTraced;
+    }
+    if (Traced != nullptr) {
+      VM Fast(*Traced, C.getIn(), C.getOut());
+      Fast.setBudget(C.getBudget());
+      Fast.Execute(Vars);
+    }
+  } catch (...) {
+    Stats.BytecodeTime += elapsed(Start);
+    throw;
+  }
+
+  // The parser proved that every variable is written before it is read, so
+  // marking the ones the loop did not write as initialized changes nothing.
+  for (unsigned N = 0; N < Vars.size(); ++N) {
+    IdSym *Sym = C.Lookup(P.Names[N]);
+    Sym->Value = Vars[N];
+    Sym->Initialized = true;
+  }
+  Stats.BytecodeTime += elapsed(Start);
+}
@@ -0,0 +1,149 @@
+//===--- Builder.cpp ------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements building SSA form while lowering the AST.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/IR/Builder.h"
+
+#include <cassert> // assert
+
+IRBuilder::IRBuilder(Function &F, bool ShortCircuit)
+    : F(F), ShortCircuit(ShortCircuit) {
+  CreateBlock();
+  // Nothing jumps to the entry block.
+  Seal(0);
+}
+
+void IRBuilder::Declare(const std::string &Name) {
+  Vars[Name] = F.Names.size();
+  F.Names.push_back(Name);
+}
+
+void IRBuilder::Write(const std::string &Name, unsigned V) {
+  assert(Vars.count(Name) != 0 && "Undeclared variable.");
+  Defs[Current][Vars[Name]] = V;
+}
+
+unsigned IRBuilder::Read(const std::string &Name) {
+  assert(Vars.count(Name) != 0 && "Undeclared variable.");
+  return Read(Vars[Name], Current);
+}
+
+unsigned IRBuilder::Read(unsigned Var, unsigned B) {
+  auto It = Defs[B].find(Var);
+  if (It != Defs[B].end()) return It->second;
+
+  unsigned V;
+  const std::vector<unsigned> &Preds = F.Blocks[B].Preds;
+  if (!Sealed[B]) {
+    V = AddPhi(Var, B);
+    Incomplete[B].push_back(std::make_pair(Var, V));
+  } else if (Preds.empty()) {
+    // The parser proved every variable is assigned before it is read, so only
+    // paths that do not read it get here. Registers start out as zero.
+    V = Constant(0);
+  } else if (Preds.size() == 1) {
+    V = Read(Var, Preds[0]);
+  } else {
+    // Recorded first so that a loop back to this block finds the phi.
+    V = AddPhi(Var, B);
+    Defs[B][Var] = V;
+    AddPhiOperands(Var, V);
+  }
+  Defs[B][Var] = V;
+  return V;
+}
+
+unsigned IRBuilder::AddPhi(unsigned Var, unsigned B) {
+  Inst I;
+  I.Op = IROp::phi;
+  I.Var = Var;
+  I.Block = B;
+  F.Insts.push_back(I);
+  unsigned V = F.Insts.size() - 1;
+  F.Blocks[B].Insts.insert(F.Blocks[B].Insts.begin(), V);
+  return V;
+}
+
+void IRBuilder::AddPhiOperands(unsigned Var, unsigned Phi) {
+  std::vector<unsigned> Preds = F.Blocks[F.Insts[Phi].Block].Preds;
+  for (unsigned P : Preds) {
+    // Reading may add instructions, so `F.Insts` is indexed afterwards.
+    unsigned V = Read(Var, P);
+    F.Insts[Phi].Ops.push_back(V);
+  }
+}
+
+unsigned IRBuilder::CreateBlock() {
+  Defs.emplace_back();
+  Sealed.push_back(false);
+  Incomplete.emplace_back();
+  return F.addBlock();
+}
+
+void IRBuilder::Seal(unsigned B) {
+  for (auto &Entry : Incomplete[B]) {
+    AddPhiOperands(Entry.first, Entry.second);
+  }
+  Incomplete[B].clear();
+  Sealed[B] = true;
+}
+
+unsigned IRBuilder::Constant(int C) { return F.getConstant(C); }
+
+unsigned IRBuilder::Emit(IROp::IROp Op, const std::vector<unsigned> &Ops) {
+  Inst I;
+  I.Op = Op;
+  I.Ops = Ops;
+  return F.append(Current, I);
+}
+
+unsigned IRBuilder::Emit(Token T, IROp::IROp Op,
+                         const std::vector<unsigned> &Ops, bool Checked) {
+  Inst I;
+  I.Op = Op;
+  I.Ops = Ops;
+  I.Checked = Checked;
+  I.Loc = F.Tokens.size();
+  F.Tokens.push_back(T);
+  return F.append(Current, I);
+}
+
+unsigned IRBuilder::Emit(IROp::IROp Op, const std::string &Name,
+                         const std::vector<unsigned> &Ops) {
+  Inst I;
+  I.Op = Op;
+  I.Ops = Ops;
+  I.Var = Vars[Name];
+  return F.append(Current, I);
+}
+
+void IRBuilder::Terminate(Inst I, const std::vector<unsigned> &Succs) {
+  F.append(Current, I);
+  for (unsigned S : Succs) {
+    assert(!Sealed[S] && "A sealed block can not get more predecessors.");
+    F.Blocks[Current].Succs.push_back(S);
+    F.Blocks[S].Preds.push_back(Current);
+  }
+}
+
+void IRBuilder::Jump(unsigned B) {
+  Inst I;
+  I.Op = IROp::jump;
+  Terminate(I, {B});
+}
+
+void IRBuilder::Branch(unsigned Cond, unsigned True, unsigned False) {
+  Inst I;
+  I.Op = IROp::branch;
+  I.Ops.push_back(Cond);
+  Terminate(I, {True, False});
+}
+
+void IRBuilder::Return() {
+  Inst I;
+  I.Op = IROp::ret;
+  Terminate(I, {});
+}
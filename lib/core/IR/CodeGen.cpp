@@ -0,0 +1,309 @@
+//===--- CodeGen.cpp ------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements generating bytecode from SSA form.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/IR/CodeGen.h"
+#include "core/IR/IR.h"
+
+#include <algorithm> // std::find, std::max
+#include <cassert>   // assert
+#include <utility>   // std::pair
+#include <vector>    // std::vector
+
+namespace {
+
+/// Generates the program for a single function.
+class Generator {
+  /// A copy of the function, whose edges are split.
+  Function F;
+
+  /// Whether superinstructions are selected.
+  bool Fuse;
+
+  /// The program under construction.
+  Program *P;
+
+  /// The number of uses of every value.
+  std::vector<unsigned> Uses;
+
+  /// The first instruction of each block.
+  std::vector<unsigned> Start;
+
+  /// Jumps (by instruction index) waiting for the start of a block.
+  std::vector<std::pair<unsigned, unsigned>> Fixups;
+
+  /// Temporaries for copies into phis that read each other.
+  unsigned TempBase = 0;
+  unsigned NumTemps = 0;
+
+  /// Returns the register holding value `V`.
+  unsigned Reg(unsigned V) const { return F.Names.size() + V; }
+
+  bool hasPhis(unsigned B) const {
+    const std::vector<unsigned> &Insts = F.Blocks[B].Insts;
+    return !Insts.empty() && F.Insts[Insts[0]].Op == IROp::phi;
+  }
+
+  void Emit(OpCode::OpCode Op, unsigned A = 0, unsigned B = 0,
+            unsigned C = 0) {
+    P->Code.push_back(Instr{Op, A, B, C, 0});
+  }
+
+  /// Emits an instruction that reports diagnostics at the token of `I`.
+  void Emit(const Inst &I, OpCode::OpCode Op, unsigned A, unsigned B,
+            unsigned C) {
+    P->Tokens.push_back(F.Tokens[I.Loc]);
+    P->Code.push_back(Instr{Op, A, B, C, (unsigned)P->Tokens.size() - 1});
+  }
+
+  /// Emits `Op` jumping to block `Target` once it is placed.
+  void EmitJump(OpCode::OpCode Op, unsigned A, unsigned B, unsigned Target) {
+    Fixups.push_back(std::make_pair(P->Code.size(), Target));
+    Emit(Op, A, B);
+  }
+
+  /// Gives every edge from a block that branches to a block with phis a block
+  /// of its own, so that the copies into the phis only run on that edge.
+  void SplitEdges();
+
+  void EmitBlock(unsigned B, unsigned Next);
+  void EmitInst(unsigned V);
+  void EmitArith(unsigned V);
+  void EmitPhiCopies(unsigned Pred, unsigned B);
+
+public:
+  Generator(const Function &F, bool Fuse)
+      : F(F), Fuse(Fuse), P(new Program) {}
+
+  Program *Generate();
+};
+
+} // end anonymous namespace
+
+/// Returns the opcode for the comparison or logic `Op`.
+static OpCode::OpCode getOpCode(IROp::IROp Op) {
+  switch (Op) {
+  case IROp::cmp_not_equal: return OpCode::cmp_not_equal;
+  case IROp::cmp_equal: return OpCode::cmp_equal;
+  case IROp::cmp_greater_than_equal: return OpCode::cmp_greater_than_equal;
+  case IROp::cmp_less_than_equal: return OpCode::cmp_less_than_equal;
+  case IROp::cmp_greater_than: return OpCode::cmp_greater_than;
+  case IROp::cmp_less_than: return OpCode::cmp_less_than;
+  case IROp::logic_and: return OpCode::logic_and;
+  case IROp::logic_or: return OpCode::logic_or;
+  case IROp::logic_not: return OpCode::logic_not;
+  default: break;
+  }
+  assert(false && "Not a comparison or logic.");
+  return OpCode::halt;
+}
+
+/// Returns the jump taken unless the comparison `Op` holds.
+static OpCode::OpCode getJumpUnless(IROp::IROp Op) {
+  switch (Op) {
+  case IROp::cmp_not_equal: return OpCode::jump_unless_ne;
+  case IROp::cmp_equal: return OpCode::jump_unless_eq;
+  case IROp::cmp_greater_than_equal: return OpCode::jump_unless_ge;
+  case IROp::cmp_less_than_equal: return OpCode::jump_unless_le;
+  case IROp::cmp_greater_than: return OpCode::jump_unless_gt;
+  case IROp::cmp_less_than: return OpCode::jump_unless_lt;
+  default: break;
+  }
+  assert(false && "Not a comparison.");
+  return OpCode::halt;
+}
+
+void Generator::SplitEdges() {
+  unsigned NumBlocks = F.Blocks.size();
+  for (unsigned B = 0; B < NumBlocks; ++B) {
+    if (F.Blocks[B].Erased || F.Blocks[B].Succs.size() < 2) continue;
+    for (unsigned K = 0; K < F.Blocks[B].Succs.size(); ++K) {
+      unsigned S = F.Blocks[B].Succs[K];
+      if (!hasPhis(S)) continue;
+
+      unsigned E = F.addBlock();
+      Inst J;
+      J.Op = IROp::jump;
+      F.append(E, J);
+      F.Blocks[E].Preds.push_back(B);
+      F.Blocks[E].Succs.push_back(S);
+      F.Blocks[B].Succs[K] = E;
+
+      // The phi operands stay in place, as the edge keeps its position.
+      std::vector<unsigned> &Preds = F.Blocks[S].Preds;
+      *std::find(Preds.begin(), Preds.end(), B) = E;
+    }
+  }
+}
+
+Program *Generator::Generate() {
+  SplitEdges();
+  P->Names = F.Names;
+  TempBase = Reg(F.Insts.size());
+  Uses = F.countUses();
+  Start.assign(F.Blocks.size(), 0);
+
+  std::vector<unsigned> Order;
+  for (unsigned B = 0; B < F.Blocks.size(); ++B) {
+    if (!F.Blocks[B].Erased) Order.push_back(B);
+  }
+  for (unsigned K = 0; K < Order.size(); ++K) {
+    Start[Order[K]] = P->Code.size();
+    EmitBlock(Order[K], K + 1 < Order.size() ? Order[K + 1] : ~0u);
+  }
+
+  for (auto &Fixup : Fixups) {
+    Instr &I = P->Code[Fixup.first];
+    const OpInfo &Info = getOpInfo(I.Op);
+    unsigned *Operands[3] = {&I.A, &I.B, &I.C};
+    for (unsigned N = 0; N < 3; ++N) {
+      if (Info.Operands[N] == OperandKind::target) {
+        *Operands[N] = Start[Fixup.second];
+      }
+    }
+  }
+
+  for (unsigned V = 0; V < F.Insts.size(); ++V) {
+    if (!F.Insts[V].Erased && F.Insts[V].Op == IROp::constant) {
+      P->Constants.push_back(std::make_pair(Reg(V), F.Insts[V].Imm));
+    }
+  }
+  P->NumRegs = TempBase + NumTemps;
+  return P;
+}
+
+void Generator::EmitBlock(unsigned B, unsigned Next) {
+  const Block &Blk = F.Blocks[B];
+  const Inst &T = F.Insts[Blk.Insts.back()];
+
+  // A comparison only used by the branch after it becomes part of the jump.
+  unsigned Fused = ~0u;
+  if (Fuse && T.Op == IROp::branch) {
+    const Inst &Cond = F.Insts[T.Ops[0]];
+    if (Cond.Block == B && Cond.Op >= IROp::cmp_not_equal &&
+        Cond.Op <= IROp::cmp_less_than && Uses[T.Ops[0]] == 1) {
+      Fused = T.Ops[0];
+    }
+  }
+  for (unsigned K = 0; K + 1 < Blk.Insts.size(); ++K) {
+    if (Blk.Insts[K] != Fused) EmitInst(Blk.Insts[K]);
+  }
+
+  switch (T.Op) {
+  case IROp::ret: Emit(OpCode::halt); return;
+  case IROp::jump:
+    EmitPhiCopies(B, Blk.Succs[0]);
+    if (Blk.Succs[0] != Next) EmitJump(OpCode::jump, 0, 0, Blk.Succs[0]);
+    return;
+  case IROp::branch: break;
+  default: assert(false && "A block must end with a terminator."); return;
+  }
+
+  // Edges were split, so the successors have no phis.
+  unsigned True = Blk.Succs[0], False = Blk.Succs[1];
+  if (Fused != ~0u) {
+    const Inst &Cond = F.Insts[Fused];
+    Fixups.push_back(std::make_pair(P->Code.size(), False));
+    Emit(getJumpUnless(Cond.Op), Reg(Cond.Ops[0]), Reg(Cond.Ops[1]));
+  } else if (False == Next) {
+    EmitJump(OpCode::jump_if_true, Reg(T.Ops[0]), 0, True);
+    return;
+  } else {
+    EmitJump(OpCode::jump_if_false, Reg(T.Ops[0]), 0, False);
+  }
+  if (True != Next) EmitJump(OpCode::jump, 0, 0, True);
+}
+
+void Generator::EmitInst(unsigned V) {
+  const Inst &I = F.Insts[V];
+  switch (I.Op) {
+  case IROp::constant:
+  case IROp::phi:
+    // Constants are loaded before execution; phis are written by the
+    // predecessors.
+    return;
+  case IROp::copy: Emit(OpCode::move, Reg(V), Reg(I.Ops[0])); return;
+  case IROp::add:
+  case IROp::sub:
+  case IROp::mul: EmitArith(V); return;
+  case IROp::logic_not: Emit(OpCode::logic_not, Reg(V), Reg(I.Ops[0])); return;
+  case IROp::read:
+    Emit(OpCode::read, I.Var);
+    Emit(OpCode::move, Reg(V), I.Var);
+    return;
+  case IROp::write:
+    Emit(OpCode::move, I.Var, Reg(I.Ops[0]));
+    Emit(OpCode::write, I.Var);
+    return;
+  default:
+    Emit(getOpCode(I.Op), Reg(V), Reg(I.Ops[0]), Reg(I.Ops[1]));
+    return;
+  }
+}
+
+void Generator::EmitArith(unsigned V) {
+  const Inst &I = F.Insts[V];
+  if (!I.Checked) {
+    OpCode::OpCode Op = I.Op == IROp::add   ? OpCode::add_unchecked
+                        : I.Op == IROp::sub ? OpCode::sub_unchecked
+                                            : OpCode::mul_unchecked;
+    Emit(Op, Reg(V), Reg(I.Ops[0]), Reg(I.Ops[1]));
+    return;
+  }
+
+  int C;
+  if (Fuse && I.Op != IROp::mul && F.isConstant(I.Ops[1], C)) {
+    Emit(I, I.Op == IROp::add ? OpCode::add_imm : OpCode::sub_imm, Reg(V),
+         Reg(I.Ops[0]), C);
+  } else if (Fuse && I.Op == IROp::add && F.isConstant(I.Ops[0], C)) {
+    Emit(I, OpCode::add_imm, Reg(V), Reg(I.Ops[1]), C);
+  } else {
+    OpCode::OpCode Op = I.Op == IROp::add   ? OpCode::add
+                        : I.Op == IROp::sub ? OpCode::sub
+                                            : OpCode::mul;
+    Emit(I, Op, Reg(V), Reg(I.Ops[0]), Reg(I.Ops[1]));
+  }
+}
+
+void Generator::EmitPhiCopies(unsigned Pred, unsigned B) {
+  const Block &Blk = F.Blocks[B];
+  unsigned N =
+      std::find(Blk.Preds.begin(), Blk.Preds.end(), Pred) - Blk.Preds.begin();
+
+  std::vector<std::pair<unsigned, unsigned>> Copies;
+  for (unsigned V : Blk.Insts) {
+    if (F.Insts[V].Op != IROp::phi) break;
+    if (Reg(V) != Reg(F.Insts[V].Ops[N])) {
+      Copies.push_back(std::make_pair(Reg(V), Reg(F.Insts[V].Ops[N])));
+    }
+  }
+
+  // The copies happen at once, so a phi reading another phi of the block
+  // reads its old value.
+  bool Overlap = false;
+  for (auto &To : Copies) {
+    for (auto &From : Copies) {
+      Overlap |= To.first == From.second;
+    }
+  }
+  if (!Overlap) {
+    for (auto &Copy : Copies) {
+      Emit(OpCode::move, Copy.first, Copy.second);
+    }
+    return;
+  }
+  NumTemps = std::max<unsigned>(NumTemps, Copies.size());
+  for (unsigned K = 0; K < Copies.size(); ++K) {
+    Emit(OpCode::move, TempBase + K, Copies[K].second);
+  }
+  for (unsigned K = 0; K < Copies.size(); ++K) {
+    Emit(OpCode::move, Copies[K].first, TempBase + K);
+  }
+}
+
+Program *CodeGen::Generate(const Function &F, bool Fuse) {
+  return Generator(F, Fuse).Generate();
+}
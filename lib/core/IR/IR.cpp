@@ -0,0 +1,232 @@
+//===--- IR.cpp -----------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements editing and printing of functions in SSA form.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/IR/IR.h"
+
+#include <algorithm> // std::find, std::reverse
+#include <cassert>   // assert
+#include <iostream>  // std::endl
+#include <utility>   // std::pair
+
+/// The name each opcode is printed with. This table is indexed by `IROp` and
+/// must follow its order.
+static const char *getName(IROp::IROp Op) {
+  static const char *Names[] = {
+      "constant", "copy", "add", "sub", "mul",   "ne",   "eq",
+      "ge",       "le",   "gt",  "lt",  "and",   "or",   "not",
+      "phi",      "read", "write", "jump", "branch", "ret",
+  };
+  assert(Op < sizeof(Names) / sizeof(Names[0]) && "Unknown opcode.");
+  return Names[Op];
+}
+
+bool Function::hasEffects(unsigned V) const {
+  const Inst &I = Insts[V];
+  switch (I.Op) {
+  case IROp::add:
+  case IROp::sub:
+  case IROp::mul: return I.Checked;
+  case IROp::read:
+  case IROp::write:
+  case IROp::jump:
+  case IROp::branch:
+  case IROp::ret: return true;
+  default: return false;
+  }
+}
+
+bool Function::isConstant(unsigned V, int &C) const {
+  if (Insts[V].Op != IROp::constant) return false;
+  C = Insts[V].Imm;
+  return true;
+}
+
+unsigned Function::getConstant(int C) {
+  for (unsigned V : Blocks[0].Insts) {
+    if (Insts[V].Op == IROp::constant && Insts[V].Imm == C) return V;
+  }
+
+  // Constants do not depend on anything, so they can go first.
+  Inst I;
+  I.Op = IROp::constant;
+  I.Imm = C;
+  Insts.push_back(I);
+  unsigned V = Insts.size() - 1;
+  Blocks[0].Insts.insert(Blocks[0].Insts.begin(), V);
+  return V;
+}
+
+unsigned Function::addBlock() {
+  Blocks.push_back(Block());
+  return Blocks.size() - 1;
+}
+
+unsigned Function::append(unsigned B, Inst I) {
+  I.Block = B;
+  Insts.push_back(I);
+  Blocks[B].Insts.push_back(Insts.size() - 1);
+  return Insts.size() - 1;
+}
+
+unsigned Function::insert(unsigned B, unsigned Pos, Inst I) {
+  I.Block = B;
+  Insts.push_back(I);
+  Blocks[B].Insts.insert(Blocks[B].Insts.begin() + Pos, Insts.size() - 1);
+  return Insts.size() - 1;
+}
+
+void Function::replaceAllUses(unsigned From, unsigned To) {
+  for (Inst &I : Insts) {
+    if (I.Erased) continue;
+    for (unsigned &Op : I.Ops) {
+      if (Op == From) Op = To;
+    }
+  }
+}
+
+void Function::erase(unsigned V) {
+  Inst &I = Insts[V];
+  if (I.Erased) return;
+  I.Erased = true;
+  std::vector<unsigned> &List = Blocks[I.Block].Insts;
+  List.erase(std::find(List.begin(), List.end(), V));
+}
+
+void Function::removeEdge(unsigned From, unsigned To) {
+  std::vector<unsigned> &Succs = Blocks[From].Succs;
+  Succs.erase(std::find(Succs.begin(), Succs.end(), To));
+
+  std::vector<unsigned> &Preds = Blocks[To].Preds;
+  auto It = std::find(Preds.begin(), Preds.end(), From);
+  unsigned N = It - Preds.begin();
+  Preds.erase(It);
+  for (unsigned V : Blocks[To].Insts) {
+    if (Insts[V].Op != IROp::phi) break;
+    Insts[V].Ops.erase(Insts[V].Ops.begin() + N);
+  }
+}
+
+std::vector<unsigned> Function::countUses() const {
+  std::vector<unsigned> Uses(Insts.size(), 0);
+  for (const Inst &I : Insts) {
+    if (I.Erased) continue;
+    for (unsigned Op : I.Ops) {
+      ++Uses[Op];
+    }
+  }
+  return Uses;
+}
+
+std::vector<unsigned> Function::getReversePostorder() const {
+  std::vector<unsigned> Order;
+  std::vector<bool> Visited(Blocks.size(), false);
+
+  // Each entry is a block and the number of its successors visited.
+  std::vector<std::pair<unsigned, unsigned>> Stack;
+  Stack.push_back(std::make_pair(0, 0));
+  Visited[0] = true;
+  while (!Stack.empty()) {
+    unsigned B = Stack.back().first;
+    unsigned N = Stack.back().second++;
+    if (N == Blocks[B].Succs.size()) {
+      Order.push_back(B);
+      Stack.pop_back();
+      continue;
+    }
+    unsigned S = Blocks[B].Succs[N];
+    if (!Visited[S]) {
+      Visited[S] = true;
+      Stack.push_back(std::make_pair(S, 0));
+    }
+  }
+  std::reverse(Order.begin(), Order.end());
+  return Order;
+}
+
+std::vector<unsigned> Function::getDominators() const {
+  // See Cooper et al., "A Simple, Fast Dominance Algorithm".
+  std::vector<unsigned> Order = getReversePostorder();
+  std::vector<unsigned> Number(Blocks.size(), 0);
+  for (unsigned N = 0; N < Order.size(); ++N) {
+    Number[Order[N]] = N;
+  }
+
+  std::vector<unsigned> Idom(Blocks.size(), ~0u);
+  Idom[0] = 0;
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    for (unsigned N = 1; N < Order.size(); ++N) {
+      unsigned B = Order[N];
+      unsigned New = ~0u;
+      for (unsigned P : Blocks[B].Preds) {
+        if (Idom[P] == ~0u) continue;
+        if (New == ~0u) {
+          New = P;
+          continue;
+        }
+        // Walks both up the tree until they meet.
+        unsigned X = P;
+        while (X != New) {
+          while (Number[X] > Number[New]) X = Idom[X];
+          while (Number[New] > Number[X]) New = Idom[New];
+        }
+      }
+      if (Idom[B] != New) {
+        Idom[B] = New;
+        Changed = true;
+      }
+    }
+  }
+  return Idom;
+}
+
+void Function::Print(std::ostringstream &X) const {
+  for (unsigned B = 0; B < Blocks.size(); ++B) {
+    const Block &Blk = Blocks[B];
+    if (Blk.Erased) continue;
+    X << "bb" << B << ":";
+    if (!Blk.Preds.empty()) {
+      X << " ; preds";
+      for (unsigned P : Blk.Preds) {
+        X << " bb" << P;
+      }
+    }
+    X << std::endl;
+
+    for (unsigned V : Blk.Insts) {
+      const Inst &I = Insts[V];
+      X << "  ";
+      if (I.Op != IROp::write && I.Op < IROp::jump) {
+        X << "%" << V << " = ";
+      }
+      X << getName(I.Op);
+      if (I.Op == IROp::constant) {
+        X << " " << I.Imm;
+      }
+      if ((I.Op == IROp::copy || I.Op == IROp::phi || I.Op == IROp::read ||
+           I.Op == IROp::write) &&
+          I.Var < Names.size()) {
+        X << " " << Names[I.Var];
+      }
+      if ((I.Op == IROp::add || I.Op == IROp::sub || I.Op == IROp::mul) &&
+          !I.Checked) {
+        X << " unchecked";
+      }
+      for (unsigned N = 0; N < I.Ops.size(); ++N) {
+        X << (N == 0 ? " " : ", ") << "%" << I.Ops[N];
+        if (I.Op == IROp::phi) {
+          X << " bb" << Blk.Preds[N];
+        }
+      }
+      for (unsigned N = 0; N < Blk.Succs.size() && I.Op >= IROp::jump; ++N) {
+        X << (N == 0 && I.Ops.empty() ? " " : ", ") << "bb" << Blk.Succs[N];
+      }
+      X << std::endl;
+    }
+  }
+}
@@ -0,0 +1,99 @@
+//===--- PassManager.cpp --------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements running and timing the optimization passes.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/IR/PassManager.h"
+#include "core/IR/Passes.h"
+
+#include <chrono>  // std::chrono
+#include <iomanip> // std::setprecision, std::setw
+
+PassManager::PassManager() {
+  add("copy-prop", Passes::PropagateCopies);
+  add("fold", Passes::Fold);
+  add("cse", Passes::EliminateCommon);
+  add("strength-reduce", Passes::ReduceStrength);
+  add("dce", Passes::EliminateDead);
+}
+
+void PassManager::add(const std::string &Name, Pass P) {
+  Entry E;
+  E.Name = Name;
+  E.Run = P;
+  Passes.push_back(E);
+}
+
+bool PassManager::setOrder(const std::vector<std::string> &Order) {
+  std::vector<Entry> Ordered;
+  for (const std::string &Name : Order) {
+    bool Found = false;
+    for (const Entry &E : Passes) {
+      if (E.Name == Name) {
+        Ordered.push_back(E);
+        Ordered.back().Enabled = true;
+        Found = true;
+        break;
+      }
+    }
+    if (!Found) return false;
+  }
+
+  // The others are kept so that their names stay known.
+  for (const Entry &E : Passes) {
+    bool Listed = false;
+    for (const std::string &Name : Order) {
+      Listed |= E.Name == Name;
+    }
+    if (!Listed) {
+      Ordered.push_back(E);
+      Ordered.back().Enabled = false;
+    }
+  }
+  Passes = Ordered;
+  return true;
+}
+
+bool PassManager::disable(const std::string &Name) {
+  for (Entry &E : Passes) {
+    if (E.Name == Name) {
+      E.Enabled = false;
+      return true;
+    }
+  }
+  return false;
+}
+
+void PassManager::Run(Function &F) {
+  typedef std::chrono::steady_clock Clock;
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    ++Rounds;
+    for (Entry &E : Passes) {
+      if (!E.Enabled) continue;
+      Clock::time_point Start = Clock::now();
+      bool Result = E.Run(F);
+      E.Time += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    Clock::now() - Start)
+                    .count();
+      if (Result) {
+        ++E.Changes;
+        Changed = true;
+      }
+    }
+  }
+}
+
+void PassManager::PrintTimings(std::ostream &X) const {
+  X << std::fixed << std::setprecision(3);
+  for (const Entry &E : Passes) {
+    if (!E.Enabled) continue;
+    std::string Label = "Pass " + E.Name + ":";
+    X << std::left << std::setw(25) << Label << std::right << E.Time / 1e6
+      << " ms, changed " << E.Changes << " times" << std::endl;
+  }
+  X << "Pass rounds:             " << Rounds << std::endl;
+}
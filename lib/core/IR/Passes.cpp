@@ -0,0 +1,438 @@
+//===--- Passes.cpp -------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements the optimization passes over SSA form.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/IR/Passes.h"
+#include "core/AST/Arithmetic.h"
+#include "core/IR/IR.h"
+
+#include <map>     // std::map
+#include <utility> // std::pair, std::swap
+#include <vector>  // std::vector
+
+//===----------------------------------------------------------------------===//
+// Passes: helper functions
+//===----------------------------------------------------------------------===//
+
+/// Whether `Op` computes a value from its operands alone.
+static bool isPure(IROp::IROp Op) {
+  return Op >= IROp::add && Op <= IROp::logic_not;
+}
+
+/// Whether `Op` gives the same value, and fails exactly when, its operands are
+/// swapped. This does not hold for `mul`, see `Arith::Multiply`.
+static bool isCommutative(IROp::IROp Op) {
+  return Op == IROp::add || Op == IROp::cmp_not_equal ||
+         Op == IROp::cmp_equal || Op == IROp::logic_and ||
+         Op == IROp::logic_or;
+}
+
+/// Evaluates the comparison or logic `Op` on constants.
+static int evaluate(IROp::IROp Op, int L, int R) {
+  switch (Op) {
+  case IROp::cmp_not_equal: return L != R;
+  case IROp::cmp_equal: return L == R;
+  case IROp::cmp_greater_than_equal: return L >= R;
+  case IROp::cmp_less_than_equal: return L <= R;
+  case IROp::cmp_greater_than: return L > R;
+  case IROp::cmp_less_than: return L < R;
+  case IROp::logic_and: return L && R;
+  case IROp::logic_or: return L || R;
+  case IROp::logic_not: return !L;
+  default: break;
+  }
+  assert(false && "Not a comparison or logic.");
+  return 0;
+}
+
+/// Finds the value instruction `V` always has.
+/// \return false if it is not known.
+static bool simplify(Function &F, unsigned V, unsigned &Result) {
+  // `F.Insts` grows as constants are added.
+  Inst I = F.Insts[V];
+  if (!isPure(I.Op)) return false;
+
+  int L = 0, R = 0;
+  bool HasL = F.isConstant(I.Ops[0], L);
+  bool HasR = I.Ops.size() > 1 && F.isConstant(I.Ops[1], R);
+  if (I.Op == IROp::add || I.Op == IROp::sub || I.Op == IROp::mul) {
+    if (HasL && HasR) {
+      int Out;
+      ArithResult::ArithResult Fails =
+          I.Op == IROp::add   ? Arith::Add(L, R, Out)
+          : I.Op == IROp::sub ? Arith::Subtract(L, R, Out)
+                              : Arith::Multiply(L, R, Out);
+      // An operation that would fail is kept for its diagnostic.
+      if (Fails != ArithResult::ok) return false;
+      Result = F.getConstant(Out);
+      return true;
+    }
+    // `X * 0` always succeeds, unlike `0 * X` (see `Arith::Multiply`).
+    if (I.Op == IROp::mul && HasR && R == 0) {
+      Result = F.getConstant(0);
+      return true;
+    }
+    if ((I.Op == IROp::mul && HasR && R == 1) ||
+        (I.Op != IROp::mul && HasR && R == 0)) {
+      Result = I.Ops[0];
+      return true;
+    }
+    if (I.Op == IROp::add && HasL && L == 0) {
+      Result = I.Ops[1];
+      return true;
+    }
+    return false;
+  }
+
+  if (I.Op == IROp::logic_not) {
+    if (!HasL) return false;
+    Result = F.getConstant(evaluate(I.Op, L, 0));
+    return true;
+  }
+  if (HasL && HasR) {
+    Result = F.getConstant(evaluate(I.Op, L, R));
+    return true;
+  }
+  // A value compared with itself.
+  if (I.Op >= IROp::cmp_not_equal && I.Op <= IROp::cmp_less_than &&
+      I.Ops[0] == I.Ops[1]) {
+    Result = F.getConstant(evaluate(I.Op, 0, 0));
+    return true;
+  }
+  return false;
+}
+
+//===----------------------------------------------------------------------===//
+// Passes: folding
+//===----------------------------------------------------------------------===//
+
+bool Passes::Fold(Function &F) {
+  bool Changed = false;
+  for (unsigned B = 0; B < F.Blocks.size(); ++B) {
+    if (F.Blocks[B].Erased) continue;
+
+    // Instructions are erased from the block while it is visited.
+    std::vector<unsigned> List = F.Blocks[B].Insts;
+    for (unsigned V : List) {
+      unsigned Result;
+      if (F.Insts[V].Erased || !simplify(F, V, Result)) continue;
+      F.replaceAllUses(V, Result);
+      F.erase(V);
+      Changed = true;
+    }
+
+    unsigned T = F.Blocks[B].Insts.back();
+    int Cond;
+    if (F.Insts[T].Op != IROp::branch || !F.isConstant(F.Insts[T].Ops[0], Cond))
+      continue;
+    F.removeEdge(B, F.Blocks[B].Succs[Cond ? 1 : 0]);
+    F.Insts[T].Op = IROp::jump;
+    F.Insts[T].Ops.clear();
+    Changed = true;
+  }
+  return Changed;
+}
+
+//===----------------------------------------------------------------------===//
+// Passes: copy propagation
+//===----------------------------------------------------------------------===//
+
+bool Passes::PropagateCopies(Function &F) {
+  bool Changed = false;
+  for (unsigned V = 0; V < F.Insts.size(); ++V) {
+    if (F.Insts[V].Erased || F.Insts[V].Op != IROp::copy) continue;
+    F.replaceAllUses(V, F.Insts[V].Ops[0]);
+    F.erase(V);
+    Changed = true;
+  }
+
+  // Removing a phi may make the phis using it trivial.
+  bool Again = true;
+  while (Again) {
+    Again = false;
+    for (unsigned V = 0; V < F.Insts.size(); ++V) {
+      const Inst &I = F.Insts[V];
+      if (I.Erased || I.Op != IROp::phi) continue;
+
+      unsigned Same = ~0u;
+      bool Trivial = true;
+      for (unsigned Op : I.Ops) {
+        if (Op == V || Op == Same) continue;
+        if (Same != ~0u) {
+          Trivial = false;
+          break;
+        }
+        Same = Op;
+      }
+      // A phi without other operands is in a block that can not be reached.
+      if (!Trivial || Same == ~0u) continue;
+      F.replaceAllUses(V, Same);
+      F.erase(V);
+      Again = Changed = true;
+    }
+  }
+  return Changed;
+}
+
+//===----------------------------------------------------------------------===//
+// Passes: common subexpression elimination
+//===----------------------------------------------------------------------===//
+
+bool Passes::EliminateCommon(Function &F) {
+  std::vector<unsigned> Idom = F.getDominators();
+  std::vector<std::vector<unsigned>> Children(F.Blocks.size());
+  for (unsigned B = 1; B < F.Blocks.size(); ++B) {
+    if (Idom[B] != ~0u) Children[Idom[B]].push_back(B);
+  }
+
+  // The values computed in the blocks dominating the current one. Entries
+  // added by a block are removed again once its subtree is done.
+  typedef std::pair<unsigned, std::vector<unsigned>> Key;
+  std::map<Key, unsigned> Available;
+  std::vector<std::vector<Key>> Added(F.Blocks.size());
+
+  bool Changed = false;
+  // A block is pushed once to enter it and once more (as ~B) to leave it.
+  std::vector<unsigned> Stack(1, 0);
+  while (!Stack.empty()) {
+    unsigned B = Stack.back();
+    Stack.pop_back();
+    if (B >= F.Blocks.size()) {
+      for (const Key &K : Added[~B]) {
+        Available.erase(K);
+      }
+      continue;
+    }
+
+    std::vector<unsigned> List = F.Blocks[B].Insts;
+    for (unsigned V : List) {
+      const Inst &I = F.Insts[V];
+      if (!isPure(I.Op)) continue;
+
+      // An unchecked instruction was proven not to fail, so either one can
+      // stand in for the other.
+      Key K = std::make_pair(unsigned(I.Op), I.Ops);
+      if (isCommutative(I.Op) && K.second[1] < K.second[0]) {
+        std::swap(K.second[0], K.second[1]);
+      }
+      auto It = Available.find(K);
+      if (It == Available.end()) {
+        Available[K] = V;
+        Added[B].push_back(K);
+        continue;
+      }
+      F.replaceAllUses(V, It->second);
+      F.erase(V);
+      Changed = true;
+    }
+
+    Stack.push_back(~B);
+    for (unsigned C : Children[B]) {
+      Stack.push_back(C);
+    }
+  }
+  return Changed;
+}
+
+//===----------------------------------------------------------------------===//
+// Passes: strength reduction
+//===----------------------------------------------------------------------===//
+
+/// Whether block `A` dominates block `B`.
+static bool dominates(const std::vector<unsigned> &Idom, unsigned A,
+                      unsigned B) {
+  while (B != A && B != 0) {
+    B = Idom[B];
+  }
+  return B == A;
+}
+
+/// Finds the constant `Step` the phi `IV` changes by every iteration, where
+/// its operand `Back` comes from the end of the loop.
+/// \return false if it is not a loop counter.
+static bool getStep(const Function &F, unsigned IV, unsigned Back,
+                    int &Step) {
+  const Inst &Next = F.Insts[F.Insts[IV].Ops[Back]];
+  int C;
+  if (Next.Op == IROp::add && Next.Ops[0] == IV &&
+      F.isConstant(Next.Ops[1], C)) {
+    Step = C;
+    return true;
+  }
+  if (Next.Op == IROp::add && Next.Ops[1] == IV &&
+      F.isConstant(Next.Ops[0], C)) {
+    Step = C;
+    return true;
+  }
+  if (Next.Op == IROp::sub && Next.Ops[0] == IV &&
+      F.isConstant(Next.Ops[1], C)) {
+    // Wraps around like the additions stepping the product.
+    Step = int(0u - unsigned(C));
+    return true;
+  }
+  return false;
+}
+
+/// Reduces the products of counters of the loop from `Latch` back to `Head`.
+static bool reduceLoop(Function &F, unsigned Head, unsigned Latch) {
+  std::vector<bool> InLoop(F.Blocks.size(), false);
+  InLoop[Head] = true;
+  std::vector<unsigned> Work(1, Latch);
+  while (!Work.empty()) {
+    unsigned B = Work.back();
+    Work.pop_back();
+    if (InLoop[B]) continue;
+    InLoop[B] = true;
+    for (unsigned P : F.Blocks[B].Preds) {
+      Work.push_back(P);
+    }
+  }
+
+  // The start of the product is computed at the end of the only block
+  // entering the loop.
+  const std::vector<unsigned> &Preds = F.Blocks[Head].Preds;
+  if (Preds.size() != 2) return false;
+  unsigned Back = Preds[0] == Latch ? 0 : 1;
+  unsigned Pre = Preds[1 - Back];
+  if (InLoop[Pre] || F.Blocks[Pre].Succs.size() != 1) return false;
+
+  bool Changed = false;
+  std::vector<unsigned> Phis = F.Blocks[Head].Insts;
+  for (unsigned IV : Phis) {
+    int Step;
+    if (F.Insts[IV].Op != IROp::phi) break;
+    if (F.Insts[IV].Erased || !getStep(F, IV, Back, Step)) continue;
+
+    for (unsigned M = 0; M < F.Insts.size(); ++M) {
+      const Inst &I = F.Insts[M];
+      if (I.Erased || I.Op != IROp::mul || I.Checked || !InLoop[I.Block])
+        continue;
+
+      // Values from outside the loop do not change while it runs.
+      unsigned K;
+      if (I.Ops[0] == IV && !InLoop[F.Insts[I.Ops[1]].Block]) {
+        K = I.Ops[1];
+      } else if (I.Ops[1] == IV && !InLoop[F.Insts[I.Ops[0]].Block]) {
+        K = I.Ops[0];
+      } else {
+        continue;
+      }
+
+      // Every operation wraps around, so the product stays exact whenever
+      // the original one is in range, even if the start or the last step is
+      // not.
+      Inst Mul;
+      Mul.Op = IROp::mul;
+      Mul.Ops = {F.Insts[IV].Ops[1 - Back], K};
+      unsigned End = F.Blocks[Pre].Insts.size() - 1;
+      unsigned Start = F.insert(Pre, End, Mul);
+      unsigned Stride;
+      int C;
+      if (F.isConstant(K, C)) {
+        Stride = F.getConstant(int(unsigned(C) * unsigned(Step)));
+      } else {
+        Mul.Ops = {K, F.getConstant(Step)};
+        Stride = F.insert(Pre, F.Blocks[Pre].Insts.size() - 1, Mul);
+      }
+
+      Inst Phi;
+      Phi.Op = IROp::phi;
+      Phi.Var = ~0u;
+      Phi.Ops.resize(2);
+      Phi.Ops[1 - Back] = Start;
+      unsigned Product = F.insert(Head, 0, Phi);
+
+      Inst Add;
+      Add.Op = IROp::add;
+      Add.Ops = {Product, Stride};
+      F.Insts[Product].Ops[Back] =
+          F.insert(Latch, F.Blocks[Latch].Insts.size() - 1, Add);
+
+      F.replaceAllUses(M, Product);
+      F.erase(M);
+      Changed = true;
+    }
+  }
+  return Changed;
+}
+
+bool Passes::ReduceStrength(Function &F) {
+  std::vector<unsigned> Idom = F.getDominators();
+  bool Changed = false;
+  for (unsigned Latch = 0; Latch < F.Blocks.size(); ++Latch) {
+    if (Idom[Latch] == ~0u) continue;
+    // A jump back to a block dominating this one closes a loop.
+    std::vector<unsigned> Succs = F.Blocks[Latch].Succs;
+    for (unsigned Head : Succs) {
+      if (dominates(Idom, Head, Latch)) {
+        Changed |= reduceLoop(F, Head, Latch);
+      }
+    }
+  }
+  return Changed;
+}
+
+//===----------------------------------------------------------------------===//
+// Passes: dead code elimination
+//===----------------------------------------------------------------------===//
+
+bool Passes::EliminateDead(Function &F) {
+  bool Changed = false;
+
+  std::vector<bool> Reached(F.Blocks.size(), false);
+  std::vector<unsigned> Work(1, 0);
+  Reached[0] = true;
+  while (!Work.empty()) {
+    unsigned B = Work.back();
+    Work.pop_back();
+    for (unsigned S : F.Blocks[B].Succs) {
+      if (!Reached[S]) {
+        Reached[S] = true;
+        Work.push_back(S);
+      }
+    }
+  }
+  for (unsigned B = 0; B < F.Blocks.size(); ++B) {
+    if (Reached[B] || F.Blocks[B].Erased) continue;
+    std::vector<unsigned> Succs = F.Blocks[B].Succs;
+    for (unsigned S : Succs) {
+      F.removeEdge(B, S);
+    }
+    for (unsigned V : F.Blocks[B].Insts) {
+      F.Insts[V].Erased = true;
+    }
+    F.Blocks[B].Insts.clear();
+    F.Blocks[B].Erased = true;
+    Changed = true;
+  }
+
+  // Everything an instruction with effects depends on is live, including
+  // cycles of phis that only feed each other are not.
+  std::vector<bool> Live(F.Insts.size(), false);
+  for (unsigned V = 0; V < F.Insts.size(); ++V) {
+    if (!F.Insts[V].Erased && F.hasEffects(V)) {
+      Live[V] = true;
+      Work.push_back(V);
+    }
+  }
+  while (!Work.empty()) {
+    unsigned V = Work.back();
+    Work.pop_back();
+    for (unsigned Op : F.Insts[V].Ops) {
+      if (!Live[Op]) {
+        Live[Op] = true;
+        Work.push_back(Op);
+      }
+    }
+  }
+  for (unsigned V = 0; V < F.Insts.size(); ++V) {
+    if (!F.Insts[V].Erased && !Live[V]) {
+      F.erase(V);
+      Changed = true;
+    }
+  }
+  return Changed;
+}
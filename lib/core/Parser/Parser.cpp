@@ -26,7 +26,11 @@ ASTContext &Parser::getContext() const { return AST.Context; }
 
 Token Parser::currentToken() const { return T->currentToken(); }
 
-void Parser::ConsumeToken() { T->NextToken(); }
+void Parser::ConsumeToken() {
+  // The tokens, not the layout, tell whether a checkpoint fits the program.
+  AST.Mix(currentToken().getData());
+  T->NextToken();
+}
 
 bool Parser::ConsumeIf(TokenType::TokenType Type) {
   if (currentToken().is(Type)) {
@@ -68,4 +72,7 @@ void Parser::UndecoratedParse() {
     throw Diag(DiagType::parser_expected_eof,
                T->currentToken().getData().c_str());
   }
+
+  // Expressions are evaluated by the evaluator chosen for their shape.
+  AST.TranslationUnit->Select();
 }
@@ -0,0 +1,101 @@
+//===--- Bytecode.cpp -----------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements opcode information and printing of programs.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/VM/Bytecode.h"
+
+#include <algorithm> // std::max
+#include <cassert>   // assert
+#include <iomanip>   // std::setw
+#include <iostream>  // std::endl
+
+using OperandKind::imm;
+using OperandKind::index;
+using OperandKind::list;
+using OperandKind::none;
+using OperandKind::reg;
+using OperandKind::target;
+
+const OpInfo &getOpInfo(OpCode::OpCode Op) {
+  // This table is indexed by `OpCode` and must follow its order.
+  static const OpInfo Table[] = {
+      {"halt", {none, none, none}},
+      {"move", {reg, reg, none}},
+      {"add", {reg, reg, reg}},
+      {"sub", {reg, reg, reg}},
+      {"mul", {reg, reg, reg}},
+      {"add_unchecked", {reg, reg, reg}},
+      {"sub_unchecked", {reg, reg, reg}},
+      {"mul_unchecked", {reg, reg, reg}},
+      {"add_imm", {reg, reg, imm}},
+      {"sub_imm", {reg, reg, imm}},
+      {"ne", {reg, reg, reg}},
+      {"eq", {reg, reg, reg}},
+      {"ge", {reg, reg, reg}},
+      {"le", {reg, reg, reg}},
+      {"gt", {reg, reg, reg}},
+      {"lt", {reg, reg, reg}},
+      {"and", {reg, reg, reg}},
+      {"or", {reg, reg, reg}},
+      {"not", {reg, reg, none}},
+      {"jump", {target, none, none}},
+      {"jump_if_false", {reg, target, none}},
+      {"jump_if_true", {reg, target, none}},
+      {"jump_unless_ne", {reg, reg, target}},
+      {"jump_unless_eq", {reg, reg, target}},
+      {"jump_unless_ge", {reg, reg, target}},
+      {"jump_unless_le", {reg, reg, target}},
+      {"jump_unless_gt", {reg, reg, target}},
+      {"jump_unless_lt", {reg, reg, target}},
+      {"clear", {list, none, none}},
+      {"skip_loop", {list, index, none}},
+      {"read", {reg, none, none}},
+      {"write", {reg, none, none}},
+  };
+
+  assert(Op < sizeof(Table) / sizeof(Table[0]) && "Unknown opcode.");
+  return Table[Op];
+}
+
+void Program::Print(std::ostringstream &X) const {
+  for (unsigned I = 0; I < Names.size(); ++I) {
+    X << "; r" << I << " = " << Names[I] << std::endl;
+  }
+  for (auto &Constant : Constants) {
+    X << "; r" << Constant.first << " = #" << Constant.second << std::endl;
+  }
+
+  for (unsigned PC = 0; PC < Code.size(); ++PC) {
+    const Instr &I = Code[PC];
+    const OpInfo &Info = getOpInfo(I.Op);
+    std::string Name = Info.Name;
+    if (Info.Operands[0] != none) {
+      // Align the operands into a column.
+      Name.resize(std::max<size_t>(Name.size() + 1, 16), ' ');
+    }
+    X << std::setw(5) << PC << ": " << Name;
+
+    unsigned Operands[3] = {I.A, I.B, I.C};
+    for (unsigned N = 0; N < 3 && Info.Operands[N] != none; ++N) {
+      if (N != 0) X << ", ";
+      switch (Info.Operands[N]) {
+      case none: break;
+      case reg: X << "r" << Operands[N]; break;
+      case target: X << "@" << Operands[N]; break;
+      case index: X << Operands[N]; break;
+      case imm: X << "#" << (int)Operands[N]; break;
+      case list:
+        X << "{";
+        for (unsigned R = 0; R < RegLists[Operands[N]].size(); ++R) {
+          X << (R == 0 ? "r" : ", r") << RegLists[Operands[N]][R];
+        }
+        X << "}";
+        break;
+      }
+    }
+    X << std::endl;
+  }
+}
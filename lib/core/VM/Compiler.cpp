@@ -0,0 +1,196 @@
+//===--- Compiler.cpp -----------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements the bookkeeping for lowering an AST to bytecode.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/VM/Compiler.h"
+#include "core/AST/Node.h"
+
+#include <algorithm> // std::max
+
+Compiler::Compiler(bool HoistInvariants, bool Fuse, bool ShortCircuit,
+                   unsigned Unroll)
+    : P(new Program), HoistInvariants(HoistInvariants), Fuse(Fuse),
+      ShortCircuit(ShortCircuit), Unroll(Unroll) {}
+
+Compiler::~Compiler() { delete P; }
+
+void Compiler::Declare(IdList *L) {
+  std::string Name = L->getId()->getName();
+  assert(Slots.find(Name) == Slots.end() && "Redeclared identifier.");
+  assert(NumPermanent == P->Names.size() &&
+         "Declarations must be compiled first.");
+
+  Slots[Name] = NumPermanent++;
+  P->Names.push_back(Name);
+
+  if (L->getSeq() != nullptr) {
+    Declare(L->getSeq());
+  }
+}
+
+unsigned Compiler::Slot(Id *I) {
+  auto It = Slots.find(I->getName());
+  assert(It != Slots.end() && "An undeclared identifier made it past the "
+                              "parser.");
+  return It->second;
+}
+
+unsigned Compiler::Constant(int Value) {
+  auto It = ConstantRegs.find(Value);
+  if (It != ConstantRegs.end()) return It->second;
+
+  unsigned R = NumPermanent++;
+  ConstantRegs[Value] = R;
+  P->Constants.push_back(std::make_pair(R, Value));
+  return R;
+}
+
+unsigned Compiler::Temp() {
+  MaxTemps = std::max(MaxTemps, NextTemp + 1);
+  return TempBase + NextTemp++;
+}
+
+unsigned Compiler::Emit(OpCode::OpCode Op, unsigned A, unsigned B,
+                        unsigned C) {
+  P->Code.push_back(Instr{Op, A, B, C, 0});
+  return P->Code.size() - 1;
+}
+
+unsigned Compiler::Emit(Token T, OpCode::OpCode Op, unsigned A, unsigned B,
+                        unsigned C) {
+  P->Tokens.push_back(T);
+  P->Code.push_back(Instr{Op, A, B, C, (unsigned)P->Tokens.size() - 1});
+  return P->Code.size() - 1;
+}
+
+void Compiler::Patch(unsigned At, unsigned Target) {
+  Instr &I = P->Code[At];
+  const OpInfo &Info = getOpInfo(I.Op);
+  unsigned *Operands[3] = {&I.A, &I.B, &I.C};
+  for (unsigned N = 0; N < 3; ++N) {
+    if (Info.Operands[N] == OperandKind::target) {
+      *Operands[N] = Target;
+      return;
+    }
+  }
+  assert(false && "Not a jump.");
+}
+
+void Compiler::Patch(const std::vector<unsigned> &Jumps, unsigned Target) {
+  for (unsigned At : Jumps) {
+    Patch(At, Target);
+  }
+}
+
+/// Whether `Op` only computes a value into its first operand.
+static bool isComputation(OpCode::OpCode Op) {
+  return (Op >= OpCode::add && Op <= OpCode::logic_not) ||
+         Op == OpCode::move;
+}
+
+void Compiler::Move(unsigned Dest, unsigned Src) {
+  // Temporaries are only read once, so the instruction that just produced one
+  // can write its destination directly. It leaves it untouched on failure.
+  if (Fuse && Src >= TempBase && !P->Code.empty()) {
+    Instr &Last = P->Code.back();
+    if (isComputation(Last.Op) && Last.A == Src) {
+      Last.A = Dest;
+      return;
+    }
+  }
+  Emit(OpCode::move, Dest, Src);
+}
+
+void Compiler::SkipLoop(const Induction &IV,
+                        const std::vector<unsigned> &Regs) {
+  P->RegLists.push_back(Regs);
+  P->Inductions.push_back(IV);
+  Emit(OpCode::skip_loop, P->RegLists.size() - 1, P->Inductions.size() - 1);
+}
+
+//===----------------------------------------------------------------------===//
+// Loop-invariant code motion
+//===----------------------------------------------------------------------===//
+
+void Compiler::EnterLoop(const std::set<std::string> &Defs) {
+  LoopScope Scope;
+  Scope.Defs = Defs;
+  Scope.ResetList = P->RegLists.size();
+  P->RegLists.push_back(std::vector<unsigned>());
+  Loops.push_back(Scope);
+
+  // Anything cached for this loop has to be recomputed on every entry.
+  Emit(OpCode::clear, Scope.ResetList);
+}
+
+void Compiler::ExitLoop() { Loops.pop_back(); }
+
+/// Whether none of `Uses` is written by `Scope`.
+static bool isInvariantIn(const std::set<std::string> &Uses,
+                          const std::set<std::string> &Defs) {
+  for (auto &Name : Uses) {
+    if (Defs.count(Name) != 0) return false;
+  }
+  return true;
+}
+
+bool Compiler::canHoist(Node *N) {
+  if (!HoistInvariants || Hoisting || Loops.empty()) return false;
+
+  std::set<std::string> Uses;
+  N->CollectUses(Uses);
+  return isInvariantIn(Uses, Loops.back().Defs);
+}
+
+unsigned Compiler::Hoist(Node *N) {
+  std::set<std::string> Uses;
+  N->CollectUses(Uses);
+
+  // Loops are nested so an outer loop writes everything an inner one does;
+  // find the outermost loop that leaves `N` alone.
+  unsigned Outermost = Loops.size() - 1;
+  while (Outermost > 0 && isInvariantIn(Uses, Loops[Outermost - 1].Defs)) {
+    --Outermost;
+  }
+
+  unsigned Cached = NumPermanent++;
+  unsigned Valid = NumPermanent++;
+  P->RegLists[Loops[Outermost].ResetList].push_back(Valid);
+
+  unsigned Skip = Emit(OpCode::jump_if_true, Valid, 0);
+  Hoisting = true;
+  unsigned Mark = MarkTemps();
+  unsigned R = N->Compile(*this);
+  Move(Cached, R);
+  Emit(OpCode::move, Valid, Constant(1));
+  ReleaseTemps(Mark);
+  Hoisting = false;
+  Patch(Skip, Here());
+
+  return Cached;
+}
+
+//===----------------------------------------------------------------------===//
+// Finishing
+//===----------------------------------------------------------------------===//
+
+Program *Compiler::Finish() {
+  // Temporaries go after every permanent register.
+  for (Instr &I : P->Code) {
+    const OpInfo &Info = getOpInfo(I.Op);
+    unsigned *Operands[3] = {&I.A, &I.B, &I.C};
+    for (unsigned N = 0; N < 3; ++N) {
+      if (Info.Operands[N] == OperandKind::reg && *Operands[N] >= TempBase) {
+        *Operands[N] = *Operands[N] - TempBase + NumPermanent;
+      }
+    }
+  }
+  P->NumRegs = NumPermanent + MaxTemps;
+
+  Program *Result = P;
+  P = nullptr;
+  return Result;
+}
@@ -0,0 +1,383 @@
+//===--- LaneVM.cpp -------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements the lockstep interpreter loop over several lanes.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/VM/LaneVM.h"
+#include "core/AST/Arithmetic.h"
+#include "core/Diag/Diag.h"
+
+#include <limits.h> // UINT_MAX
+#include <sstream>  // std::ostringstream
+
+/// Formats a runtime diagnostic exactly like `VM::Execute`.
+static std::string describe(const LocDiag &D) {
+  std::ostringstream error;
+  Token t = D.getToken();
+  error << "Runtime Error [Line " << t.getLocation().LineNumber << ":"
+        << t.getLocation().ColumnNumber << "] at token: \"" << t.getData()
+        << "\". " << D.what();
+  return error.str();
+}
+
+template <unsigned Lanes>
+LaneVM<Lanes>::LaneVM(const Program &P) : P(P) {}
+
+template <unsigned Lanes>
+std::vector<std::string>
+LaneVM<Lanes>::Execute(const std::vector<std::istream *> &Inputs,
+                       const std::vector<std::ostream *> &Outputs) {
+  assert(Inputs.size() <= Lanes && Inputs.size() == Outputs.size() &&
+         "One input and output per lane.");
+  Regs.assign(P.NumRegs * Lanes, 0);
+  for (auto &Constant : P.Constants) {
+    int *R = lanes(Constant.first);
+    for (unsigned L = 0; L < Lanes; ++L) {
+      R[L] = Constant.second;
+    }
+  }
+
+  Errors.assign(Lanes, "");
+  for (unsigned L = 0; L < Lanes; ++L) {
+    PC[L] = 0;
+    Live[L] = L < Inputs.size();
+    In[L] = Live[L] ? Inputs[L] : nullptr;
+    Out[L] = Live[L] ? Outputs[L] : nullptr;
+  }
+
+  while (Step()) {
+  }
+  Errors.resize(Inputs.size());
+  return Errors;
+}
+
+template <unsigned Lanes>
+void LaneVM<Lanes>::Fail(unsigned L, const std::string &Error) {
+  Errors[L] = Error;
+  Live[L] = false;
+  Mask[L] = false;
+}
+
+template <unsigned Lanes>
+template <typename DeferredFn, typename CheckedFn>
+void LaneVM<Lanes>::Compute(const Instr &I, DeferredFn Deferred,
+                            CheckedFn Checked) {
+  int Values[Lanes];
+  bool Suspect[Lanes] = {};
+  bool AnySuspect = false;
+  for (unsigned L = 0; L < Lanes; ++L) {
+    Values[L] = Deferred(L, Suspect[L]);
+    Suspect[L] = Suspect[L] && Mask[L];
+    AnySuspect |= Suspect[L];
+  }
+
+  // The suspect lanes are settled before any lane is written, as the
+  // destination may also be an operand.
+  if (AnySuspect) {
+    for (unsigned L = 0; L < Lanes; ++L) {
+      if (!Suspect[L]) continue;
+      ArithResult::ArithResult Result = Checked(L, Values[L]);
+      if (Result != ArithResult::ok) {
+        Fail(L, describe(Arith::Diagnose(P.Tokens[I.Loc], Result)));
+      }
+    }
+  }
+
+  int *A = lanes(I.A);
+  for (unsigned L = 0; L < Lanes; ++L) {
+    A[L] = Mask[L] ? Values[L] : A[L];
+  }
+}
+
+template <unsigned Lanes>
+template <typename Fn>
+void LaneVM<Lanes>::Map(const Instr &I, Fn F) {
+  int *A = lanes(I.A);
+  const int *B = lanes(I.B), *C = lanes(I.C);
+  int Values[Lanes];
+  for (unsigned L = 0; L < Lanes; ++L) {
+    Values[L] = F(B[L], C[L]);
+  }
+  for (unsigned L = 0; L < Lanes; ++L) {
+    A[L] = Mask[L] ? Values[L] : A[L];
+  }
+}
+
+template <unsigned Lanes>
+template <typename Fn>
+void LaneVM<Lanes>::Branch(const Instr &I, bool *Taken, Fn Holds) {
+  const int *A = lanes(I.A), *B = lanes(I.B);
+  for (unsigned L = 0; L < Lanes; ++L) {
+    Taken[L] = !Holds(A[L], B[L]);
+  }
+}
+
+template <unsigned Lanes> bool LaneVM<Lanes>::Step() {
+  // The group at the lowest instruction runs; the others wait for it.
+  unsigned Cur = UINT_MAX;
+  for (unsigned L = 0; L < Lanes; ++L) {
+    if (Live[L] && PC[L] < Cur) Cur = PC[L];
+  }
+  if (Cur == UINT_MAX) return false;
+
+  unsigned Waiting = UINT_MAX;
+  for (unsigned L = 0; L < Lanes; ++L) {
+    Mask[L] = Live[L] && PC[L] == Cur;
+    if (Live[L] && !Mask[L] && PC[L] < Waiting) Waiting = PC[L];
+  }
+
+  auto anyMasked = [this]() {
+    bool Any = false;
+    for (unsigned L = 0; L < Lanes; ++L) {
+      Any |= Mask[L];
+    }
+    return Any;
+  };
+
+  const Instr *Code = P.Code.data();
+  // Once the group reaches waiting lanes it is formed again with them.
+  while (Cur < Waiting) {
+    const Instr &I = Code[Cur];
+    unsigned Next = Cur + 1;
+    // Whether each masked lane takes the branch of a jump.
+    bool Taken[Lanes];
+    unsigned Target = Next;
+    bool Branches = false;
+
+    switch (I.Op) {
+    case OpCode::halt:
+      for (unsigned L = 0; L < Lanes; ++L) {
+        if (Mask[L]) Live[L] = false;
+      }
+      return true;
+
+    case OpCode::move: {
+      int *A = lanes(I.A);
+      const int *B = lanes(I.B);
+      for (unsigned L = 0; L < Lanes; ++L) {
+        A[L] = Mask[L] ? B[L] : A[L];
+      }
+      break;
+    }
+
+    case OpCode::add: {
+      const int *B = lanes(I.B), *C = lanes(I.C);
+      Compute(I,
+              [=](unsigned L, bool &S) {
+                return Arith::AddDeferred(B[L], C[L], S);
+              },
+              [=](unsigned L, int &V) { return Arith::Add(B[L], C[L], V); });
+      break;
+    }
+    case OpCode::sub: {
+      const int *B = lanes(I.B), *C = lanes(I.C);
+      Compute(I,
+              [=](unsigned L, bool &S) {
+                return Arith::SubtractDeferred(B[L], C[L], S);
+              },
+              [=](unsigned L, int &V) {
+                return Arith::Subtract(B[L], C[L], V);
+              });
+      break;
+    }
+    case OpCode::mul: {
+      const int *B = lanes(I.B), *C = lanes(I.C);
+      Compute(I,
+              [=](unsigned L, bool &S) {
+                return Arith::MultiplyDeferred(B[L], C[L], S);
+              },
+              [=](unsigned L, int &V) {
+                return Arith::Multiply(B[L], C[L], V);
+              });
+      break;
+    }
+    case OpCode::add_imm: {
+      const int *B = lanes(I.B);
+      int Imm = (int)I.C;
+      Compute(I,
+              [=](unsigned L, bool &S) {
+                return Arith::AddDeferred(B[L], Imm, S);
+              },
+              [=](unsigned L, int &V) { return Arith::Add(B[L], Imm, V); });
+      break;
+    }
+    case OpCode::sub_imm: {
+      const int *B = lanes(I.B);
+      int Imm = (int)I.C;
+      Compute(I,
+              [=](unsigned L, bool &S) {
+                return Arith::SubtractDeferred(B[L], Imm, S);
+              },
+              [=](unsigned L, int &V) {
+                return Arith::Subtract(B[L], Imm, V);
+              });
+      break;
+    }
+
+    case OpCode::add_unchecked:
+      Map(I, [](int B, int C) { return int(unsigned(B) + unsigned(C)); });
+      break;
+    case OpCode::sub_unchecked:
+      Map(I, [](int B, int C) { return int(unsigned(B) - unsigned(C)); });
+      break;
+    case OpCode::mul_unchecked:
+      Map(I, [](int B, int C) { return int(unsigned(B) * unsigned(C)); });
+      break;
+
+    case OpCode::cmp_not_equal:
+      Map(I, [](int B, int C) { return int(B != C); });
+      break;
+    case OpCode::cmp_equal:
+      Map(I, [](int B, int C) { return int(B == C); });
+      break;
+    case OpCode::cmp_greater_than_equal:
+      Map(I, [](int B, int C) { return int(B >= C); });
+      break;
+    case OpCode::cmp_less_than_equal:
+      Map(I, [](int B, int C) { return int(B <= C); });
+      break;
+    case OpCode::cmp_greater_than:
+      Map(I, [](int B, int C) { return int(B > C); });
+      break;
+    case OpCode::cmp_less_than:
+      Map(I, [](int B, int C) { return int(B < C); });
+      break;
+
+    case OpCode::logic_and:
+      Map(I, [](int B, int C) { return int(B && C); });
+      break;
+    case OpCode::logic_or:
+      Map(I, [](int B, int C) { return int(B || C); });
+      break;
+    case OpCode::logic_not:
+      Map(I, [](int B, int) { return int(!B); });
+      break;
+
+    case OpCode::jump: Next = I.A; break;
+    case OpCode::jump_if_false:
+    case OpCode::jump_if_true: {
+      const int *A = lanes(I.A);
+      bool When = I.Op == OpCode::jump_if_true;
+      for (unsigned L = 0; L < Lanes; ++L) {
+        Taken[L] = (A[L] != 0) == When;
+      }
+      Target = I.B;
+      Branches = true;
+      break;
+    }
+
+    case OpCode::jump_unless_ne:
+      Branch(I, Taken, [](int A, int B) { return A != B; });
+      Target = I.C;
+      Branches = true;
+      break;
+    case OpCode::jump_unless_eq:
+      Branch(I, Taken, [](int A, int B) { return A == B; });
+      Target = I.C;
+      Branches = true;
+      break;
+    case OpCode::jump_unless_ge:
+      Branch(I, Taken, [](int A, int B) { return A >= B; });
+      Target = I.C;
+      Branches = true;
+      break;
+    case OpCode::jump_unless_le:
+      Branch(I, Taken, [](int A, int B) { return A <= B; });
+      Target = I.C;
+      Branches = true;
+      break;
+    case OpCode::jump_unless_gt:
+      Branch(I, Taken, [](int A, int B) { return A > B; });
+      Target = I.C;
+      Branches = true;
+      break;
+    case OpCode::jump_unless_lt:
+      Branch(I, Taken, [](int A, int B) { return A < B; });
+      Target = I.C;
+      Branches = true;
+      break;
+
+    case OpCode::clear:
+      for (unsigned Reg : P.RegLists[I.A]) {
+        int *R = lanes(Reg);
+        for (unsigned L = 0; L < Lanes; ++L) {
+          R[L] = Mask[L] ? 0 : R[L];
+        }
+      }
+      break;
+
+    case OpCode::skip_loop: {
+      const Induction &IV = P.Inductions[I.B];
+      const std::vector<unsigned> &List = P.RegLists[I.A];
+      std::vector<int> Values(IV.NumVars), Steps(IV.Updates.size());
+      for (unsigned L = 0; L < Lanes; ++L) {
+        if (!Mask[L]) continue;
+        for (unsigned V = 0; V < Values.size(); ++V) {
+          Values[V] = lanes(List[V])[L];
+        }
+        for (unsigned U = 0; U < Steps.size(); ++U) {
+          Steps[U] = lanes(List[Values.size() + U])[L];
+        }
+        if (IV.Skip(Values.data(), Steps.data(), lanes(List.back())[L]) > 0) {
+          for (unsigned V = 0; V < Values.size(); ++V) {
+            lanes(List[V])[L] = Values[V];
+          }
+        }
+      }
+      break;
+    }
+
+    case OpCode::read:
+      for (unsigned L = 0; L < Lanes; ++L) {
+        if (!Mask[L]) continue;
+        int Value;
+        *Out[L] << P.Names[I.A] << " =? ";
+        *In[L] >> Value;
+        if (In[L]->fail()) {
+          Fail(L, "Invalid integer input.");
+          continue;
+        }
+        lanes(I.A)[L] = Value;
+      }
+      break;
+    case OpCode::write:
+      for (unsigned L = 0; L < Lanes; ++L) {
+        if (!Mask[L]) continue;
+        *Out[L] << P.Names[I.A] << " = " << lanes(I.A)[L] << std::endl;
+      }
+      break;
+    }
+
+    if (Branches) {
+      unsigned Masked = 0, Jumping = 0;
+      for (unsigned L = 0; L < Lanes; ++L) {
+        Masked += Mask[L];
+        Jumping += Mask[L] && Taken[L];
+      }
+      if (Jumping == Masked) {
+        Next = Target;
+      } else if (Jumping != 0) {
+        // The lanes branch apart and wait for each other at the lowest
+        // instruction.
+        for (unsigned L = 0; L < Lanes; ++L) {
+          if (Mask[L]) PC[L] = Taken[L] ? Target : Next;
+        }
+        return true;
+      }
+    }
+
+    // Failed lanes leave the group.
+    if (!anyMasked()) return true;
+    Cur = Next;
+  }
+
+  for (unsigned L = 0; L < Lanes; ++L) {
+    if (Mask[L]) PC[L] = Cur;
+  }
+  return true;
+}
+
+template class LaneVM<8>;
+template class LaneVM<16>;
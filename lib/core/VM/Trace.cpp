@@ -0,0 +1,86 @@
+//===--- Trace.cpp --------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements building linear traces of loop iterations.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/VM/Trace.h"
+
+#include <cassert> // assert
+
+/// The index of the target operand of `Op`, or 3 if it is not a jump.
+static unsigned targetOperand(OpCode::OpCode Op) {
+  const OpInfo &Info = getOpInfo(Op);
+  for (unsigned N = 0; N < 3; ++N) {
+    if (Info.Operands[N] == OperandKind::target) return N;
+  }
+  return 3;
+}
+
+/// The branch taken exactly when `Op` is not.
+static OpCode::OpCode invertBranch(OpCode::OpCode Op) {
+  switch (Op) {
+  case OpCode::jump_if_false: return OpCode::jump_if_true;
+  case OpCode::jump_if_true: return OpCode::jump_if_false;
+  case OpCode::jump_unless_ne: return OpCode::jump_unless_eq;
+  case OpCode::jump_unless_eq: return OpCode::jump_unless_ne;
+  case OpCode::jump_unless_ge: return OpCode::jump_unless_lt;
+  case OpCode::jump_unless_lt: return OpCode::jump_unless_ge;
+  case OpCode::jump_unless_le: return OpCode::jump_unless_gt;
+  case OpCode::jump_unless_gt: return OpCode::jump_unless_le;
+  default: break;
+  }
+  assert(false && "Not a conditional branch.");
+  return Op;
+}
+
+namespace Trace {
+
+bool FindLoop(const Program &P, unsigned &Head, unsigned &BackEdge) {
+  unsigned Found = 0;
+  for (unsigned PC = 0; PC < P.Code.size(); ++PC) {
+    const Instr &I = P.Code[PC];
+    if (I.Op == OpCode::jump && I.A <= PC) {
+      Head = I.A;
+      BackEdge = PC;
+      ++Found;
+    }
+  }
+  return Found == 1;
+}
+
+Program *Build(const Program &P, const std::vector<unsigned> &Path) {
+  unsigned Head, BackEdge;
+  if (!FindLoop(P, Head, BackEdge) || Path.empty() || Path.front() != Head ||
+      Path.back() != BackEdge) {
+    return nullptr;
+  }
+
+  Program *T = new Program(P);
+  unsigned Start = T->Code.size();
+  for (unsigned N = 0; N + 1 < Path.size(); ++N) {
+    Instr I = P.Code[Path[N]];
+    unsigned Next = Path[N + 1];
+    unsigned Target = targetOperand(I.Op);
+    if (Target == 3) {
+      T->Code.push_back(I);
+      continue;
+    }
+    // The path carries on where the jump went, so it is not needed.
+    if (I.Op == OpCode::jump) continue;
+
+    unsigned *Operands[3] = {&I.A, &I.B, &I.C};
+    if (Next == *Operands[Target]) {
+      // The branch was taken: leave the trace when it is not.
+      I.Op = invertBranch(I.Op);
+      *Operands[Target] = Path[N] + 1;
+    }
+    T->Code.push_back(I);
+  }
+  T->Code.push_back(Instr{OpCode::jump, Start, 0, 0, 0});
+  T->Code[BackEdge].A = Start;
+  return T;
+}
+
+} // namespace Trace
@@ -0,0 +1,213 @@
+//===--- VM.cpp -----------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Implements the bytecode interpreter loop.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/VM/VM.h"
+#include "core/AST/Arithmetic.h"
+#include "core/Diag/Diag.h"
+#include "core/Exec/Budget.h"
+
+#include <algorithm> // std::copy
+#include <sstream>   // std::ostringstream
+
+VM::VM(const Program &P, std::istream &In, std::ostream &Out)
+    : P(P), In(In), Out(Out) {}
+
+void VM::Execute() {
+  Reset();
+  Dispatch();
+}
+
+void VM::Execute(std::vector<int> &Vars) {
+  assert(Vars.size() == P.Names.size() && "One value per variable.");
+  Reset();
+  std::copy(Vars.begin(), Vars.end(), Regs.begin());
+  Dispatch();
+  std::copy(Regs.begin(), Regs.begin() + Vars.size(), Vars.begin());
+}
+
+void VM::Reset() {
+  Arrivals = 0;
+  Stopped = false;
+  if (Path != nullptr) Path->clear();
+  Regs.assign(P.NumRegs, 0);
+  for (auto &Constant : P.Constants) {
+    Regs[Constant.first] = Constant.second;
+  }
+}
+
+void VM::Dispatch() {
+  try {
+    if (Counts != nullptr || Path != nullptr) {
+      if (Counts != nullptr) Counts->assign(P.Code.size(), 0);
+      Limits != nullptr ? Run<true, true>() : Run<true, false>();
+    } else {
+      Limits != nullptr ? Run<false, true>() : Run<false, false>();
+    }
+  } catch (LocDiag &D) {
+    std::ostringstream error;
+    Token t = D.getToken();
+    error << "Runtime Error [Line " << t.getLocation().LineNumber << ":"
+          << t.getLocation().ColumnNumber << "] at token: \"" << t.getData()
+          << "\". " << D.what();
+    throw error.str();
+  } catch (Diag &D) {
+    std::ostringstream error;
+    error << "Runtime Error: " << D.what();
+    throw error.str();
+  }
+}
+
+void VM::Fail(const Instr &I, ArithResult::ArithResult Result) {
+  throw Arith::Diagnose(P.Tokens[I.Loc], Result);
+}
+
+bool VM::Record(unsigned PC) {
+  if (PC == TraceHead && ++Arrivals == 3) {
+    Stopped = true;
+    return true;
+  }
+  // The first iteration computes the hoisted values and is not typical.
+  if (Arrivals >= 2) Path->push_back(PC);
+  return false;
+}
+
+/// Moves to instruction `Target`. Only loops jump backward, so those jumps
+/// spend a step of the budget.
+template <bool Budgeted>
+static inline void jumpTo(unsigned &PC, unsigned Target, Budget *Limits) {
+  if (Budgeted && Target < PC) Limits->Step();
+  PC = Target;
+}
+
+template <bool Profiling, bool Budgeted> void VM::Run() {
+  const Instr *Code = P.Code.data();
+  int *R = Regs.data();
+  unsigned PC = 0;
+  ArithResult::ArithResult Result;
+
+  while (true) {
+    if (Profiling) {
+      if (Counts != nullptr) ++(*Counts)[PC];
+      if (Path != nullptr && Record(PC)) return;
+    }
+    const Instr &I = Code[PC++];
+    switch (I.Op) {
+    case OpCode::halt: return;
+    case OpCode::move: R[I.A] = R[I.B]; break;
+
+    case OpCode::add:
+      Result = Arith::Add(R[I.B], R[I.C], R[I.A]);
+      if (Result != ArithResult::ok) Fail(I, Result);
+      break;
+    case OpCode::sub:
+      Result = Arith::Subtract(R[I.B], R[I.C], R[I.A]);
+      if (Result != ArithResult::ok) Fail(I, Result);
+      break;
+    case OpCode::mul:
+      Result = Arith::Multiply(R[I.B], R[I.C], R[I.A]);
+      if (Result != ArithResult::ok) Fail(I, Result);
+      break;
+    case OpCode::add_unchecked:
+      R[I.A] = int(unsigned(R[I.B]) + unsigned(R[I.C]));
+      break;
+    case OpCode::sub_unchecked:
+      R[I.A] = int(unsigned(R[I.B]) - unsigned(R[I.C]));
+      break;
+    case OpCode::mul_unchecked:
+      R[I.A] = int(unsigned(R[I.B]) * unsigned(R[I.C]));
+      break;
+
+    case OpCode::add_imm:
+      Result = Arith::Add(R[I.B], (int)I.C, R[I.A]);
+      if (Result != ArithResult::ok) Fail(I, Result);
+      break;
+    case OpCode::sub_imm:
+      Result = Arith::Subtract(R[I.B], (int)I.C, R[I.A]);
+      if (Result != ArithResult::ok) Fail(I, Result);
+      break;
+
+    case OpCode::cmp_not_equal: R[I.A] = R[I.B] != R[I.C]; break;
+    case OpCode::cmp_equal: R[I.A] = R[I.B] == R[I.C]; break;
+    case OpCode::cmp_greater_than_equal: R[I.A] = R[I.B] >= R[I.C]; break;
+    case OpCode::cmp_less_than_equal: R[I.A] = R[I.B] <= R[I.C]; break;
+    case OpCode::cmp_greater_than: R[I.A] = R[I.B] > R[I.C]; break;
+    case OpCode::cmp_less_than: R[I.A] = R[I.B] < R[I.C]; break;
+
+    case OpCode::logic_and: R[I.A] = R[I.B] && R[I.C]; break;
+    case OpCode::logic_or: R[I.A] = R[I.B] || R[I.C]; break;
+    case OpCode::logic_not: R[I.A] = !R[I.B]; break;
+
+    case OpCode::jump: jumpTo<Budgeted>(PC, I.A, Limits); break;
+    case OpCode::jump_if_false:
+      if (!R[I.A]) jumpTo<Budgeted>(PC, I.B, Limits);
+      break;
+    case OpCode::jump_if_true:
+      if (R[I.A]) jumpTo<Budgeted>(PC, I.B, Limits);
+      break;
+
+    case OpCode::jump_unless_ne:
+      if (!(R[I.A] != R[I.B])) jumpTo<Budgeted>(PC, I.C, Limits);
+      break;
+    case OpCode::jump_unless_eq:
+      if (!(R[I.A] == R[I.B])) jumpTo<Budgeted>(PC, I.C, Limits);
+      break;
+    case OpCode::jump_unless_ge:
+      if (!(R[I.A] >= R[I.B])) jumpTo<Budgeted>(PC, I.C, Limits);
+      break;
+    case OpCode::jump_unless_le:
+      if (!(R[I.A] <= R[I.B])) jumpTo<Budgeted>(PC, I.C, Limits);
+      break;
+    case OpCode::jump_unless_gt:
+      if (!(R[I.A] > R[I.B])) jumpTo<Budgeted>(PC, I.C, Limits);
+      break;
+    case OpCode::jump_unless_lt:
+      if (!(R[I.A] < R[I.B])) jumpTo<Budgeted>(PC, I.C, Limits);
+      break;
+
+    case OpCode::clear:
+      for (unsigned Reg : P.RegLists[I.A]) {
+        R[Reg] = 0;
+      }
+      break;
+
+    case OpCode::skip_loop: {
+      const Induction &IV = P.Inductions[I.B];
+      const std::vector<unsigned> &List = P.RegLists[I.A];
+      std::vector<int> Values(IV.NumVars), Steps(IV.Updates.size());
+      for (unsigned V = 0; V < Values.size(); ++V) {
+        Values[V] = R[List[V]];
+      }
+      for (unsigned U = 0; U < Steps.size(); ++U) {
+        Steps[U] = R[List[Values.size() + U]];
+      }
+      long long Skipped = IV.Skip(Values.data(), Steps.data(), R[List.back()]);
+      if (Skipped > 0) {
+        for (unsigned V = 0; V < Values.size(); ++V) {
+          R[List[V]] = Values[V];
+        }
+        if (Budgeted) Limits->Step(Skipped);
+      }
+      break;
+    }
+
+    case OpCode::read: {
+      int Value;
+      Out << P.Names[I.A] << " =? ";
+      In >> Value;
+      if (In.fail()) {
+        std::string Error = "Invalid integer input.";
+        throw Error;
+      }
+      R[I.A] = Value;
+      break;
+    }
+    case OpCode::write:
+      Out << P.Names[I.A] << " = " << R[I.A] << std::endl;
+      break;
+    }
+  }
+}
@@ -0,0 +1,377 @@
+//===--- test_optimizer.cpp -----------------------------------------------===//
+//
+// Author: ケジ
+// Description: Runs optimizer tests.
+//
+//===----------------------------------------------------------------------===//
+
+#include "doctest.h"
+
+#include "core/AST/AST.h"
+#include "core/AST/OptStats.h"
+#include "core/Parser/Parser.h"
+
+#include <sstream> // std::istringstream, std::ostringstream
+#include <vector>  // std::vector
+
+/// Wraps the statement sequence `Stmts` in a program declaring X, Y and Z.
+std::string wrapProgram(std::string Stmts) {
+  return "program \n  int X, Y, Z;\n  begin\n" + Stmts + "  end\n";
+}
+
+void testFold(std::string Test, std::string Expected) {
+  AST A;
+  Parser P = *Parser::CreateFromString(wrapProgram(Test), A);
+  P.Parse();
+  A.Fold();
+
+  std::ostringstream X;
+  A.Print(X);
+  CHECK(X.str() == wrapProgram(Expected));
+}
+
+/// Prunes `Test` and checks the printed result. Returns the counters.
+OptStats testPrune(std::string Test, std::string Expected) {
+  AST A;
+  Parser P = *Parser::CreateFromString(wrapProgram(Test), A);
+  P.Parse();
+  A.Fold();
+  OptStats S;
+  A.Prune(S);
+
+  std::ostringstream X;
+  A.Print(X);
+  CHECK(X.str() == wrapProgram(Expected));
+  return S;
+}
+
+/// Specializes `Test` for the first reads having the values `Inputs` and checks
+/// the printed residual program, which must parse to itself. Returns the
+/// number of values used.
+unsigned testSpecialize(std::string Test, std::vector<int> Inputs,
+                        std::string Expected) {
+  AST A;
+  Parser P = *Parser::CreateFromString(wrapProgram(Test), A);
+  P.Parse();
+  OptStats S;
+  unsigned Used = A.Specialize(Inputs, S);
+
+  std::ostringstream X;
+  A.Print(X);
+  CHECK(X.str() == wrapProgram(Expected));
+
+  AST Residual;
+  Parser R = *Parser::CreateFromString(X.str(), Residual);
+  R.Parse();
+  std::ostringstream Y;
+  Residual.Print(Y);
+  CHECK(Y.str() == X.str());
+  return Used;
+}
+
+TEST_SUITE("optimizer") {
+  //===--------------------------------------------------------------------===//
+  // Constant folding.
+  //===--------------------------------------------------------------------===//
+  TEST_CASE("folds constant subtrees") {
+    testFold("    X = ( 2 * 3 ) + 4;\n", "    X = 10;\n");
+    testFold("    read X;\n    Y = ( 2 * 3 ) + X;\n",
+             "    read X;\n    Y = 6 + X;\n");
+  }
+
+  TEST_CASE("folds below the literal range") {
+    // CORE has no negative literals.
+    testFold("    X = 1 - 5;\n", "    X = ( 0 - 4 );\n");
+    testFold("    X = ( 0 - 99999999 * 21 ) - 47483669;\n",
+             "    X = ( ( 0 - ( 21 * 10000 * 10000 + 47483647 ) ) - 1 );\n");
+  }
+
+  TEST_CASE("simplifies arithmetic identities") {
+    testFold("    read X;\n    Y = X * 1;\n", "    read X;\n    Y = X;\n");
+    testFold("    read X;\n    Y = X + 0;\n", "    read X;\n    Y = X;\n");
+    testFold("    read X;\n    Y = X - 0;\n", "    read X;\n    Y = X;\n");
+    testFold("    read X;\n    Y = 0 + X;\n", "    read X;\n    Y = X;\n");
+    testFold("    read X;\n    Y = X * 0;\n", "    read X;\n    Y = 0;\n");
+    testFold("    read X;\n    Y = ( X ) * ( 3 - 2 );\n",
+             "    read X;\n    Y = X;\n");
+  }
+
+  TEST_CASE("keeps identities that can change diagnostics") {
+    // `1 * X` reports an overflow for a negative `X`.
+    testFold("    read X;\n    Y = 1 * X;\n", "    read X;\n    Y = 1 * X;\n");
+    // The factor itself may overflow.
+    testFold("    read X;\n    Y = ( X * X ) * 0;\n",
+             "    read X;\n    Y = ( X * X ) * 0;\n");
+  }
+
+  TEST_CASE("leaves failing operations for runtime") {
+    testFold("    X = 99999999 * 99999999;\n",
+             "    X = 99999999 * 99999999;\n");
+  }
+
+  TEST_CASE("only reports folded overflow once reached") {
+    AST A;
+    Parser P = *Parser::CreateFromString(
+        wrapProgram("    X = 1;\n    if ( X > 5 ) then\n      Y = 99999999 * "
+                    "99999999;\n    end;\n"),
+        A);
+    P.Parse();
+    A.Fold();
+    CHECK_NOTHROW(A.Execute());
+  }
+
+  TEST_CASE("folds the smallest value times minus one") {
+    // `INT_MIN / -1` must never be evaluated while checking the product.
+    AST A;
+    Parser P = *Parser::CreateFromString(
+        wrapProgram("    Y = 0;\n    if ( Y > 1 ) then\n      X = ( ( 0 - "
+                    "65536 ) * 32768 ) * ( 0 - 1 );\n    end;\n"),
+        A);
+    P.Parse();
+    A.Fold();
+    CHECK_NOTHROW(A.Execute());
+
+    AST B;
+    Parser Q = *Parser::CreateFromString(
+        wrapProgram("    X = ( ( 0 - 65536 ) * 32768 ) * ( 0 - 1 );\n"), B);
+    Q.Parse();
+    B.Fold();
+    CHECK_THROWS_WITH(B.Execute(),
+                      "Runtime Error [Line 4:9] at token: \"(\". "
+                      "Performing multiplication here will cause underflow "
+                      "and unexpected behavior.");
+  }
+
+  TEST_CASE("reports folded overflow at the original token") {
+    AST A;
+    Parser P = *Parser::CreateFromString(
+        wrapProgram("    X = 3 + 99999999 * 99999999;\n"), A);
+    P.Parse();
+    A.Fold();
+    CHECK_THROWS_WITH(A.Execute(),
+                      "Runtime Error [Line 4:13] at token: \"99999999\". "
+                      "Performing multiplication here will cause overflow "
+                      "and unexpected behavior.");
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Dead-store and dead-branch elimination.
+  //===--------------------------------------------------------------------===//
+  TEST_CASE("removes overwritten assignments") {
+    OptStats S = testPrune("    read Y;\n    X = Y;\n    X = 4;\n    "
+                           "write X;\n",
+                           "    read Y;\n    X = 4;\n    write X;\n");
+    CHECK(S.DeadStores == 1);
+    CHECK(S.getRemoved() == 1);
+  }
+
+  TEST_CASE("propagates constants") {
+    testPrune("    X = 2;\n    Y = X * 3;\n    write Y;\n",
+              "    Y = 6;\n    write Y;\n");
+  }
+
+  TEST_CASE("keeps reads, writes and arithmetic that could overflow") {
+    OptStats S = testPrune(
+        "    read X;\n    Y = X * X;\n    Z = X;\n    read Z;\n    write X;\n",
+        "    read X;\n    Y = X * X;\n    read Z;\n    write X;\n");
+    CHECK(S.DeadStores == 1);
+  }
+
+  TEST_CASE("prunes decided branches") {
+    OptStats S = testPrune("    X = 1;\n    if ( X > 5 ) then\n      write X;\n"
+                           "    else\n      Y = 2;\n      write Y;\n    end;\n",
+                           "    Y = 2;\n    write Y;\n");
+    CHECK(S.DeadBranches == 1);
+    CHECK(S.DeadStores == 1);
+  }
+
+  TEST_CASE("does not decide conditions that could overflow") {
+    testPrune("    read X;\n    if [ ( 1 == 1 ) or ( ( X * X ) > 1 ) ] then\n"
+              "      write X;\n    end;\n",
+              "    read X;\n    if [ ( 1 == 1 ) or ( ( X * X ) > 1 ) ] then\n"
+              "      write X;\n    end;\n");
+  }
+
+  TEST_CASE("merges constants after a branch") {
+    testPrune("    read X;\n    if ( X > 5 ) then\n      Y = 1;\n    else\n"
+              "      Y = 1;\n    end;\n    write Y;\n    Z = Y + 1;\n"
+              "    write Z;\n",
+              "    read X;\n    if ( X > 5 ) then\n      Y = 1;\n    else\n"
+              "      Y = 1;\n    end;\n    write Y;\n    Z = 2;\n"
+              "    write Z;\n");
+  }
+
+  TEST_CASE("removes loops that are never entered") {
+    OptStats S = testPrune("    X = 3;\n    while ( X < 3 ) loop\n"
+                           "      X = X + 1;\n    end;\n    write X;\n",
+                           "    X = 3;\n    write X;\n");
+    CHECK(S.DeadLoops == 1);
+  }
+
+  TEST_CASE("keeps values read by later iterations") {
+    std::string Loop = "    X = 0;\n    Y = 0;\n    while ( X < 3 ) loop\n"
+                       "      write Y;\n      Y = X;\n      X = X + 1;\n"
+                       "      Z = X;\n    end;\n";
+    testPrune(Loop, "    X = 0;\n    Y = 0;\n    while ( X < 3 ) loop\n"
+                    "      write Y;\n      Y = X;\n      X = X + 1;\n"
+                    "    end;\n");
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Value-range analysis.
+  //===--------------------------------------------------------------------===//
+  TEST_CASE("removes checks of bounded loop counters") {
+    AST A;
+    Parser P = *Parser::CreateFromString(
+        wrapProgram("    read Y;\n    X = 0;\n    Z = 0;\n    while ( X < Y ) "
+                    "loop\n      Z = Z + X;\n      X = X + 1;\n    end;\n"),
+        A);
+    P.Parse();
+    OptStats S;
+    A.AnalyzeRanges(S);
+    // `X + 1` is bounded by `X < Y`, `Z + X` is not.
+    CHECK(S.Checks == 2);
+    CHECK(S.ChecksEliminated == 1);
+  }
+
+  TEST_CASE("narrows ranges by conditions") {
+    AST A;
+    Parser P = *Parser::CreateFromString(
+        wrapProgram("    read X;\n    if [ ( X > 0 ) and ( X < 1000 ) ] then\n"
+                    "      Y = X * X;\n      Z = Y - X;\n    else\n"
+                    "      Y = X * 2;\n    end;\n"),
+        A);
+    P.Parse();
+    OptStats S;
+    A.AnalyzeRanges(S);
+    CHECK(S.Checks == 3);
+    CHECK(S.ChecksEliminated == 2);
+  }
+
+  TEST_CASE("keeps checks for a negative multiplier") {
+    AST A;
+    Parser P = *Parser::CreateFromString(
+        wrapProgram("    X = 0 - 3;\n    Y = 2 * X;\n"), A);
+    P.Parse();
+    OptStats S;
+    A.AnalyzeRanges(S);
+    CHECK(S.ChecksEliminated == 1);
+    CHECK_THROWS_WITH(A.Execute(),
+                      "Runtime Error [Line 5:9] at token: \"2\". Performing "
+                      "multiplication here will cause overflow and unexpected "
+                      "behavior.");
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Closed-form loops.
+  //===--------------------------------------------------------------------===//
+  TEST_CASE("recognizes counting loops") {
+    AST A;
+    Parser P = *Parser::CreateFromString(
+        wrapProgram("    read Y;\n    X = 0;\n    Z = 0;\n"
+                    "    while ( Y > X ) loop\n"
+                    "      X = X + 1;\n      Z = 2 + Z;\n    end;\n"
+                    "    while ( X < Y ) loop\n      X = X + Z;\n"
+                    "      Z = Z + 1;\n    end;\n"
+                    "    while ( X < 9 ) loop\n      X = X + 1;\n"
+                    "      write X;\n    end;\n"),
+        A);
+    P.Parse();
+    OptStats S;
+    A.FindInductions(S);
+    // Only the first loop steps by values it does not write.
+    CHECK(S.ClosedFormLoops == 1);
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Partial evaluation.
+  //===--------------------------------------------------------------------===//
+  TEST_CASE("specializes the first reads") {
+    CHECK(testSpecialize("    read X, Y;\n    Z = X * Y - 50;\n    write Z;\n",
+                         {6, 7}, "    Z = ( 0 - 8 );\n    write Z;\n") == 2);
+    // The rest of the reads stay.
+    CHECK(testSpecialize("    read X, Y;\n    Z = X * Y;\n    write Z;\n",
+                         {6}, "    X = 6;\n    read Y;\n    Z = 6 * Y;\n"
+                              "    write Z;\n") == 1);
+  }
+
+  TEST_CASE("specializes reads in decided branches") {
+    CHECK(testSpecialize("    read X;\n    if ( X > 0 ) then\n      read Y;\n"
+                         "    else\n      Y = 0;\n    end;\n"
+                         "    read Z;\n    write Y, Z;\n",
+                         {1, 2, 3}, "    Y = 2;\n    Z = 3;\n"
+                                    "    write Y, Z;\n") == 3);
+  }
+
+  TEST_CASE("stops at reads whose turn depends on the run") {
+    CHECK(testSpecialize("    read Y;\n    X = 0;\n    while ( X < Y ) loop\n"
+                         "      X = X + 1;\n    end;\n    if ( X > 1 ) then\n"
+                         "      read Z;\n    end;\n    read Z;\n"
+                         "    write Z;\n",
+                         {5, 1, 2},
+                         "    X = 0;\n    while ( X < 5 ) loop\n"
+                         "      X = X + 1;\n    end;\n    if ( X > 1 ) then\n"
+                         "      read Z;\n    end;\n    read Z;\n"
+                         "    write Z;\n") == 1);
+    CHECK(testSpecialize("    X = 0;\n    Y = 0;\n    while ( X < 3 ) loop\n"
+                         "      read Y;\n      X = X + 1;\n    end;\n"
+                         "    write Y;\n",
+                         {1, 2, 3},
+                         "    X = 0;\n    Y = 0;\n    while ( X < 3 ) loop\n"
+                         "      read Y;\n      X = X + 1;\n    end;\n"
+                         "    write Y;\n") == 0);
+  }
+
+  TEST_CASE("runs residual programs like the original") {
+    std::string Source =
+        "program int N, I, S, X; begin read N; S = 0; I = 0; "
+        "while (I < N) loop read X; S = S + X * N; I = I + 1; end; "
+        "write S; end";
+    AST Original, Residual;
+    Parser P = *Parser::CreateFromString(Source, Original);
+    P.Parse();
+    Parser R = *Parser::CreateFromString(Source, Residual);
+    R.Parse();
+    OptStats S;
+    CHECK(Residual.Specialize({3}, S) == 1);
+
+    std::istringstream OriginalIn("3 1 2 3"), ResidualIn("1 2 3");
+    std::ostringstream OriginalOut, ResidualOut;
+    Original.Execute(OriginalIn, OriginalOut);
+    Residual.Execute(ResidualIn, ResidualOut);
+    // The known value is no longer asked for.
+    CHECK(OriginalOut.str() == "N =? " + ResidualOut.str());
+    CHECK(ResidualOut.str() == "X =? X =? X =? S = 18\n");
+  }
+
+  TEST_CASE("evaluates expressions reshaped by the optimizer") {
+    // Every operand shape of every operator, before and after the factors
+    // turn into literals and the checks are removed.
+    std::string Source =
+        "program int A, B, C, D; begin read A; B = 3; "
+        "C = A + B - 2 * (A - 1) * B + (7 - A) * 4 - (A * B); D = 0; "
+        "if (C < A) then D = D + 1; end; if (B > 2) then D = D + 2; end; "
+        "if (A <= C) then D = D + 4; end; if (C >= 50) then D = D + 8; end; "
+        "if (A == 5) then D = D + 16; end; if ((B * 2) != A) then "
+        "D = D + 32; end; write C, D; "
+        "C = 99999999 * 99999999 + A; end";
+    std::string Error = "Runtime Error [Line 1:327] at token: \"99999999\". "
+                        "Performing multiplication here will cause overflow "
+                        "and unexpected behavior.";
+    for (int Optimize = 0; Optimize < 2; ++Optimize) {
+      AST A;
+      Parser P = *Parser::CreateFromString(Source, A);
+      P.Parse();
+      if (Optimize) {
+        OptStats S;
+        A.Fold();
+        A.Prune(S);
+        A.AnalyzeRanges(S);
+      }
+      std::istringstream In("5");
+      std::ostringstream Out;
+      CHECK_THROWS_WITH(A.Execute(In, Out), Error.c_str());
+      CHECK(Out.str() == "A =? C = -9\nD = 51\n");
+    }
+  }
+}
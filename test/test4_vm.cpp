@@ -0,0 +1,652 @@
+//===--- test_vm.cpp ------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Runs bytecode compiler and virtual machine tests.
+//
+//===----------------------------------------------------------------------===//
+
+#include "doctest.h"
+
+#include "core/AST/AST.h"
+#include "core/AST/OptStats.h"
+#include "core/Exec/Tiers.h"
+#include "core/IR/CodeGen.h"
+#include "core/IR/IR.h"
+#include "core/IR/PassManager.h"
+#include "core/Parser/Parser.h"
+#include "core/VM/Compiler.h"
+#include "core/VM/LaneVM.h"
+#include "core/VM/Trace.h"
+#include "core/VM/VM.h"
+
+#include <iostream> // std::cin, std::cout
+#include <sstream>  // std::istringstream, std::ostringstream
+#include <vector>   // std::vector
+
+/// Walks the tree of `Source` with `Input` as the user input. Returns the
+/// output followed by any error.
+std::string runTree(std::string Source, std::string Input,
+                    bool DeferChecks = false, bool ClosedForm = false,
+                    bool ShortCircuit = true) {
+  std::istringstream In(Input);
+  std::ostringstream Out;
+  std::streambuf *OldIn = std::cin.rdbuf(In.rdbuf());
+  std::streambuf *OldOut = std::cout.rdbuf(Out.rdbuf());
+  try {
+    AST A;
+    Parser P = *Parser::CreateFromString(Source, A);
+    P.Parse();
+    if (ClosedForm) {
+      OptStats S;
+      A.FindInductions(S);
+    }
+    A.Execute(DeferChecks, ShortCircuit);
+  } catch (std::string &Error) {
+    Out << Error;
+  }
+  std::cin.rdbuf(OldIn);
+  std::cout.rdbuf(OldOut);
+  return Out.str();
+}
+
+/// Compiles `Source` and prints the resulting bytecode.
+std::string compileVM(std::string Source, bool Hoist = true,
+                      bool Fuse = false, bool Ranges = false,
+                      unsigned Unroll = 1) {
+  AST A;
+  Parser P = *Parser::CreateFromString(Source, A);
+  P.Parse();
+  if (Ranges) {
+    OptStats S;
+    A.AnalyzeRanges(S);
+  }
+  Compiler C(Hoist, Fuse, true, Unroll);
+  A.Compile(C);
+  Program *Bytecode = C.Finish();
+
+  std::ostringstream X;
+  Bytecode->Print(X);
+  delete Bytecode;
+  return X.str();
+}
+
+/// Compiles and runs `Source` on the virtual machine with `Input` as the user
+/// input. Returns the output followed by any error.
+std::string runVM(std::string Source, std::string Input, bool Hoist = true,
+                  bool Ranges = false, bool ClosedForm = false,
+                  bool Fuse = false, bool ShortCircuit = true,
+                  unsigned Unroll = 1) {
+  std::istringstream In(Input);
+  std::ostringstream Out;
+  try {
+    AST A;
+    Parser P = *Parser::CreateFromString(Source, A);
+    P.Parse();
+    if (Ranges) {
+      OptStats S;
+      A.AnalyzeRanges(S);
+    }
+    if (ClosedForm) {
+      OptStats S;
+      A.FindInductions(S);
+    }
+    Compiler C(Hoist, Fuse, ShortCircuit, Unroll);
+    A.Compile(C);
+    Program *Bytecode = C.Finish();
+    VM(*Bytecode, In, Out).Execute();
+    delete Bytecode;
+  } catch (std::string &Error) {
+    Out << Error;
+  }
+  return Out.str();
+}
+
+/// Runs `Source` with tiering, compiling loops after `Threshold` iterations,
+/// with `Input` as the user input. Returns the output followed by any error.
+std::string runTiered(std::string Source, std::string Input,
+                      unsigned Threshold, bool ShortCircuit = true,
+                      bool Background = false, bool Trace = false) {
+  std::istringstream In(Input);
+  std::ostringstream Out;
+  try {
+    AST A;
+    Parser P = *Parser::CreateFromString(Source, A);
+    P.Parse();
+    Tiers T(A, Threshold, ShortCircuit, Background);
+    T.setTracing(Trace);
+    T.Execute(In, Out);
+  } catch (std::string &Error) {
+    Out << Error;
+  }
+  return Out.str();
+}
+
+/// Lowers `Source` to SSA form, optionally runs the passes and runs the
+/// generated bytecode with `Input` as the user input. Returns the output
+/// followed by any error.
+std::string runIR(std::string Source, std::string Input, bool Passes = true,
+                  bool Ranges = false, bool Fuse = true,
+                  bool ShortCircuit = true) {
+  std::istringstream In(Input);
+  std::ostringstream Out;
+  try {
+    AST A;
+    Parser P = *Parser::CreateFromString(Source, A);
+    P.Parse();
+    if (Ranges) {
+      OptStats S;
+      A.AnalyzeRanges(S);
+    }
+    Function F;
+    A.Lower(F, ShortCircuit);
+    if (Passes) {
+      PassManager().Run(F);
+    }
+    Program *Bytecode = CodeGen::Generate(F, Fuse);
+    VM(*Bytecode, In, Out).Execute();
+    delete Bytecode;
+  } catch (std::string &Error) {
+    Out << Error;
+  }
+  return Out.str();
+}
+
+/// Checks that every engine and option behaves exactly like the tree walker.
+void testVM(std::string Source, std::string Input) {
+  std::string Expected = runTree(Source, Input);
+  CHECK(runTree(Source, Input, true) == Expected);
+  CHECK(runVM(Source, Input) == Expected);
+  CHECK(runVM(Source, Input, false) == Expected);
+  CHECK(runVM(Source, Input, true, true) == Expected);
+  CHECK(runTree(Source, Input, false, true) == Expected);
+  CHECK(runVM(Source, Input, true, true, true) == Expected);
+  CHECK(runVM(Source, Input, true, false, false, true) == Expected);
+  CHECK(runVM(Source, Input, true, true, true, true) == Expected);
+  CHECK(runVM(Source, Input, true, true, false, true, true, 3) == Expected);
+  CHECK(runVM(Source, Input, true, true, true, true, true, 4) == Expected);
+  CHECK(runTiered(Source, Input, 1) == Expected);
+  CHECK(runTiered(Source, Input, 3) == Expected);
+  CHECK(runTiered(Source, Input, 2, true, true) == Expected);
+  CHECK(runTiered(Source, Input, 1, true, false, true) == Expected);
+  CHECK(runTiered(Source, Input, 2, true, false, true) == Expected);
+  CHECK(runIR(Source, Input, false) == Expected);
+  CHECK(runIR(Source, Input) == Expected);
+  CHECK(runIR(Source, Input, true, true, false) == Expected);
+
+  std::string Eager = runTree(Source, Input, false, false, false);
+  CHECK(runVM(Source, Input, true, false, false, false, false) == Eager);
+  CHECK(runVM(Source, Input, true, false, false, true, false) == Eager);
+  CHECK(runTiered(Source, Input, 1, false) == Eager);
+  CHECK(runIR(Source, Input, true, true, true, false) == Eager);
+}
+
+/// Runs `Source` for all of `Inputs` at once on a `LaneVM`, with and without
+/// superinstructions and range analysis, and checks every lane against a run
+/// of its own on the virtual machine.
+template <unsigned Lanes>
+void testLanes(std::string Source, std::vector<std::string> Inputs) {
+  for (bool Optimize : {false, true}) {
+    AST A;
+    Parser P = *Parser::CreateFromString(Source, A);
+    P.Parse();
+    if (Optimize) {
+      OptStats S;
+      A.AnalyzeRanges(S);
+      A.FindInductions(S);
+    }
+    Compiler C(true, Optimize);
+    A.Compile(C);
+    Program *Bytecode = C.Finish();
+
+    std::vector<std::istringstream> Ins(Inputs.size());
+    std::vector<std::ostringstream> Outs(Inputs.size());
+    std::vector<std::istream *> InPtrs;
+    std::vector<std::ostream *> OutPtrs;
+    for (unsigned L = 0; L < Inputs.size(); ++L) {
+      Ins[L].str(Inputs[L]);
+      InPtrs.push_back(&Ins[L]);
+      OutPtrs.push_back(&Outs[L]);
+    }
+    std::vector<std::string> Errors =
+        LaneVM<Lanes>(*Bytecode).Execute(InPtrs, OutPtrs);
+    delete Bytecode;
+
+    REQUIRE(Errors.size() == Inputs.size());
+    for (unsigned L = 0; L < Inputs.size(); ++L) {
+      CHECK(Outs[L].str() + Errors[L] ==
+            runVM(Source, Inputs[L], true, Optimize, Optimize, Optimize));
+    }
+  }
+}
+
+TEST_SUITE("vm") {
+  //===--------------------------------------------------------------------===//
+  // Lowering.
+  //===--------------------------------------------------------------------===//
+  TEST_CASE("runs arithmetic, conditions and loops") {
+    std::string Source =
+        "program int X, Y, Z, N, A, B; begin read N, A, B; X = 0; Y = 0; "
+        "Z = 0; while (X < N) loop Y = A * B + X; if [ (X > 1) and !(A == B) "
+        "] then Z = Z + A * B - 1; else Z = Z + 1; end; X = X + 1; end; "
+        "write X, Y, Z; end";
+    testVM(Source, "5 3 4");
+    testVM(Source, "0 3 3");
+    testVM(Source, "9 7 7");
+  }
+
+  TEST_CASE("reports runtime errors like the tree walker") {
+    testVM("program int X; begin X = 99999999; X = X * X; end", "");
+    testVM("program int X; begin X = 0 - 99999999; X = X * 99999; end", "");
+    testVM("program int X; begin X = 3; X = X * (0 - 1); end", "");
+    testVM("program int X; begin read X; write X; end", "abc");
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Loop-invariant code motion.
+  //===--------------------------------------------------------------------===//
+  TEST_CASE("hoists loop-invariant expressions") {
+    std::string Source = "program int X, A, B; begin read A, B; X = 0; while "
+                         "(X < 10) loop X = X + A * B; end; end";
+    CHECK(compileVM(Source).find("jump_if_true") != std::string::npos);
+    CHECK(compileVM(Source, false).find("jump_if_true") == std::string::npos);
+    testVM(Source, "1 2");
+  }
+
+  TEST_CASE("does not hoist expressions written by the loop") {
+    std::string Source = "program int X, A; begin read A; X = 0; while "
+                         "(X < 3) loop read A; X = X + A * 2; write X; end; end";
+    CHECK(compileVM(Source).find("jump_if_true") == std::string::npos);
+    testVM(Source, "1 2 3 4");
+  }
+
+  TEST_CASE("recomputes hoisted expressions when a loop is re-entered") {
+    testVM("program int X, Y, A; begin A = 1; X = 0; while (X < 3) loop "
+           "Y = 0; while (Y < 2) loop write Y; Y = Y + A * 2; end; A = A + 1; "
+           "X = X + 1; end; end",
+           "");
+  }
+
+  TEST_CASE("reports hoisted overflow when it is first reached") {
+    std::string Source =
+        "program int X, Y, N; begin read N; X = 0; Y = 0; while (X < N) loop "
+        "write X; if (X > 2) then Y = N * 99999999; end; X = X + 1; end; end";
+    testVM(Source, "5");
+    CHECK(runVM(Source, "5").find("X = 3") != std::string::npos);
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Superinstructions.
+  //===--------------------------------------------------------------------===//
+  TEST_CASE("selects superinstructions") {
+    std::string Source = "program int X, Y; begin read Y; X = 0; while "
+                         "(X < Y) loop X = X + 1; if (X == 3) then "
+                         "Y = 1 + Y; end; end; write X, Y; end";
+    CHECK(compileVM(Source, true, true) == "; r0 = X\n"
+                                           "; r1 = Y\n"
+                                           "; r2 = #0\n"
+                                           "; r3 = #3\n"
+                                           "    0: read            r1\n"
+                                           "    1: move            r0, r2\n"
+                                           "    2: clear           {}\n"
+                                           "    3: jump_unless_lt  r0, r1, @8\n"
+                                           "    4: add_imm         r0, r0, #1\n"
+                                           "    5: jump_unless_eq  r0, r3, @7\n"
+                                           "    6: add_imm         r1, r1, #1\n"
+                                           "    7: jump            @3\n"
+                                           "    8: write           r0\n"
+                                           "    9: write           r1\n"
+                                           "   10: halt\n");
+    testVM(Source, "6");
+  }
+
+  TEST_CASE("reports fused overflow like the tree walker") {
+    testVM("program int X; begin X = 99999999 * 21; X = X + 99999999; end",
+           "");
+    testVM("program int X; begin X = 0 - 99999999 * 21; X = X - 99999999; "
+           "end",
+           "");
+    testVM("program int X, Y; begin read X; Y = 3; Y = 5 + X; write Y; end",
+           "2147483647");
+  }
+
+  TEST_CASE("counts executed instructions") {
+    AST A;
+    Parser P = *Parser::CreateFromString(
+        "program int X; begin X = 0; while (X < 4) loop X = X + 1; end; end",
+        A);
+    P.Parse();
+    Compiler C;
+    A.Compile(C);
+    Program *Bytecode = C.Finish();
+    std::istringstream In;
+    std::ostringstream Out;
+    std::vector<unsigned long long> Counts;
+    VM Machine(*Bytecode, In, Out);
+    Machine.setProfile(&Counts);
+    Machine.Execute();
+    delete Bytecode;
+
+    // move, clear, jump_unless_lt, add_imm, jump, halt.
+    REQUIRE(Counts.size() == 6);
+    CHECK(Counts[2] == 5);
+    CHECK(Counts[3] == 4);
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Short-circuit conditions.
+  //===--------------------------------------------------------------------===//
+  TEST_CASE("skips the side of a condition that can not change it") {
+    std::string Source = "program int X, Y; begin read X; Y = 0; "
+                         "if [ (X > 0) and ((X * X) > 1) ] then Y = 1; end; "
+                         "if [ (X < 0) or ((X * X) > 1) ] then Y = Y + 2; end; "
+                         "write Y; end";
+    testVM(Source, "-99999");
+    testVM(Source, "3");
+    CHECK(runTree(Source, "-99999") == "X =? Y = 2\n");
+    CHECK(runTree(Source, "-99999", false, false, false) ==
+          "X =? Runtime Error [Line 1:59] at token: \"X\". Performing "
+          "multiplication here will cause underflow and unexpected behavior.");
+
+    // No boolean is computed, only jumps.
+    std::string Bytecode = compileVM(Source, true, true);
+    CHECK(Bytecode.find(": and") == std::string::npos);
+    CHECK(Bytecode.find(": or") == std::string::npos);
+  }
+
+  TEST_CASE("lowers nested conditions to jumps") {
+    std::string Source = "program int X, Y, Z; begin read X, Y; Z = 0; "
+                         "while [ !([ (X > 5) or (Y < 2) ]) and "
+                         "[ (X == Y) or !(Y > X) ] ] loop X = X + 1; "
+                         "Z = Z + 1; end; if ![ !(X == 3) and (Y > 0) ] then "
+                         "Z = Z * 10; end; write X, Z; end";
+    testVM(Source, "0 0");
+    testVM(Source, "3 3");
+    testVM(Source, "3 4");
+    testVM(Source, "4 2");
+    testVM(Source, "9 9");
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Value-range analysis.
+  //===--------------------------------------------------------------------===//
+  TEST_CASE("skips checks proven safe") {
+    std::string Source = "program int X, Y; begin X = 0; while (X < 10) loop "
+                         "X = X + 1; Y = X * 3; write Y; end; end";
+    AST A;
+    Parser P = *Parser::CreateFromString(Source, A);
+    P.Parse();
+    OptStats S;
+    A.AnalyzeRanges(S);
+    Compiler C;
+    A.Compile(C);
+    Program *Bytecode = C.Finish();
+    std::ostringstream X;
+    Bytecode->Print(X);
+    delete Bytecode;
+    CHECK(X.str().find("add_unchecked") != std::string::npos);
+    CHECK(X.str().find("mul_unchecked") != std::string::npos);
+    testVM(Source, "");
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Deferred overflow checks.
+  //===--------------------------------------------------------------------===//
+  TEST_CASE("reports intermediate overflow with deferred checks") {
+    // The result fits in an `int` but `X * X` does not.
+    std::string Source = "program int X, Y; begin read X; Y = X * X - X * X; "
+                         "write Y; end";
+    testVM(Source, "99999");
+    testVM(Source, "9");
+    CHECK(runTree(Source, "99999", true).find("[Line 1:37] at token: \"X\". "
+                                              "Performing multiplication") !=
+          std::string::npos);
+  }
+
+  TEST_CASE("reports the first failing operation with deferred checks") {
+    testVM("program int X, Y; begin read X; if ((X * 3 + (X * X)) > 0) then "
+           "Y = 1; else Y = 2; end; write Y; end",
+           "999999999");
+    testVM("program int X, Y; begin read X, Y; Y = Y * X + 1; write Y; end",
+           "-2 5");
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Closed-form loops.
+  //===--------------------------------------------------------------------===//
+  TEST_CASE("skips iterations of counting loops") {
+    std::string Up = "program int I, N, S, K; begin read N, K; I = 0; S = 7; "
+                     "while (I < N) loop S = S + K; I = I + 1; end; "
+                     "write I, S; end";
+    testVM(Up, "1000 3");
+    testVM(Up, "0 3");
+    testVM(Up, "1000 0");
+    testVM(Up, "1000 -9");
+
+    std::string Down = "program int I, N, S; begin read I, N; S = 0; "
+                       "while (N <= I) loop I = I - 3; S = 2 + S; S = S - 1; "
+                       "end; write I, S; end";
+    testVM(Down, "1000 1");
+    testVM(Down, "1000 1000");
+
+    std::string NotEqual = "program int I, N; begin read I, N; "
+                           "while (I != N) loop I = I + 4; end; write I; end";
+    testVM(NotEqual, "0 400");
+    testVM(NotEqual, "2147483600 2147483644");
+  }
+
+  TEST_CASE("reports overflow of skipped loops at the same token") {
+    // The accumulator overflows part way through the loop.
+    std::string Source = "program int I, S; begin I = 0; S = 0; "
+                         "while (I < 99999999) loop S = S + 99999; I = I + 1; "
+                         "end; write S; end";
+    testVM(Source, "");
+    CHECK(runTree(Source, "", false, true) ==
+          "Runtime Error [Line 1:69] at token: \"S\". Performing addition "
+          "here will cause overflow and unexpected behavior.");
+
+    // So does the counter of a loop that never ends.
+    testVM("program int I; begin I = 5; while (I > 0) loop I = I + 9999; "
+           "end; end",
+           "");
+    testVM("program int I; begin I = 0 - 5; while (I < 0) loop "
+           "I = I - 9999; end; end",
+           "");
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Loop unrolling.
+  //===--------------------------------------------------------------------===//
+  TEST_CASE("unrolls small loop bodies") {
+    std::string Source = "program int X, Y; begin read X; Y = 0; "
+                         "while (X > 0) loop Y = Y + X; X = X - 1; end; "
+                         "write Y; end";
+    std::string Bytecode = compileVM(Source, true, true, true, 4);
+    unsigned Tests = 0;
+    for (size_t At = Bytecode.find("jump_unless_gt"); At != std::string::npos;
+         At = Bytecode.find("jump_unless_gt", At + 1)) {
+      ++Tests;
+    }
+    CHECK(Tests == 4);
+    for (const char *Input : {"0", "1", "3", "4", "5", "99999"}) {
+      testVM(Source, Input);
+    }
+  }
+
+  TEST_CASE("fully unrolls loops with a known trip count") {
+    std::string Source = "program int I, S, X; begin read X; I = 0; S = 0; "
+                         "while (I < 5) loop S = S + I * X; I = I + 1; end; "
+                         "write S; end";
+    std::string Bytecode = compileVM(Source, true, true, true, 4);
+    CHECK(Bytecode.find("jump") == std::string::npos);
+    CHECK(compileVM(Source, true, true, true).find("jump") !=
+          std::string::npos);
+    testVM(Source, "9");
+    testVM(Source, "999999999");
+
+    // The copies would not fit, so only the first iteration is peeled.
+    Source = "program int I, S; begin I = 0; S = 0; while (I < 60) loop "
+             "S = S + I * I * I + I * 7 + I * I - 3; I = I + 1; end; "
+             "write S; end";
+    CHECK(compileVM(Source, true, true, true, 2).find("jump") !=
+          std::string::npos);
+    testVM(Source, "");
+  }
+
+  TEST_CASE("keeps conditions that can overflow when unrolling") {
+    std::string Source = "program int I, S; begin I = 0; S = 0; "
+                         "while ((I * 99999) < 5) loop S = S + 1; I = I + 1; "
+                         "end; write S; end";
+    CHECK(compileVM(Source, true, true, true, 4).find("mul") !=
+          std::string::npos);
+    testVM(Source, "");
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Lockstep lanes.
+  //===--------------------------------------------------------------------===//
+  TEST_CASE("runs diverging lanes like separate machines") {
+    // Every lane loops a different number of times and takes both sides of
+    // the `if`.
+    std::string Source =
+        "program int X, Y, Z, N; begin read N; X = 0; Y = 1; Z = 0; "
+        "while (X < N) loop if [ (X > 2) or ((X * 2) == N) ] then "
+        "Y = Y * 3; else Z = Z - X; end; X = X + 1; end; write X, Y, Z; end";
+    std::vector<std::string> Inputs;
+    for (int N = 0; N < 16; ++N) {
+      Inputs.push_back(std::to_string(N * 2 % 11));
+    }
+    testLanes<16>(Source, Inputs);
+    Inputs.resize(8);
+    testLanes<8>(Source, Inputs);
+  }
+
+  TEST_CASE("stops only the lanes that fail") {
+    // Lanes past 19 iterations overflow, "x" is not a number.
+    std::string Source = "program int X, Y; begin read X; Y = 1; "
+                         "while (X > 0) loop Y = 3 * Y; X = X - 1; end; "
+                         "write Y; read X; write X; end";
+    testLanes<8>(Source, {"3 1", "25 1", "19 4", "x", "0 0", "21 1", "2 y"});
+    testLanes<16>(Source, {"30 1", "1 1"});
+    testLanes<8>(Source, {});
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Tiering.
+  //===--------------------------------------------------------------------===//
+  TEST_CASE("moves hot loops to bytecode") {
+    // The inner loop turns hot during the fourth outer iteration, the outer
+    // loop right after.
+    std::string Source =
+        "program int I, J, S; begin I = 0; S = 0; while (I < 6) loop J = 0; "
+        "while (J < I) loop S = S + J; J = J + 1; end; I = I + 1; end; "
+        "write S; end";
+    testVM(Source, "");
+
+    AST A;
+    Parser P = *Parser::CreateFromString(Source, A);
+    P.Parse();
+    Tiers T(A, 4, true, false);
+    for (unsigned Run = 0; Run < 2; ++Run) {
+      std::istringstream In;
+      std::ostringstream Out;
+      T.Execute(In, Out);
+      CHECK(Out.str() == "S = 20\n");
+    }
+    CHECK(T.getStats().LoopsCompiled == 2);
+    // The inner and then the outer loop in the first run, the outer loop right
+    // away in the second.
+    CHECK(T.getStats().Transfers == 3);
+  }
+
+  TEST_CASE("switches to loops compiled in the background") {
+    std::string Source = "program int I, S; begin I = 0; S = 0; "
+                         "while (I < 200000) loop S = S + 1; I = I + 1; end; "
+                         "write S; end";
+    AST A;
+    Parser P = *Parser::CreateFromString(Source, A);
+    P.Parse();
+    Tiers T(A, 10);
+    std::istringstream In;
+    std::ostringstream Out;
+    T.Execute(In, Out);
+    CHECK(Out.str() == "S = 200000\n");
+    // The run did not wait, and long before it finished the bytecode was
+    // ready.
+    CHECK(T.getStats().StallTime == 0);
+    CHECK(T.getStats().LoopsCompiled == 1);
+    CHECK(T.getStats().Transfers == 1);
+  }
+
+  TEST_CASE("traces the hot path of compiled loops") {
+    // Positive inputs take the path traced in the second iteration, the rest
+    // leave the trace at its guard.
+    std::string Source =
+        "program int I, X, S; begin I = 0; S = 0; while (I < 8) loop read X; "
+        "if (X > 0) then S = S + X; else S = S - 100; end; I = I + 1; end; "
+        "write S; end";
+    std::string Inputs[] = {"1 2 3 4 5 6 7 8", "1 2 3 -4 5 -6 7 8",
+                            "-1 -2 -3 -4 -5 -6 -7 -8", "1 -2 3 4 5 6 7 -8"};
+    for (auto &Input : Inputs) {
+      testVM(Source, Input);
+    }
+
+    AST A;
+    Parser P = *Parser::CreateFromString(Source, A);
+    P.Parse();
+    Tiers T(A, 1, true, false);
+    T.setTracing(true);
+    for (auto &Input : Inputs) {
+      std::istringstream In(Input);
+      std::ostringstream Out;
+      T.Execute(In, Out);
+      CHECK(Out.str() == runTree(Source, Input));
+    }
+    CHECK(T.getStats().LoopsCompiled == 1);
+    CHECK(T.getStats().LoopsTraced == 1);
+  }
+
+  TEST_CASE("builds traces with guards") {
+    std::string Source =
+        "program int I, X; begin I = 0; while (I < 4) loop "
+        "if (I == 2) then X = 1; else X = 2; end; I = I + 1; end; end";
+    AST A;
+    Parser P = *Parser::CreateFromString(Source, A);
+    P.Parse();
+    Compiler C;
+    A.Compile(C);
+    Program *Code = C.Finish();
+
+    unsigned Head, BackEdge;
+    REQUIRE(Trace::FindLoop(*Code, Head, BackEdge));
+    CHECK(Code->Code[BackEdge].A == Head);
+
+    // Record the second iteration, which takes the else side.
+    std::istringstream In;
+    std::ostringstream Out;
+    VM Machine(*Code, In, Out);
+    std::vector<unsigned> Path;
+    Machine.setTrace(Head, &Path);
+    std::vector<int> Vars(Code->Names.size(), 0);
+    Machine.Execute(Vars);
+    REQUIRE(Machine.isStopped());
+    CHECK(Path.front() == Head);
+    CHECK(Path.back() == BackEdge);
+    CHECK(Vars[0] == 2);
+
+    Program *Traced = Trace::Build(*Code, Path);
+    REQUIRE(Traced != nullptr);
+    unsigned Start = Code->Code.size();
+    CHECK(Traced->Code[BackEdge].A == Start);
+    CHECK(Traced->Code.back().Op == OpCode::jump);
+    CHECK(Traced->Code.back().A == Start);
+    // Only the back-edge of the trace is an unconditional jump.
+    for (unsigned PC = Start; PC + 1 < Traced->Code.size(); ++PC) {
+      CHECK(Traced->Code[PC].Op != OpCode::jump);
+    }
+    // A path that is not one iteration is not traced.
+    Path.pop_back();
+    CHECK(Trace::Build(*Code, Path) == nullptr);
+    delete Traced;
+    delete Code;
+  }
+}
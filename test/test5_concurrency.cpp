@@ -0,0 +1,306 @@
+//===--- test_concurrency.cpp ---------------------------------------------===//
+//
+// Author: ケジ
+// Description: Runs tests executing one parsed program from many threads.
+//
+//===----------------------------------------------------------------------===//
+
+#include "doctest.h"
+
+#include "core/AST/AST.h"
+#include "core/AST/OptStats.h"
+#include "core/Exec/Batch.h"
+#include "core/Exec/Coordinator.h"
+#include "core/Exec/Scheduler.h"
+#include "core/Exec/Tiers.h"
+#include "core/Parser/Parser.h"
+#include "core/VM/Compiler.h"
+#include "core/VM/LaneVM.h"
+#include "core/VM/VM.h"
+
+#include <csignal> // std::raise, SIGKILL
+#include <mutex>   // std::mutex, std::lock_guard
+#include <sstream> // std::istringstream, std::ostringstream
+#include <thread>  // std::thread
+#include <vector>  // std::vector
+
+/// A program whose output depends on its input, including whether it fails.
+static const char *Source =
+    "program int X, Y, Z; begin read X; Y = 0; Z = 1; while (Y < X) loop "
+    "Z = Z * 3; Y = Y + 1; end; write Y, Z; end";
+
+/// Runs the tree of `A` once with `Input`. Returns the output followed by any
+/// error.
+static std::string runOnce(const AST &A, int Input) {
+  std::istringstream In(std::to_string(Input));
+  std::ostringstream Out;
+  try {
+    A.Execute(In, Out);
+  } catch (std::string &Error) {
+    Out << Error;
+  }
+  return Out.str();
+}
+
+TEST_SUITE("concurrency") {
+  TEST_CASE("walks one tree from many threads") {
+    AST A;
+    Parser P = *Parser::CreateFromString(Source, A);
+    P.Parse();
+    OptStats S;
+    A.Fold();
+    A.Prune(S);
+    A.AnalyzeRanges(S);
+
+    // Inputs past 19 overflow.
+    std::vector<std::string> Expected;
+    for (int Input = 0; Input < 24; ++Input) {
+      Expected.push_back(runOnce(A, Input));
+    }
+
+    std::vector<std::vector<std::string>> Results(8);
+    std::vector<std::thread> Threads;
+    for (unsigned T = 0; T < Results.size(); ++T) {
+      Threads.push_back(std::thread([&A, &Results, T]() {
+        for (unsigned Round = 0; Round < 50; ++Round) {
+          for (int Input = 0; Input < 24; ++Input) {
+            Results[T].push_back(runOnce(A, Input));
+          }
+        }
+      }));
+    }
+    for (auto &Thread : Threads) {
+      Thread.join();
+    }
+
+    std::vector<std::string> Rounds;
+    for (unsigned Round = 0; Round < 50; ++Round) {
+      Rounds.insert(Rounds.end(), Expected.begin(), Expected.end());
+    }
+    for (auto &Result : Results) {
+      CHECK(Result == Rounds);
+    }
+  }
+
+  TEST_CASE("runs one program on many virtual machines") {
+    AST A;
+    Parser P = *Parser::CreateFromString(Source, A);
+    P.Parse();
+    Compiler C;
+    A.Compile(C);
+    const Program *Bytecode = C.Finish();
+
+    std::vector<std::string> Results(8);
+    std::vector<std::thread> Threads;
+    for (unsigned T = 0; T < Results.size(); ++T) {
+      Threads.push_back(std::thread([&Bytecode, &Results, T]() {
+        std::istringstream In(std::to_string(T * 3));
+        std::ostringstream Out;
+        try {
+          VM(*Bytecode, In, Out).Execute();
+        } catch (std::string &Error) {
+          Out << Error;
+        }
+        Results[T] = Out.str();
+      }));
+    }
+    for (auto &Thread : Threads) {
+      Thread.join();
+    }
+
+    for (unsigned T = 0; T < Results.size(); ++T) {
+      CHECK(Results[T] == runOnce(A, T * 3));
+    }
+    delete Bytecode;
+  }
+
+  TEST_CASE("runs a batch in input order") {
+    AST A;
+    Parser P = *Parser::CreateFromString(Source, A);
+    P.Parse();
+
+    // Uneven work, including records that fail, so that threads steal.
+    std::vector<std::string> Records;
+    std::string Expected;
+    for (int I = 0; I < 200; ++I) {
+      int Input = (I * 7) % 23;
+      Records.push_back(std::to_string(Input));
+      std::string Output = runOnce(A, Input);
+      // The batch ends every error with a new line.
+      if (Output.back() != '\n') Output += "\n";
+      Expected += Output;
+    }
+
+    Batch::Runner Run = [&A](std::istream &In, std::ostream &Out) {
+      A.Execute(In, Out);
+    };
+    for (unsigned Threads : {1, 3, 8}) {
+      std::ostringstream Out;
+      Batch(Run, Threads).Execute(Records, Out);
+      CHECK(Out.str() == Expected);
+    }
+
+    // The same records with loops moving to bytecode compiled in the
+    // background.
+    Tiers T(A, 5);
+    Batch::Runner Tiered = [&T](std::istream &In, std::ostream &Out) {
+      T.Execute(In, Out);
+    };
+    for (unsigned Threads : {1, 3}) {
+      std::ostringstream Out;
+      Batch(Tiered, Threads).Execute(Records, Out);
+      CHECK(Out.str() == Expected);
+    }
+
+    // The same records in groups of lanes, 200 not being a multiple of 16.
+    Compiler C;
+    A.Compile(C);
+    const Program *Bytecode = C.Finish();
+    Batch::LaneRunner Lanes = [Bytecode](
+        const std::vector<std::istream *> &Ins,
+        const std::vector<std::ostream *> &Outs) {
+      return LaneVM<16>(*Bytecode).Execute(Ins, Outs);
+    };
+    for (unsigned Threads : {1, 3}) {
+      std::ostringstream Out;
+      Batch(Lanes, 16, Threads).Execute(Records, Out);
+      CHECK(Out.str() == Expected);
+    }
+    delete Bytecode;
+  }
+
+  TEST_CASE("splits batch input into records") {
+    std::istringstream In("1 2\n3\n\n4\n");
+    std::vector<std::string> Records = Batch::ReadRecords(In);
+    REQUIRE(Records.size() == 4);
+    CHECK(Records[0] == "1 2");
+    CHECK(Records[2] == "");
+  }
+
+  TEST_CASE("schedules many instances on a few threads") {
+    AST A;
+    Parser P = *Parser::CreateFromString(Source, A);
+    P.Parse();
+
+    // A quantum of 3 iterations preempts most of the runs several times.
+    Scheduler S(4, 3);
+    std::vector<unsigned> Ids;
+    for (unsigned K = 0; K < 500; ++K) {
+      Ids.push_back(S.Spawn(A));
+    }
+    S.Wait();
+    for (unsigned Id : Ids) {
+      CHECK(S.getStatus(Id) == Scheduler::waiting);
+      CHECK(S.getWaiting(Id) == "X");
+      CHECK(S.getUsage(Id).Slices == 1);
+    }
+
+    for (unsigned K = 0; K < Ids.size(); ++K) {
+      S.Supply(Ids[K], K % 25);
+    }
+    S.Wait();
+    for (unsigned K = 0; K < Ids.size(); ++K) {
+      CHECK(S.getStatus(Ids[K]) == Scheduler::finished);
+      CHECK(S.TakeOutput(Ids[K]) + S.getError(Ids[K]) ==
+            runOnce(A, K % 25));
+    }
+
+    // 3^19 is the largest power that fits, so 19 iterations finish.
+    Scheduler::Usage Used = S.getUsage(Ids[19]);
+    CHECK(Used.Steps == 19);
+    CHECK(Used.Slices == 8);
+    CHECK(Used.Supplied == 1);
+  }
+
+  TEST_CASE("keeps a runaway instance from holding a thread") {
+    AST Runaway, Quick;
+    Parser P = *Parser::CreateFromString(
+        "program int X; begin X = 0; while (X < 1) loop X = X * 1; end; "
+        "end",
+        Runaway);
+    P.Parse();
+    Parser Q = *Parser::CreateFromString(Source, Quick);
+    Q.Parse();
+
+    std::mutex Lock;
+    std::vector<unsigned> Order;
+    Scheduler S(1, 100);
+    S.setListener([&](unsigned Id) {
+      std::lock_guard<std::mutex> Guard(Lock);
+      Order.push_back(Id);
+    });
+    unsigned Forever = S.Spawn(Runaway, 1000000);
+    unsigned Other = S.Spawn(Quick);
+    S.Supply(Other, 5);
+    S.Wait();
+
+    // The other instance parks and finishes while the runaway one is still
+    // going around its loop.
+    REQUIRE(Order.size() >= 2);
+    CHECK(Order.back() == Forever);
+    CHECK(S.TakeOutput(Other) == "X =? Y = 5\nZ = 243\n");
+    CHECK(S.getError(Forever) ==
+          "Runtime Error: The loops of the program went around more than "
+          "1000000 times, the step budget of the run.");
+    CHECK(S.getUsage(Forever).Slices > 1000);
+  }
+
+  TEST_CASE("drops instances that never finish") {
+    AST A;
+    Parser P = *Parser::CreateFromString(
+        "program int X; begin X = 0; while (X < 1) loop X = 0; end; end", A);
+    P.Parse();
+
+    // Destroying the scheduler returns once the current slices end.
+    Scheduler S(2, 1000);
+    for (unsigned K = 0; K < 4; ++K) {
+      CHECK(S.getStatus(S.Spawn(A)) == Scheduler::runnable);
+    }
+  }
+
+  TEST_CASE("runs a batch in worker processes") {
+    AST A;
+    Parser P = *Parser::CreateFromString(Source, A);
+    P.Parse();
+
+    std::string Records, Expected, Crashed;
+    for (int I = 0; I < 60; ++I) {
+      int Input = (I * 7) % 23;
+      Records += std::to_string(Input) + "\n";
+      std::string Output = runOnce(A, Input);
+      if (Output.back() != '\n') Output += "\n";
+      Expected += Output;
+      // The record 13 kills whichever worker runs it.
+      Crashed += Input != 13 ? Output
+                             : "Runtime Error: The worker running this record "
+                               "was killed by signal 9 (Killed).\n";
+    }
+
+    Batch::Runner Run = [&A](std::istream &In, std::ostream &Out) {
+      A.Execute(In, Out);
+    };
+    for (unsigned Processes : {1, 3}) {
+      std::istringstream In(Records);
+      std::ostringstream Out;
+      Coordinator C(Run, Processes);
+      C.Execute(In, Out);
+      CHECK(Out.str() == Expected);
+      CHECK(C.getRestarts() == 0);
+    }
+
+    Batch::Runner Fragile = [&A](std::istream &In, std::ostream &Out) {
+      int Value;
+      if (In >> Value && Value == 13) std::raise(SIGKILL);
+      In.clear();
+      In.seekg(0);
+      A.Execute(In, Out);
+    };
+    std::istringstream In(Records);
+    std::ostringstream Out;
+    Coordinator C(Fragile, 3);
+    C.Execute(In, Out);
+    CHECK(Out.str() == Crashed);
+    // 13 appears twice, each tried twice.
+    CHECK(C.getRestarts() == 4);
+  }
+}
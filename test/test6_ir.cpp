@@ -0,0 +1,330 @@
+//===--- test_ir.cpp ------------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Runs SSA form, optimization pass and code generation tests.
+//
+//===----------------------------------------------------------------------===//
+
+#include "doctest.h"
+
+#include "core/AST/AST.h"
+#include "core/AST/OptStats.h"
+#include "core/IR/CodeGen.h"
+#include "core/IR/IR.h"
+#include "core/IR/PassManager.h"
+#include "core/Parser/Parser.h"
+#include "core/VM/VM.h"
+
+#include <sstream> // std::istringstream, std::ostringstream
+#include <string>  // std::string
+#include <vector>  // std::vector
+
+/// Lowers `Source`, runs the passes named in `Passes` and prints the result.
+static std::string lowerIR(std::string Source,
+                           const std::vector<std::string> &Passes,
+                           bool Ranges = false) {
+  AST A;
+  Parser P = *Parser::CreateFromString(Source, A);
+  P.Parse();
+  if (Ranges) {
+    OptStats S;
+    A.AnalyzeRanges(S);
+  }
+  Function F;
+  A.Lower(F);
+  PassManager PM;
+  REQUIRE(PM.setOrder(Passes));
+  PM.Run(F);
+
+  std::ostringstream X;
+  F.Print(X);
+  return X.str();
+}
+
+/// Lowers `Source` with every pass, after the range analysis if `Ranges`, and
+/// runs it with `Input` as the user input.
+/// Returns the output followed by any error.
+static std::string runIR(std::string Source, std::string Input,
+                         bool Ranges = false) {
+  std::istringstream In(Input);
+  std::ostringstream Out;
+  try {
+    AST A;
+    Parser P = *Parser::CreateFromString(Source, A);
+    P.Parse();
+    if (Ranges) {
+      OptStats S;
+      A.AnalyzeRanges(S);
+    }
+    Function F;
+    A.Lower(F);
+    PassManager().Run(F);
+    Program *Bytecode = CodeGen::Generate(F);
+    VM(*Bytecode, In, Out).Execute();
+    delete Bytecode;
+  } catch (std::string &Error) {
+    Out << Error;
+  }
+  return Out.str();
+}
+
+/// Walks the tree of `Source` with `Input` as the user input. Returns the
+/// output followed by any error.
+static std::string runTree(std::string Source, std::string Input) {
+  std::istringstream In(Input);
+  std::ostringstream Out;
+  try {
+    AST A;
+    Parser P = *Parser::CreateFromString(Source, A);
+    P.Parse();
+    A.Execute(In, Out);
+  } catch (std::string &Error) {
+    Out << Error;
+  }
+  return Out.str();
+}
+
+/// All of the default passes.
+static const std::vector<std::string> All = {"copy-prop", "fold", "cse",
+                                             "strength-reduce", "dce"};
+
+/// A loop summing the numbers down from the input.
+static const char *Sum =
+    "program int X, Y; begin read X; Y = 0; while (X > 0) loop Y = Y + X; "
+    "X = X - 1; end; write Y; end";
+
+TEST_SUITE("ir") {
+  TEST_CASE("lowers to SSA form") {
+    CHECK(lowerIR(Sum, {}) == "bb0:\n"
+                              "  %10 = constant 1\n"
+                              "  %1 = constant 0\n"
+                              "  %0 = read X\n"
+                              "  %2 = copy Y %1\n"
+                              "  jump bb1\n"
+                              "bb1: ; preds bb0 bb2\n"
+                              "  %7 = phi Y %2 bb0, %9 bb2\n"
+                              "  %4 = phi X %0 bb0, %12 bb2\n"
+                              "  %5 = gt %4, %1\n"
+                              "  branch %5, bb2, bb3\n"
+                              "bb2: ; preds bb1\n"
+                              "  %8 = add %7, %4\n"
+                              "  %9 = copy Y %8\n"
+                              "  %11 = sub %4, %10\n"
+                              "  %12 = copy X %11\n"
+                              "  jump bb1\n"
+                              "bb3: ; preds bb1\n"
+                              "  write Y %7\n"
+                              "  ret\n");
+  }
+
+  TEST_CASE("propagates copies") {
+    CHECK(lowerIR(Sum, {"copy-prop"}) == "bb0:\n"
+                                         "  %10 = constant 1\n"
+                                         "  %1 = constant 0\n"
+                                         "  %0 = read X\n"
+                                         "  jump bb1\n"
+                                         "bb1: ; preds bb0 bb2\n"
+                                         "  %7 = phi Y %1 bb0, %8 bb2\n"
+                                         "  %4 = phi X %0 bb0, %11 bb2\n"
+                                         "  %5 = gt %4, %1\n"
+                                         "  branch %5, bb2, bb3\n"
+                                         "bb2: ; preds bb1\n"
+                                         "  %8 = add %7, %4\n"
+                                         "  %11 = sub %4, %10\n"
+                                         "  jump bb1\n"
+                                         "bb3: ; preds bb1\n"
+                                         "  write Y %7\n"
+                                         "  ret\n");
+  }
+
+  TEST_CASE("folds constants and decided branches") {
+    const char *Source = "program int X, Y; begin X = 2 * 3; if (X > 5) then "
+                         "Y = X; else Y = 0; end; write Y; end";
+    CHECK(lowerIR(Source, All) == "bb0:\n"
+                                  "  %15 = constant 6\n"
+                                  "  jump bb1\n"
+                                  "bb1: ; preds bb0\n"
+                                  "  jump bb3\n"
+                                  "bb3: ; preds bb1\n"
+                                  "  write Y %15\n"
+                                  "  ret\n");
+
+    // Without dead code elimination, the unreachable block stays.
+    CHECK(lowerIR(Source, {"copy-prop", "fold"}).find("bb2:\n") !=
+          std::string::npos);
+  }
+
+  TEST_CASE("simplifies identities") {
+    CHECK(lowerIR("program int X, Y; begin read X; Y = X + 0; Y = Y * 1; "
+                  "if (X == X) then write Y; end; end",
+                  All) == "bb0:\n"
+                          "  %0 = read X\n"
+                          "  jump bb1\n"
+                          "bb1: ; preds bb0\n"
+                          "  write Y %0\n"
+                          "  jump bb2\n"
+                          "bb2: ; preds bb1\n"
+                          "  ret\n");
+  }
+
+  TEST_CASE("eliminates common subexpressions") {
+    const char *Source = "program int X, Y, Z; begin read X; Y = X * X; "
+                         "Z = X * X; write Z; end";
+    CHECK(lowerIR(Source, {"copy-prop", "dce"}) == "bb0:\n"
+                                                   "  %0 = read X\n"
+                                                   "  %1 = mul %0, %0\n"
+                                                   "  %3 = mul %0, %0\n"
+                                                   "  write Z %3\n"
+                                                   "  ret\n");
+    CHECK(lowerIR(Source, {"copy-prop", "cse", "dce"}) ==
+          "bb0:\n"
+          "  %0 = read X\n"
+          "  %1 = mul %0, %0\n"
+          "  write Z %1\n"
+          "  ret\n");
+  }
+
+  TEST_CASE("numbers values across statements and blocks") {
+    // `C + A * B` is `A * B + C`; the `if` is dominated by the first one.
+    CHECK(lowerIR("program int A, B, C, X, Y, Z; begin read A, B, C; "
+                  "X = A * B + C; if (A > B) then Y = C + A * B; else Y = 0; "
+                  "end; Z = A * B + C; write X, Y, Z; end",
+                  All) == "bb0:\n"
+                          "  %12 = constant 0\n"
+                          "  %0 = read A\n"
+                          "  %1 = read B\n"
+                          "  %2 = read C\n"
+                          "  %3 = mul %0, %1\n"
+                          "  %4 = add %3, %2\n"
+                          "  %6 = gt %0, %1\n"
+                          "  branch %6, bb1, bb2\n"
+                          "bb1: ; preds bb0\n"
+                          "  jump bb3\n"
+                          "bb2: ; preds bb0\n"
+                          "  jump bb3\n"
+                          "bb3: ; preds bb1 bb2\n"
+                          "  %23 = phi Y %4 bb1, %12 bb2\n"
+                          "  write X %4\n"
+                          "  write Y %23\n"
+                          "  write Z %4\n"
+                          "  ret\n");
+
+    // A value computed on one side of an `if` is not available after it, and
+    // a read operand is a new value.
+    CHECK(lowerIR("program int A, B, X, Y; begin read A, B; if (A > B) then "
+                  "X = A * B; else X = 0; end; Y = A * B; read A; X = A * B; "
+                  "write X, Y; end",
+                  All) == "bb0:\n"
+                          "  %0 = read A\n"
+                          "  %1 = read B\n"
+                          "  %2 = gt %0, %1\n"
+                          "  branch %2, bb1, bb2\n"
+                          "bb1: ; preds bb0\n"
+                          "  %4 = mul %0, %1\n"
+                          "  jump bb3\n"
+                          "bb2: ; preds bb0\n"
+                          "  jump bb3\n"
+                          "bb3: ; preds bb1 bb2\n"
+                          "  %12 = mul %0, %1\n"
+                          "  %14 = read A\n"
+                          "  %15 = mul %14, %1\n"
+                          "  write X %15\n"
+                          "  write Y %12\n"
+                          "  ret\n");
+  }
+
+  TEST_CASE("keeps arithmetic that could fail") {
+    // The unused product is kept for its diagnostic.
+    CHECK(lowerIR("program int X, Y; begin read X; Y = X * X; end", All) ==
+          "bb0:\n"
+          "  %0 = read X\n"
+          "  %1 = mul %0, %0\n"
+          "  ret\n");
+
+    const char *Source = "program int X, Y, Z; begin read X; Y = X * X; "
+                         "write Y; Z = X * X; write Z; end";
+    CHECK(runIR(Source, "99999") == runTree(Source, "99999"));
+
+    // Only the first of the products reports, like in the tree.
+    Source = "program int X, Y, Z; begin read X; if (X > 0) then "
+             "Y = 1 + X * X; end; Z = X * X + 1; end";
+    CHECK(runIR(Source, "99999") == runTree(Source, "99999"));
+    CHECK(runIR(Source, "-99999") == runTree(Source, "-99999"));
+    CHECK(runIR("program int X; begin X = 99999999 * 99999999; end", "") ==
+          runTree("program int X; begin X = 99999999 * 99999999; end", ""));
+  }
+
+  TEST_CASE("reduces products of loop counters") {
+    const char *Source =
+        "program int I, K, X, S; begin I = 0; K = 7; S = 0; while (I < 100) "
+        "loop X = I * K; S = S + X; I = I + 1; end; write S; end";
+    CHECK(lowerIR(Source, All, true) == "bb0:\n"
+                                        "  %16 = constant 1\n"
+                                        "  %7 = constant 100\n"
+                                        "  %2 = constant 7\n"
+                                        "  %0 = constant 0\n"
+                                        "  jump bb1\n"
+                                        "bb1: ; preds bb0 bb2\n"
+                                        "  %23 = phi %0 bb0, %24 bb2\n"
+                                        "  %13 = phi S %0 bb0, %14 bb2\n"
+                                        "  %6 = phi I %0 bb0, %17 bb2\n"
+                                        "  %8 = lt %6, %7\n"
+                                        "  branch %8, bb2, bb3\n"
+                                        "bb2: ; preds bb1\n"
+                                        "  %14 = add %13, %23\n"
+                                        "  %17 = add unchecked %6, %16\n"
+                                        "  %24 = add unchecked %23, %2\n"
+                                        "  jump bb1\n"
+                                        "bb3: ; preds bb1\n"
+                                        "  write S %13\n"
+                                        "  ret\n");
+
+    // A checked product has to report in its own place.
+    CHECK(lowerIR(Source, All).find("mul") != std::string::npos);
+    CHECK(runIR(Source, "", true) == runTree(Source, ""));
+
+    // Counting down, with the product outside the range of the counter at
+    // the last step.
+    Source = "program int I, J, X, S; begin read J; I = 30; S = 0; "
+             "while (I > 0) loop X = I * 71582788; J = 0; while (J < 9) loop "
+             "S = S + J * 3 - X; J = J + 2; end; I = I - 3; end; write S; end";
+    CHECK(lowerIR(Source, All, true).find("mul") == std::string::npos);
+    CHECK(runIR(Source, "0", true) == runTree(Source, "0"));
+  }
+
+  TEST_CASE("orders and disables passes") {
+    PassManager PM;
+    CHECK_FALSE(PM.setOrder({"fold", "unknown"}));
+    CHECK_FALSE(PM.disable("unknown"));
+    REQUIRE(PM.setOrder({"dce", "fold"}));
+    CHECK(PM.getPasses()[0].Name == "dce");
+    CHECK(PM.getPasses()[1].Name == "fold");
+    CHECK_FALSE(PM.getPasses()[2].Enabled);
+    CHECK(PM.disable("fold"));
+    CHECK_FALSE(PM.getPasses()[1].Enabled);
+  }
+
+  TEST_CASE("times every pass") {
+    AST A;
+    Parser P = *Parser::CreateFromString(Sum, A);
+    P.Parse();
+    Function F;
+    A.Lower(F);
+    PassManager PM;
+    PM.disable("cse");
+    PM.Run(F);
+    CHECK(PM.getPasses()[0].Changes == 1);
+
+    std::ostringstream X;
+    PM.PrintTimings(X);
+    CHECK(X.str().find("Pass copy-prop:") != std::string::npos);
+    CHECK(X.str().find("Pass dce:") != std::string::npos);
+    CHECK(X.str().find("Pass cse:") == std::string::npos);
+  }
+
+  TEST_CASE("generates bytecode") {
+    for (const char *Input : {"0", "1", "5", "99999999"}) {
+      CHECK(runIR(Sum, Input) == runTree(Sum, Input));
+    }
+  }
+}
@@ -0,0 +1,385 @@
+//===--- test_exec.cpp ----------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Runs tests stopping, saving and continuing runs of a program,
+//   limiting how long they take and giving them input a value at a time.
+//
+//===----------------------------------------------------------------------===//
+
+#include "doctest.h"
+
+#include "core/AST/AST.h"
+#include "core/AST/Checkpoint.h"
+#include "core/AST/OptStats.h"
+#include "core/Exec/Budget.h"
+#include "core/Exec/Session.h"
+#include "core/Exec/Tiers.h"
+#include "core/Parser/Parser.h"
+#include "core/VM/Compiler.h"
+#include "core/VM/VM.h"
+
+#include <csignal> // std::sig_atomic_t
+#include <sstream> // std::istringstream, std::ostringstream
+#include <vector>  // std::vector
+
+/// A program that reads while nested in loops and branches.
+static const char *Source =
+    "program int N, I, J, S; begin read N; S = 0; I = 0; "
+    "while (I < N) loop J = 0; while (J < 3) loop "
+    "if (J == 1) then read S; else S = S + I * J; end; J = J + 1; end; "
+    "write S; I = I + 1; end; write I; end";
+
+static const char *Input = "3 10 20 30";
+
+TEST_SUITE("exec") {
+  TEST_CASE("continues from a checkpoint at every statement") {
+    AST A;
+    Parser P = *Parser::CreateFromString(Source, A);
+    P.Parse();
+
+    std::istringstream FullIn(Input);
+    std::ostringstream FullOut;
+    A.Execute(FullIn, FullOut);
+    std::string Expected = FullOut.str();
+
+    // Asking again while saving stops the run before every statement.
+    volatile std::sig_atomic_t Request = 1;
+    std::istringstream In(Input);
+    std::ostringstream Out;
+    std::vector<std::string> Files;
+    std::vector<size_t> Written;
+    A.Execute(In, Out, &Request, [&](const Checkpoint &CP) {
+      std::ostringstream File;
+      CP.Write(File);
+      Files.push_back(File.str());
+      Written.push_back(Out.str().size());
+      Request = 1;
+      return true;
+    });
+    CHECK(Out.str() == Expected);
+    CHECK(Files.size() == 44);
+
+    for (unsigned K = 0; K < Files.size(); ++K) {
+      std::istringstream File(Files[K]);
+      Checkpoint CP;
+      REQUIRE(Checkpoint::Read(File, CP));
+
+      std::istringstream ResumedIn(Input);
+      std::ostringstream ResumedOut;
+      A.Execute(ResumedIn, ResumedOut, nullptr, nullptr, &CP);
+      CHECK(Expected.substr(0, Written[K]) + ResumedOut.str() == Expected);
+    }
+  }
+
+  TEST_CASE("stops after a checkpoint when asked") {
+    AST A;
+    Parser P = *Parser::CreateFromString(Source, A);
+    P.Parse();
+
+    volatile std::sig_atomic_t Request = 1;
+    unsigned Statements = 0;
+    Checkpoint Saved;
+    std::istringstream In(Input);
+    std::ostringstream Out;
+    A.Execute(In, Out, &Request, [&](const Checkpoint &CP) {
+      // Stop before the 20th statement.
+      Request = ++Statements < 20;
+      if (Request) return true;
+      Saved = CP;
+      return false;
+    });
+    CHECK(Saved.Reads == 2);
+    CHECK(Out.str() == "N =? S =? S = 10\n");
+
+    // Unlike a pipe, the input is moved to where it was.
+    std::istringstream Rest(Input);
+    std::ostringstream RestOut;
+    A.Execute(Rest, RestOut, nullptr, nullptr, &Saved);
+    CHECK(RestOut.str() == "S =? S = 22\nS =? S = 34\nI = 3\n");
+  }
+
+  TEST_CASE("takes checkpoints at the end of each quantum") {
+    AST A;
+    Parser P = *Parser::CreateFromString(Source, A);
+    P.Parse();
+
+    std::istringstream FullIn(Input);
+    std::ostringstream FullOut;
+    A.Execute(FullIn, FullOut);
+
+    // Without a flag, only the budget stops the run: every 4 of its 12 steps.
+    unsigned Saved = 0;
+    Budget Sliced(0, 0, 4);
+    std::istringstream In(Input);
+    std::ostringstream Out;
+    A.Execute(
+        In, Out, nullptr,
+        [&](const Checkpoint &) {
+          ++Saved;
+          return true;
+        },
+        nullptr, false, true, &Sliced);
+    CHECK(Out.str() == FullOut.str());
+    CHECK(Saved == 3);
+  }
+
+  TEST_CASE("checks that a checkpoint fits the program") {
+    AST A;
+    Parser P = *Parser::CreateFromString(Source, A);
+    P.Parse();
+
+    Checkpoint CP;
+    CP.Program = A.getFingerprint();
+    CP.Slots.resize(4);
+    CP.Path = {3, 0, 7};
+    std::istringstream In(Input);
+    std::ostringstream Out;
+    CHECK_THROWS_WITH(A.Execute(In, Out, nullptr, nullptr, &CP),
+                      "The checkpoint does not match the program.");
+    CP.Path = {4, 1, 2, 0, 0};
+    CHECK_THROWS_WITH(A.Execute(In, Out, nullptr, nullptr, &CP),
+                      "The checkpoint does not match the program.");
+    CP.Slots.resize(5);
+    CP.Path = {0};
+    CHECK_THROWS_WITH(A.Execute(In, Out, nullptr, nullptr, &CP),
+                      "The checkpoint does not match the program.");
+
+    // A file cut short is not read.
+    std::ostringstream File;
+    CP.Write(File);
+    std::istringstream Short(File.str().substr(0, File.str().size() - 1));
+    CHECK_FALSE(Checkpoint::Read(Short, CP));
+  }
+
+  TEST_CASE("checks that a checkpoint was taken on the same tree") {
+    const char *Seven = "program int Y; begin Y = 7; write Y; end";
+    AST A;
+    Parser P = *Parser::CreateFromString(Seven, A);
+    P.Parse();
+
+    // Stop before `write Y`.
+    volatile std::sig_atomic_t Request = 1;
+    unsigned Statements = 0;
+    Checkpoint Saved;
+    std::istringstream In;
+    std::ostringstream Out;
+    A.Execute(In, Out, &Request, [&](const Checkpoint &CP) {
+      Saved = CP;
+      Request = 1;
+      return ++Statements < 2;
+    });
+    CHECK(Out.str() == "");
+    REQUIRE(Saved.Path == std::vector<unsigned>{1});
+
+    std::ostringstream File;
+    Saved.Write(File);
+    std::istringstream Written(File.str());
+    Checkpoint CP;
+    REQUIRE(Checkpoint::Read(Written, CP));
+    std::ostringstream SameOut;
+    A.Execute(In, SameOut, nullptr, nullptr, &CP);
+    CHECK(SameOut.str() == "Y = 7\n");
+
+    std::string Mismatch = "The checkpoint does not match the program.";
+    AST Edited;
+    Parser Q = *Parser::CreateFromString(
+        "program int Y; begin Y = 8; write Y; end", Edited);
+    Q.Parse();
+    CHECK_THROWS_WITH(Edited.Execute(In, Out, nullptr, nullptr, &CP),
+                      Mismatch.c_str());
+
+    // The layout does not matter, but the passes and the options do.
+    AST Spaced;
+    Parser R = *Parser::CreateFromString(
+        "program\n  int Y;\nbegin\n  Y = 7;\n  write Y;\nend\n", Spaced);
+    R.Parse();
+    CHECK_NOTHROW(Spaced.Execute(In, Out, nullptr, nullptr, &CP));
+    CHECK_THROWS_WITH(A.Execute(In, Out, nullptr, nullptr, &CP, false, false),
+                      Mismatch.c_str());
+    Spaced.Fold();
+    CHECK_THROWS_WITH(Spaced.Execute(In, Out, nullptr, nullptr, &CP),
+                      Mismatch.c_str());
+  }
+
+  TEST_CASE("stops loops that exceed the step budget") {
+    AST A;
+    Parser P = *Parser::CreateFromString(Source, A);
+    P.Parse();
+
+    // 3 outer and 9 inner iterations go around 12 times.
+    std::istringstream In(Input);
+    std::ostringstream Out;
+    Budget Enough(12, 0);
+    A.Execute(In, Out, false, true, nullptr, &Enough);
+    CHECK(Out.str() == "N =? S =? S = 10\nS =? S = 22\nS =? S = 34\nI = 3\n");
+    CHECK(Enough.getSteps() == 12);
+
+    std::string Exceeded = "Runtime Error: The loops of the program went "
+                           "around more than 11 times, the step budget of "
+                           "the run.";
+    std::istringstream ShortIn(Input);
+    std::ostringstream ShortOut;
+    Budget Short(11, 0);
+    CHECK_THROWS_WITH(
+        A.Execute(ShortIn, ShortOut, false, true, nullptr, &Short),
+        Exceeded.c_str());
+    CHECK(ShortOut.str() == "N =? S =? S = 10\nS =? S = 22\nS =? S = 34\n");
+
+    // The bytecode spends the same steps.
+    Compiler C;
+    A.Compile(C);
+    Program *Bytecode = C.Finish();
+    std::istringstream VMIn(Input);
+    std::ostringstream VMOut;
+    Budget VMShort(11, 0);
+    VM Machine(*Bytecode, VMIn, VMOut);
+    Machine.setBudget(&VMShort);
+    CHECK_THROWS_WITH(Machine.Execute(), Exceeded.c_str());
+    CHECK(VMOut.str() == ShortOut.str());
+    delete Bytecode;
+  }
+
+  TEST_CASE("spends the iterations skipped in closed form") {
+    AST A;
+    Parser P = *Parser::CreateFromString(
+        "program int N, X, Z; begin read N; X = 0; Z = 0; "
+        "while (X < N) loop X = X + 1; Z = Z + 2; end; write Z; end",
+        A);
+    P.Parse();
+    OptStats S;
+    A.FindInductions(S);
+    REQUIRE(S.ClosedFormLoops == 1);
+
+    std::string Exceeded = "Runtime Error: The loops of the program went "
+                           "around more than 99999 times, the step budget of "
+                           "the run.";
+    std::istringstream In("100000");
+    std::ostringstream Out;
+    Budget Enough(100000, 0);
+    A.Execute(In, Out, false, true, nullptr, &Enough);
+    CHECK(Out.str() == "N =? Z = 200000\n");
+    CHECK(Enough.getSteps() == 100000);
+
+    std::istringstream ShortIn("100000");
+    std::ostringstream ShortOut;
+    Budget Short(99999, 0);
+    CHECK_THROWS_WITH(
+        A.Execute(ShortIn, ShortOut, false, true, nullptr, &Short),
+        Exceeded.c_str());
+
+    Compiler C;
+    A.Compile(C);
+    Program *Bytecode = C.Finish();
+    std::istringstream VMIn("100000");
+    std::ostringstream VMOut;
+    Budget VMShort(99999, 0);
+    VM Machine(*Bytecode, VMIn, VMOut);
+    Machine.setBudget(&VMShort);
+    CHECK_THROWS_WITH(Machine.Execute(), Exceeded.c_str());
+    delete Bytecode;
+
+    // A skip that ends a slice is not spent again once the run resumes.
+    Session Run(A);
+    Budget Sliced(0, 0, 1000);
+    Run.setBudget(&Sliced);
+    Run.Supply(100000);
+    std::ostringstream SlicedOut;
+    while (!Run.isFinished()) {
+      Run.Run(SlicedOut);
+    }
+    CHECK(SlicedOut.str() == "N =? Z = 200000\n");
+    CHECK(Sliced.getSteps() == 100000);
+  }
+
+  TEST_CASE("stops runaway loops in every tier") {
+    AST A;
+    Parser P = *Parser::CreateFromString(
+        "program int X; begin X = 0; while (X < 1) loop X = X * 1; end; "
+        "end",
+        A);
+    P.Parse();
+
+    std::string Steps = "Runtime Error: The loops of the program went around "
+                        "more than 100000 times, the step budget of the run.";
+    std::istringstream In;
+    std::ostringstream Out;
+    Budget Limits(100000, 0);
+    Tiers T(A, 1000, true, false);
+    CHECK_THROWS_WITH(T.Execute(In, Out, false, &Limits), Steps.c_str());
+    CHECK(Limits.getSteps() == 100001);
+
+    // Without a step budget the clock stops the run.
+    Budget Clock(0, 20);
+    CHECK_THROWS_WITH(A.Execute(In, Out, false, true, nullptr, &Clock),
+                      "Runtime Error: The program ran for longer than 20 ms, "
+                      "the time limit of the run.");
+  }
+
+  TEST_CASE("waits for input a value at a time") {
+    AST A;
+    Parser P = *Parser::CreateFromString(Source, A);
+    P.Parse();
+
+    std::istringstream FullIn(Input);
+    std::ostringstream FullOut;
+    A.Execute(FullIn, FullOut);
+
+    // A thousand sessions take turns, each given one value per turn.
+    std::vector<int> Values = {3, 10, 20, 30};
+    std::vector<Session *> Sessions;
+    std::vector<std::ostringstream> Outs(1000);
+    for (unsigned K = 0; K < Outs.size(); ++K) {
+      Sessions.push_back(new Session(A));
+      CHECK(Sessions[K]->Run(Outs[K]) == "N");
+    }
+    CHECK(Outs[0].str() == "");
+    for (int Value : Values) {
+      for (unsigned K = 0; K < Outs.size(); ++K) {
+        Sessions[K]->Supply(Value);
+        Sessions[K]->Run(Outs[K]);
+      }
+      CHECK(Sessions[0]->getWaiting() == (Value == 30 ? "" : "S"));
+    }
+    for (unsigned K = 0; K < Outs.size(); ++K) {
+      CHECK(Sessions[K]->isFinished());
+      CHECK(Outs[K].str() == FullOut.str());
+      delete Sessions[K];
+    }
+
+    // Values given ahead are kept until they are read.
+    Session Ahead(A);
+    std::ostringstream AheadOut;
+    for (int Value : {3, 10, 20}) {
+      Ahead.Supply(Value);
+    }
+    CHECK(Ahead.Run(AheadOut) == "S");
+    Ahead.Supply(30);
+    CHECK(Ahead.Run(AheadOut) == "");
+    CHECK(AheadOut.str() == FullOut.str());
+  }
+
+  TEST_CASE("reads a whole list once every value arrived") {
+    AST A;
+    Parser P = *Parser::CreateFromString(
+        "program int X, Y; begin read X, Y; write X; Y = Y * X; write Y; "
+        "end",
+        A);
+    P.Parse();
+
+    std::ostringstream Out;
+    Session S(A);
+    S.Supply(65536);
+    CHECK(S.Run(Out) == "Y");
+    CHECK(Out.str() == "");
+    CHECK(S.Run(Out) == "Y");
+
+    // A runtime error ends the session.
+    S.Supply(65536);
+    CHECK_THROWS_WITH(S.Run(Out), "Runtime Error [Line 1:49] at token: \"Y\". "
+                                  "Performing multiplication here will cause "
+                                  "overflow and unexpected behavior.");
+    CHECK(Out.str() == "X =? Y =? X = 65536\n");
+    CHECK(S.isFinished());
+    CHECK(S.Run(Out) == "");
+  }
+}
@@ -0,0 +1,175 @@
+//===--- FusionMiner.cpp --------------------------------------------------===//
+//
+// Author: ケジ
+// Description: Runs a corpus of CORE programs on the virtual machine, counting
+// how often each instruction executes, and ranks the pairs of adjacent
+// instructions that would save the most dispatches if fused into a single
+// superinstruction. The programs are optimized and compiled exactly like the
+// `Interpreter --vm` does, so existing superinstructions are taken into
+// account and only the next candidates are reported.
+//
+//===----------------------------------------------------------------------===//
+
+#include "core/AST/AST.h"
+#include "core/AST/OptStats.h"
+#include "core/Parser/Parser.h"
+#include "core/VM/Compiler.h"
+#include "core/VM/VM.h"
+#include <algorithm> // std::sort
+#include <cstdlib>   // std::exit, std::atoi
+#include <fstream>   // std::ifstream
+#include <iomanip>   // std::setw, std::setprecision
+#include <iostream>  // std::cerr, std::cout, std::endl
+#include <map>       // std::map
+#include <set>       // std::set
+#include <sstream>   // std::istringstream, std::ostringstream
+#include <string>    // std::string
+#include <vector>    // std::vector
+
+typedef std::map<std::string, unsigned long long> PairCounts;
+
+/// Whether `Op` can continue at another instruction than the next one.
+static bool isControlFlow(OpCode::OpCode Op) {
+  const OpInfo &Info = getOpInfo(Op);
+  if (Op == OpCode::halt) return true;
+  for (unsigned N = 0; N < 3; ++N) {
+    if (Info.Operands[N] == OperandKind::target) return true;
+  }
+  return false;
+}
+
+/// Whether `Second` reads the register `First` writes.
+static bool isDependent(const Instr &First, const Instr &Second) {
+  const OpInfo &FirstInfo = getOpInfo(First.Op);
+  const OpInfo &SecondInfo = getOpInfo(Second.Op);
+  if (FirstInfo.Operands[0] != OperandKind::reg || First.Op == OpCode::write) {
+    return false;
+  }
+  unsigned Operands[3] = {Second.A, Second.B, Second.C};
+  for (unsigned N = 0; N < 3; ++N) {
+    // The first operand is the destination, except for branches and output.
+    bool Reads = N != 0 || isControlFlow(Second.Op) ||
+                 Second.Op == OpCode::write;
+    if (Reads && SecondInfo.Operands[N] == OperandKind::reg &&
+        Operands[N] == First.A) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/// Adds the pairs of adjacent instructions of `P` weighted by `Counts`. Only
+/// pairs that always run one after the other can be fused: the first falls
+/// through and the second is not the target of a jump.
+static void countPairs(const Program &P,
+                       const std::vector<unsigned long long> &Counts,
+                       PairCounts &Pairs) {
+  std::set<unsigned> Targets;
+  for (const Instr &I : P.Code) {
+    const OpInfo &Info = getOpInfo(I.Op);
+    unsigned Operands[3] = {I.A, I.B, I.C};
+    for (unsigned N = 0; N < 3; ++N) {
+      if (Info.Operands[N] == OperandKind::target) Targets.insert(Operands[N]);
+    }
+  }
+
+  for (unsigned PC = 0; PC + 1 < P.Code.size(); ++PC) {
+    const Instr &First = P.Code[PC], &Second = P.Code[PC + 1];
+    if (Counts[PC] == 0 || isControlFlow(First.Op) || Targets.count(PC + 1)) {
+      continue;
+    }
+    std::string Key = std::string(getOpInfo(First.Op).Name) + " -> " +
+                      getOpInfo(Second.Op).Name;
+    if (isDependent(First, Second)) Key += " (dependent)";
+    Pairs[Key] += Counts[PC];
+  }
+}
+
+/// Runs the program at `FilePath`, reading its input from `FilePath.in` if
+/// present. A runtime error ends the run but keeps what was counted so far.
+/// \return the number of instructions executed.
+static unsigned long long profile(const std::string &FilePath,
+                                  PairCounts &Pairs) {
+  AST A;
+  Parser P = *Parser::CreateFromFile(FilePath, A);
+  P.Parse();
+  A.Fold();
+  OptStats Stats;
+  A.Prune(Stats);
+  A.AnalyzeRanges(Stats);
+  A.FindInductions(Stats);
+
+  Compiler C;
+  A.Compile(C);
+  Program *Bytecode = C.Finish();
+
+  std::ifstream Input(FilePath + ".in");
+  std::istringstream NoInput;
+  std::ostringstream Output;
+  std::vector<unsigned long long> Counts;
+  VM Machine(*Bytecode, Input.is_open() ? (std::istream &)Input : NoInput,
+             Output);
+  Machine.setProfile(&Counts);
+  try {
+    Machine.Execute();
+  } catch (std::string &Error) {
+    std::cerr << FilePath << ": " << Error << std::endl;
+  }
+
+  countPairs(*Bytecode, Counts, Pairs);
+  delete Bytecode;
+
+  unsigned long long Total = 0;
+  for (unsigned long long Count : Counts) {
+    Total += Count;
+  }
+  return Total;
+}
+
+int main(int argc, char **argv) {
+  std::vector<std::string> Files;
+  unsigned Top = 10;
+
+  for (int I = 1; I < argc; ++I) {
+    std::string Arg = argv[I];
+    if (Arg == "--top" && I + 1 < argc) {
+      Top = std::atoi(argv[++I]);
+    } else if (Arg.compare(0, 2, "--") == 0) {
+      std::cerr << "Unknown option: " << Arg << std::endl;
+      std::exit(1);
+    } else {
+      Files.push_back(Arg);
+    }
+  }
+
+  if (Files.empty()) {
+    std::cerr << "Please specify the files of the corpus." << std::endl;
+    std::exit(1);
+  }
+
+  PairCounts Pairs;
+  unsigned long long Total = 0;
+  for (auto &File : Files) {
+    try {
+      Total += profile(File, Pairs);
+    } catch (std::string &Error) {
+      // A program that does not parse is left out of the corpus.
+      std::cerr << Error << std::endl;
+    }
+  }
+
+  std::vector<std::pair<unsigned long long, std::string>> Ranked;
+  for (auto &Pair : Pairs) {
+    Ranked.push_back(std::make_pair(Pair.second, Pair.first));
+  }
+  std::sort(Ranked.rbegin(), Ranked.rend());
+
+  std::cout << "Instructions executed: " << Total << std::endl;
+  for (unsigned I = 0; I < Ranked.size() && I < Top; ++I) {
+    double Share = Total == 0 ? 0 : 100.0 * Ranked[I].first / Total;
+    std::cout << std::setw(3) << I + 1 << ". " << std::setw(12)
+              << Ranked[I].first << " " << std::setw(5) << std::fixed
+              << std::setprecision(1) << Share << "%  " << Ranked[I].second
+              << std::endl;
+  }
+}
@@ -6,23 +6,387 @@
 //===----------------------------------------------------------------------===//
 
 #include "core/AST/AST.h"
+#include "core/AST/Checkpoint.h"
+#include "core/AST/OptStats.h"
+#include "core/Exec/Batch.h"
+#include "core/Exec/Budget.h"
+#include "core/Exec/Coordinator.h"
+#include "core/Exec/Tiers.h"
+#include "core/IR/CodeGen.h"
+#include "core/IR/IR.h"
+#include "core/IR/PassManager.h"
 #include "core/Parser/Parser.h"
-#include <cstdlib>  // std::exit
+#include "core/VM/Compiler.h"
+#include "core/VM/LaneVM.h"
+#include "core/VM/VM.h"
+#include <csignal>  // std::signal
+#include <cstdio>   // std::rename
+#include <cstdlib>  // std::exit, std::atoi, std::strtoull
+#include <fstream>  // std::ifstream
 #include <iostream> // std::cerr, std::endl
 #include <sstream>  // std::ostringstream
+#include <string>   // std::string
+#include <thread>   // std::thread
+#include <vector>   // std::vector
+
+/// Set by a signal to take a checkpoint before the next statement, and whether
+/// the run stops after it.
+static volatile std::sig_atomic_t CheckpointRequest = 0;
+static volatile std::sig_atomic_t StopAfterCheckpoint = 0;
+
+extern "C" void requestCheckpoint(int Signal) {
+  if (Signal != SIGUSR1) StopAfterCheckpoint = 1;
+  CheckpointRequest = 1;
+}
 
 int main(int argc, char **argv) {
-  // Second argument [1] should be the name of the file.
-  if (argc <= 1) {
+  std::string FilePath;
+  bool Fold = true;
+  bool Prune = true;
+  bool Ranges = true;
+  bool ClosedForm = true;
+  bool PrintStats = false;
+  bool DeferChecks = false;
+  bool ShortCircuit = true;
+  bool UseVM = false;
+  bool Hoist = true;
+  bool Fuse = true;
+  bool DumpBytecode = false;
+  unsigned Unroll = 1;
+  std::string BatchPath;
+  unsigned Threads = std::thread::hardware_concurrency();
+  unsigned Lanes = 1;
+  unsigned Processes = 0;
+  bool Tiered = false;
+  unsigned TierThreshold = 1000;
+  bool BackgroundCompile = true;
+  bool Trace = false;
+  std::vector<int> Known;
+  bool PrintResidual = false;
+  bool UseIR = false;
+  bool DumpIR = false;
+  bool TimePasses = false;
+  PassManager PM;
+  std::string CheckpointPath;
+  std::string ResumePath;
+  unsigned long long MaxSteps = 0;
+  unsigned TimeLimit = 0;
+
+  for (int I = 1; I < argc; ++I) {
+    std::string Arg = argv[I];
+    if (Arg == "--no-fold") {
+      // Useful for comparing against the unoptimized tree.
+      Fold = false;
+    } else if (Arg == "--no-prune") {
+      Prune = false;
+    } else if (Arg == "--no-ranges") {
+      Ranges = false;
+    } else if (Arg == "--no-closed-form") {
+      ClosedForm = false;
+    } else if (Arg == "--stats") {
+      PrintStats = true;
+    } else if (Arg == "--defer-checks") {
+      DeferChecks = true;
+    } else if (Arg == "--eager-conditions") {
+      ShortCircuit = false;
+    } else if (Arg == "--vm") {
+      UseVM = true;
+    } else if (Arg == "--no-hoist") {
+      Hoist = false;
+    } else if (Arg == "--no-superinstructions") {
+      Fuse = false;
+    } else if (Arg == "--unroll" && I + 1 < argc) {
+      UseVM = true;
+      Unroll = std::atoi(argv[++I]);
+      if (Unroll < 1) {
+        std::cerr << "The unroll factor must be at least 1." << std::endl;
+        std::exit(1);
+      }
+    } else if (Arg == "--dump-bytecode") {
+      UseVM = true;
+      DumpBytecode = true;
+    } else if (Arg == "--batch" && I + 1 < argc) {
+      BatchPath = argv[++I];
+    } else if (Arg == "--threads" && I + 1 < argc) {
+      Threads = std::atoi(argv[++I]);
+    } else if (Arg == "--processes" && I + 1 < argc) {
+      Processes = std::atoi(argv[++I]);
+    } else if (Arg == "--lanes" && I + 1 < argc) {
+      // Lanes are only implemented for bytecode.
+      UseVM = true;
+      Lanes = std::atoi(argv[++I]);
+      if (Lanes != 8 && Lanes != 16) {
+        std::cerr << "The number of lanes must be 8 or 16." << std::endl;
+        std::exit(1);
+      }
+    } else if (Arg == "--tiered") {
+      Tiered = true;
+    } else if (Arg == "--tier-threshold" && I + 1 < argc) {
+      Tiered = true;
+      TierThreshold = std::atoi(argv[++I]);
+    } else if (Arg == "--sync-compile") {
+      Tiered = true;
+      BackgroundCompile = false;
+    } else if (Arg == "--trace") {
+      Tiered = true;
+      Trace = true;
+    } else if (Arg == "--known" && I + 1 < argc) {
+      std::istringstream Values(argv[++I]);
+      std::string Value;
+      while (std::getline(Values, Value, ',')) {
+        Known.push_back(std::atoi(Value.c_str()));
+      }
+    } else if (Arg == "--residual") {
+      PrintResidual = true;
+    } else if (Arg == "--ir") {
+      // The IR is only lowered to bytecode.
+      UseVM = true;
+      UseIR = true;
+    } else if (Arg == "--dump-ir") {
+      UseVM = true;
+      UseIR = true;
+      DumpIR = true;
+    } else if (Arg == "--passes" && I + 1 < argc) {
+      std::istringstream Names(argv[++I]);
+      std::vector<std::string> Order;
+      std::string Name;
+      while (std::getline(Names, Name, ',')) {
+        Order.push_back(Name);
+      }
+      if (!PM.setOrder(Order)) {
+        std::cerr << "Unknown pass in: " << argv[I] << std::endl;
+        std::exit(1);
+      }
+    } else if (Arg == "--disable-pass" && I + 1 < argc) {
+      if (!PM.disable(argv[++I])) {
+        std::cerr << "Unknown pass: " << argv[I] << std::endl;
+        std::exit(1);
+      }
+    } else if (Arg == "--time-passes") {
+      TimePasses = true;
+    } else if (Arg == "--checkpoint" && I + 1 < argc) {
+      CheckpointPath = argv[++I];
+    } else if (Arg == "--resume" && I + 1 < argc) {
+      ResumePath = argv[++I];
+    } else if (Arg == "--max-steps" && I + 1 < argc) {
+      MaxSteps = std::strtoull(argv[++I], nullptr, 10);
+    } else if (Arg == "--time-limit" && I + 1 < argc) {
+      TimeLimit = std::atoi(argv[++I]);
+    } else if (Arg.compare(0, 2, "--") == 0) {
+      std::cerr << "Unknown option: " << Arg << std::endl;
+      std::exit(1);
+    } else {
+      FilePath = Arg;
+    }
+  }
+
+  // An argument that is not an option should be the name of the file.
+  if (FilePath.empty()) {
     std::cerr << "Please specify a file name." << std::endl;
     std::exit(1);
   }
+  bool Checkpoints = !CheckpointPath.empty() || !ResumePath.empty();
+  if (Checkpoints && (UseVM || Tiered || !BatchPath.empty())) {
+    std::cerr << "Checkpoints are only taken by the tree walker." << std::endl;
+    std::exit(1);
+  }
+  if (Processes > 0 && (BatchPath.empty() || Lanes > 1)) {
+    std::cerr << "Worker processes only run batches, one line at a time."
+              << std::endl;
+    std::exit(1);
+  }
+  bool Limited = MaxSteps != 0 || TimeLimit != 0;
+  if (Limited && Lanes > 1) {
+    std::cerr << "Lanes do not support a step budget or a time limit."
+              << std::endl;
+    std::exit(1);
+  }
 
   try {
     AST A;
-    Parser P = *Parser::CreateFromFile(argv[1], A);
+    Parser P = *Parser::CreateFromFile(FilePath, A);
     P.Parse();
-    A.Execute();
+    OptStats Stats;
+    if (!Known.empty()) {
+      unsigned Used = A.Specialize(Known, Stats);
+      if (Used < Known.size()) {
+        std::cerr << "Only " << Used << " known values go to reads that run "
+                  << "first, whatever the input." << std::endl;
+        std::exit(1);
+      }
+    }
+    if (Fold) {
+      A.Fold();
+    }
+    if (Prune) {
+      A.Prune(Stats);
+    }
+    if (Ranges) {
+      A.AnalyzeRanges(Stats);
+    }
+    if (ClosedForm) {
+      A.FindInductions(Stats);
+    }
+    if (PrintStats) {
+      Stats.Print(std::cerr);
+    }
+    if (PrintResidual) {
+      A.Print();
+      return 0;
+    }
+
+    if (Checkpoints) {
+      Checkpoint From;
+      if (!ResumePath.empty()) {
+        std::ifstream File(ResumePath, std::ios::binary);
+        if (!File.is_open() || !Checkpoint::Read(File, From)) {
+          std::cerr << "Unable to read the checkpoint: " << ResumePath
+                    << std::endl;
+          std::exit(1);
+        }
+      }
+
+      // SIGUSR1 saves the run and goes on; SIGTERM and SIGINT save it and
+      // stop, so that it can be continued with `--resume`.
+      if (!CheckpointPath.empty()) {
+        std::signal(SIGUSR1, requestCheckpoint);
+        std::signal(SIGTERM, requestCheckpoint);
+        std::signal(SIGINT, requestCheckpoint);
+      }
+      auto Save = [&CheckpointPath](const Checkpoint &CP) {
+        // Written next to the file and renamed over it, so that a crash
+        // while writing keeps the previous checkpoint.
+        std::string Temp = CheckpointPath + ".tmp";
+        std::ofstream File(Temp, std::ios::binary);
+        CP.Write(File);
+        File.close();
+        if (!File || std::rename(Temp.c_str(), CheckpointPath.c_str()) != 0) {
+          std::cerr << "Unable to write the checkpoint: " << CheckpointPath
+                    << std::endl;
+        }
+        return StopAfterCheckpoint == 0;
+      };
+      Budget Limits(MaxSteps, TimeLimit);
+      A.Execute(std::cin, std::cout, &CheckpointRequest, Save,
+                ResumePath.empty() ? nullptr : &From, DeferChecks, ShortCircuit,
+                Limited ? &Limits : nullptr);
+      return 0;
+    }
+
+    // Loops that turn hot in the tree walker move to bytecode. A forked worker
+    // would not have the thread that compiles them.
+    Tiers T(A, TierThreshold, ShortCircuit,
+            Tiered && BackgroundCompile && Processes == 0);
+    T.setTracing(Trace);
+    if (!UseVM && BatchPath.empty()) {
+      Budget Limits(MaxSteps, TimeLimit);
+      if (!Tiered) {
+        A.Execute(std::cin, std::cout, DeferChecks, ShortCircuit, nullptr,
+                  Limited ? &Limits : nullptr);
+        return 0;
+      }
+      try {
+        T.Execute(std::cin, std::cout, DeferChecks,
+                  Limited ? &Limits : nullptr);
+      } catch (std::string &error) {
+        std::cerr << error << std::endl;
+      }
+      if (PrintStats) {
+        T.getStats().Print(std::cerr);
+      }
+      return 0;
+    }
+
+    Program *Bytecode = nullptr;
+    if (UseIR) {
+      Function F;
+      A.Lower(F, ShortCircuit);
+      PM.Run(F);
+      if (TimePasses) {
+        PM.PrintTimings(std::cerr);
+      }
+      if (DumpIR) {
+        std::ostringstream X;
+        F.Print(X);
+        std::cout << X.str();
+        return 0;
+      }
+      Bytecode = CodeGen::Generate(F, Fuse);
+    } else if (UseVM) {
+      Compiler C(Hoist, Fuse, ShortCircuit, Unroll);
+      A.Compile(C);
+      Bytecode = C.Finish();
+    }
+
+    if (!BatchPath.empty() && !DumpBytecode) {
+      std::ifstream Input(BatchPath);
+      if (!Input.is_open()) {
+        std::cerr << "Unable to open the batch file: " << BatchPath
+                  << std::endl;
+        std::exit(1);
+      }
+
+      // Each run gets its own context / virtual machine and budget; the tree
+      // and the bytecode are shared.
+      if (Lanes > 1) {
+        Batch::LaneRunner Run;
+        if (Lanes == 8) {
+          Run = [Bytecode](const std::vector<std::istream *> &Ins,
+                           const std::vector<std::ostream *> &Outs) {
+            return LaneVM<8>(*Bytecode).Execute(Ins, Outs);
+          };
+        } else {
+          Run = [Bytecode](const std::vector<std::istream *> &Ins,
+                           const std::vector<std::ostream *> &Outs) {
+            return LaneVM<16>(*Bytecode).Execute(Ins, Outs);
+          };
+        }
+        Batch(Run, Lanes, Threads)
+            .Execute(Batch::ReadRecords(Input), std::cout);
+      } else {
+        Batch::Runner Run;
+        if (UseVM) {
+          Run = [=](std::istream &In, std::ostream &Out) {
+            Budget Limits(MaxSteps, TimeLimit);
+            VM Machine(*Bytecode, In, Out);
+            Machine.setBudget(Limited ? &Limits : nullptr);
+            Machine.Execute();
+          };
+        } else if (Tiered) {
+          Run = [&, DeferChecks](std::istream &In, std::ostream &Out) {
+            Budget Limits(MaxSteps, TimeLimit);
+            T.Execute(In, Out, DeferChecks, Limited ? &Limits : nullptr);
+          };
+        } else {
+          Run = [&, DeferChecks, ShortCircuit](std::istream &In,
+                                               std::ostream &Out) {
+            Budget Limits(MaxSteps, TimeLimit);
+            A.Execute(In, Out, DeferChecks, ShortCircuit, nullptr,
+                      Limited ? &Limits : nullptr);
+          };
+        }
+        if (Processes > 0) {
+          // The workers are forked from here, sharing the tree and the
+          // bytecode copy-on-write.
+          Coordinator(Run, Processes).Execute(Input, std::cout);
+        } else {
+          Batch(Run, Threads).Execute(Batch::ReadRecords(Input), std::cout);
+        }
+        if (Tiered && !UseVM && PrintStats && Processes == 0) {
+          T.getStats().Print(std::cerr);
+        }
+      }
+    } else if (DumpBytecode) {
+      std::ostringstream X;
+      Bytecode->Print(X);
+      std::cout << X.str();
+    } else {
+      Budget Limits(MaxSteps, TimeLimit);
+      VM Machine(*Bytecode);
+      Machine.setBudget(Limited ? &Limits : nullptr);
+      Machine.Execute();
+    }
+    delete Bytecode;
   } catch (std::string &error) {
     std::cerr << error << std::endl;
   }